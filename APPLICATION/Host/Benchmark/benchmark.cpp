@@ -0,0 +1,519 @@
+/**
+* @file benchmark.cpp
+* @brief Host microbenchmark suite
+* @note Runs the shared firmware code on the host (see Simulator) and prints
+* one CSV line per case: case,iterations,ns_per_op,baseline_ns,change_percent,status.
+* The time is the median of the repeats, which are made in rounds over all
+* the cases, so a slow phase of the host hits one repeat of every case rather
+* than all the repeats of one. A previous output passed as the baseline
+* (--baseline file) is compared, a case slower than the threshold
+* (--threshold percent, 10 by default) is a regression and the exit code is 1.
+* The simulated card exchanges run through the whole simulator and drift with
+* the host load much more than the kernels, they have their own threshold
+* (--exchange-threshold percent, 50 by default). The host timing only follows
+* the target one, so a baseline is valid for the machine, which has made it.
+*
+* Usage: benchmark [--baseline file] [--threshold percent]
+*                  [--exchange-threshold percent] [--filter text]
+*/
+
+#include "simulator.hpp"
+#include "card.hpp"
+#include "system_timer.hpp"
+#include "board.hpp"
+#include "iso7816.hpp"
+#include "circular_buffer.hpp"
+#include "crc.hpp"
+#include "data_eeprom.hpp"
+#include "credential_db.hpp"
+#include "credentials.hpp"
+#include "flash.hpp"
+#include "options.hpp"
+#include "static_assert.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+/// Benchmark options
+enum Options_t
+{
+	BENCH_REPEATS = 9,				///< Measurements per case (the median is taken)
+	BENCH_MIN_NS = 20000000,		///< Min measurement time (ns.)
+	BENCH_MAX_CASES = 32,			///< Max cases (and baseline entries)
+	BENCH_NAME_SIZE = 48,			///< Max case name length
+	BENCH_DATA_SIZE = 256,			///< CRC data size (bytes)
+	BENCH_CHUNK_SIZE = 64,			///< Ring buffer transfer size (bytes)
+	BENCH_DB_KEYS = 8000,			///< Credential database keys count
+	BENCH_DB_MAGIC = 0x31424443,	///< Credential database signature ("CDB1")
+	BENCH_SLOTS = CREDENTIALS_SIZE / 12,	///< Local credential table slots count
+};
+
+
+/// Benchmark case
+struct Bench_t
+{
+	const char* Name;					///< Case name
+	void (*Setup)();					///< Preparation (0 - none)
+	void (*Run)(uint32_t iterations);	///< Measured loop
+	bool Exchange;						///< Simulated card exchange (see --exchange-threshold)
+};
+
+/// Case result
+struct Result_t
+{
+	uint32_t Iterations;			///< Iterations count
+	double Times[BENCH_REPEATS];	///< Sorted times per operation (ns.)
+};
+
+/// Baseline entry
+struct Baseline_t
+{
+	char Name[BENCH_NAME_SIZE];		///< Case name
+	double Ns;						///< Time per operation (ns.)
+};
+
+
+static volatile uint32_t Sink;					///< Results sink (keeps the measured code)
+static uint8_t Data[BENCH_DATA_SIZE];			///< CRC data
+static uint8_t RingStorage[BENCH_DATA_SIZE];	///< Ring buffer storage
+static CircularBuffer Ring(RingStorage, sizeof(RingStorage));
+static ScriptedCard Card;						///< Simulated SIM card
+static Credential_t Credential;					///< Credential being looked up
+static Credential_t Missing;					///< Credential, which is not in the database
+static Baseline_t Baseline[BENCH_MAX_CASES];	///< Baseline entries
+static uint32_t BaselineCount;					///< Baseline entries count
+static Result_t Results[BENCH_MAX_CASES];		///< Case results
+
+
+/// MF and EF ICCID identifiers (see main.cpp)
+static const char MF[] = {0x3F, 0x00};
+static const char EFiccid[] = {0x2F, (char)0xE2};
+
+
+/**
+* @brief Process time
+* @return time (ns.)
+* @note The CPU time of the process, the time of the other processes is not counted
+*/
+static uint64_t GetNs()
+{
+	timespec now;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+	return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+
+/**
+* @brief Credential making
+* @param credential - destination credential pointer
+* @param number - ICCID number part
+* @note 89 prefix, the number, low nibble first BCD, F filler
+*/
+static void MakeCredential(Credential_t* credential, uint64_t number)
+{
+	char digits[21];
+	snprintf(digits, sizeof(digits), "89%017llu", (unsigned long long)number);
+	memset(credential->Value, 0xFF, sizeof(credential->Value));
+	for(uint32_t index = 0; digits[index]; index++)
+	{
+		uint8_t digit = digits[index] - '0';
+		uint8_t* byte = &credential->Value[index >> 1];
+		*byte = (index & 1) ? (uint8_t)((*byte & 0x0F) | (digit << 4)) : (uint8_t)((*byte & 0xF0) | digit);
+	}
+}
+
+
+/**
+* @brief Loop calibration
+* @param run - measured loop
+* @param ns - min loop time (ns.)
+* @return iterations count (doubled until the loop takes the time)
+*/
+static uint32_t Calibrate(void (*run)(uint32_t iterations), uint64_t ns)
+{
+	uint32_t count = 1;
+	for(;;)
+	{
+		uint64_t start = GetNs();
+		run(count);
+		if((GetNs() - start >= ns) || (count >= 0x40000000))
+		{
+			return count;
+		}
+		count <<= 1;
+	}
+}
+
+
+/**
+* @brief Insertion into the sorted values
+* @param values - sorted values
+* @param count - values count
+* @param value - value to be inserted
+*/
+static void InsertSorted(double* values, uint32_t count, double value)
+{
+	uint32_t index = count;
+	for(; index && (values[index - 1] > value); index--)
+	{
+		values[index] = values[index - 1];
+	}
+	values[index] = value;
+}
+
+
+///--- Cases ---///
+
+static void RingPutGet(uint32_t iterations)
+{
+	uint8_t buffer[BENCH_CHUNK_SIZE];
+	while(iterations--)
+	{
+		Ring.Put(Data, sizeof(buffer));
+		Sink += Ring.Get(buffer, sizeof(buffer));
+	}
+}
+
+static void RingCopySetup()
+{
+	Ring.Reset();
+	Ring.Put(Data, BENCH_CHUNK_SIZE);
+}
+
+static void RingCopy(uint32_t iterations)
+{
+	uint8_t buffer[BENCH_CHUNK_SIZE];
+	while(iterations--)
+	{
+		Sink += Ring.Copy(buffer, sizeof(buffer));
+	}
+}
+
+static void RingChar(uint32_t iterations)
+{
+	uint8_t byte;
+	while(iterations--)
+	{
+		for(uint32_t index = 0; index < BENCH_CHUNK_SIZE; index++)
+		{
+			Ring.PutChar(Data[index]);
+		}
+		for(uint32_t index = 0; index < BENCH_CHUNK_SIZE; index++)
+		{
+			Ring.GetChar(&byte);
+			Sink += byte;
+		}
+	}
+}
+
+static void Crc8(uint32_t iterations)
+{
+	while(iterations--)
+	{
+		Sink += Crc::Calc8((char *)Data, sizeof(Data), 0);
+	}
+}
+
+static void Crc16(uint32_t iterations)
+{
+	while(iterations--)
+	{
+		Sink += Crc::Calc16((char *)Data, sizeof(Data), 0);
+	}
+}
+
+static void CardSetup()
+{
+	Card.SetInstant(true);
+	ISO7816_1.DeactivateCard();
+}
+
+static void AtrActivation(uint32_t iterations)
+{
+	while(iterations--)
+	{
+		ATR_t atr;
+		if(!ISO7816_1.ActivateCard(&atr))
+		{
+			fprintf(stderr, "benchmark: card activation failed\n");
+			exit(2);
+		}
+		Sink += atr.TA1;
+		ISO7816_1.DeactivateCard();
+	}
+}
+
+static void ApduSetup()
+{
+	Card.SetInstant(true);
+	ISO7816_1.DeactivateCard();
+	ISO7816_1.ActivateCard();
+}
+
+static void ApduSelectRead(uint32_t iterations)
+{
+	while(iterations--)
+	{
+		Credential_t credential;
+		if(!ISO7816_1.SelectFile(0xA0, 0x00, 0x00, MF, sizeof(MF))
+			|| !ISO7816_1.SelectFile(0xA0, 0x00, 0x00, EFiccid, sizeof(EFiccid))
+			|| (ISO7816_1.ReadBinary(0xA0, credential.Value, sizeof(credential.Value)) == -1))
+		{
+			fprintf(stderr, "benchmark: card exchange failed\n");
+			exit(2);
+		}
+		Sink += credential.Value[0];
+	}
+}
+
+static void IccidKey(uint32_t iterations)
+{
+	while(iterations--)
+	{
+		Sink += (uint32_t)CredentialDb::MakeKey(&Credential);
+	}
+}
+
+static void DbLookup(uint32_t iterations)
+{
+	while(iterations--)
+	{
+		Sink += CredentialDb::Contains(&Credential);
+		Sink += CredentialDb::Contains(&Missing);
+	}
+}
+
+static void CredentialsEncode(uint32_t iterations)
+{
+	while(iterations--)
+	{
+		Sink += Credentials::Encode(&Credential);
+	}
+}
+
+
+/// Cases list
+static const Bench_t CASES[] =
+{
+	{"circular_buffer_put_get",	RingCopySetup,	RingPutGet,			false},
+	{"circular_buffer_copy",	RingCopySetup,	RingCopy,			false},
+	{"circular_buffer_char",	RingCopySetup,	RingChar,			false},
+	{"crc8_256",				0,				Crc8,				false},
+	{"crc16_256",				0,				Crc16,				false},
+	{"atr_activation",			CardSetup,		AtrActivation,		true},
+	{"apdu_select_read",		ApduSetup,		ApduSelectRead,		true},
+	{"iccid_key",				0,				IccidKey,			false},
+	{"credential_db_lookup",	0,				DbLookup,			false},
+	{"credentials_encode",		0,				CredentialsEncode,	false},
+};
+
+STATIC_ASSERT(sizeof(CASES) / sizeof(CASES[0]) <= BENCH_MAX_CASES, bench_cases_count);
+
+
+/**
+* @brief Firmware and simulated peripherals initialization
+* @note The credential database and the local table are filled the way
+* the bus requests would, the looked up credential is the last one
+*/
+static void Init()
+{
+	Simulator::Init();
+	SystemTimer::Init();
+	Board::Init();
+	Simulator::Attach(&Card);
+	
+	for(uint32_t index = 0; index < sizeof(Data); index++)
+	{
+		Data[index] = (uint8_t)(index * 7 + 1);
+	}
+	
+	/// Credential database: ascending keys of the even numbers, the odd ones are missing
+	uint64_t* keys = (uint64_t *)(CREDENTIAL_DB_ADDRESS + Flash::PAGE_SIZE);
+	for(uint32_t index = 0; index < BENCH_DB_KEYS; index++)
+	{
+		Credential_t credential;
+		MakeCredential(&credential, 1000 + 2 * index);
+		keys[index] = CredentialDb::MakeKey(&credential);
+	}
+	uint32_t* header = (uint32_t *)CREDENTIAL_DB_ADDRESS;
+	header[0] = BENCH_DB_MAGIC;
+	header[1] = BENCH_DB_KEYS;
+	header[2] = Crc::Calc16((char *)keys, BENCH_DB_KEYS * sizeof(uint64_t), 0);
+	CredentialDb::Init();
+	if(!CredentialDb::IsValid())
+	{
+		fprintf(stderr, "benchmark: credential database is not valid\n");
+		exit(2);
+	}
+	
+	/// Local table: all the slots are used
+	Credentials::Init();
+	for(uint16_t slot = 0; slot < BENCH_SLOTS; slot++)
+	{
+		MakeCredential(&Credential, 1000 + 2 * (BENCH_DB_KEYS - BENCH_SLOTS + slot));
+		Credentials::WriteSlot(slot, &Credential, Credentials::FLAG_USED | Credentials::FLAG_GRANTED);
+		DataEeprom::Commit();
+	}
+	MakeCredential(&Missing, 1001);
+	Card.SetIccid(Credential.Value);
+}
+
+
+/**
+* @brief Baseline loading
+* @param fileName - previous output file name
+* @return true, if the file is read
+*/
+static bool LoadBaseline(const char* fileName)
+{
+	FILE* file = fopen(fileName, "r");
+	if(!file)
+	{
+		return false;
+	}
+	
+	char line[256];
+	while(fgets(line, sizeof(line), file) && (BaselineCount < BENCH_MAX_CASES))
+	{
+		char name[BENCH_NAME_SIZE];
+		unsigned long iterations;
+		double ns;
+		if(sscanf(line, "%47[^,],%lu,%lf", name, &iterations, &ns) == 3)
+		{
+			strcpy(Baseline[BaselineCount].Name, name);
+			Baseline[BaselineCount].Ns = ns;
+			BaselineCount++;
+		}
+	}
+	
+	fclose(file);
+	return true;
+}
+
+
+/**
+* @brief Baseline searching
+* @param name - case name
+* @return time per operation (ns., 0 - not found)
+*/
+static double FindBaseline(const char* name)
+{
+	for(uint32_t index = 0; index < BaselineCount; index++)
+	{
+		if(!strcmp(Baseline[index].Name, name))
+		{
+			return Baseline[index].Ns;
+		}
+	}
+	return 0;
+}
+
+
+/**
+* @brief Case measurement
+* @param bench - case pointer
+* @param result - case result pointer
+* @param repeat - repeat index
+* @note The first repeat doubles the iterations count until the loop takes
+* BENCH_MIN_NS. The sorted times of the repeats are kept for the median.
+*/
+static void Measure(const Bench_t* bench, Result_t* result, uint32_t repeat)
+{
+	if(bench->Setup)
+	{
+		bench->Setup();
+	}
+	
+	if(!repeat)
+	{
+		result->Iterations = Calibrate(bench->Run, BENCH_MIN_NS);
+	}
+	
+	uint64_t start = GetNs();
+	bench->Run(result->Iterations);
+	InsertSorted(result->Times, repeat, (double)(GetNs() - start) / result->Iterations);
+}
+
+
+int main(int argc, char** argv)
+{
+	const char* baselineName = 0;
+	const char* filter = 0;
+	double threshold = 10;
+	double exchangeThreshold = 50;
+	
+	for(int index = 1; index < argc; index++)
+	{
+		if(!strcmp(argv[index], "--baseline") && (index + 1 < argc))
+		{
+			baselineName = argv[++index];
+		}
+		else if(!strcmp(argv[index], "--threshold") && (index + 1 < argc))
+		{
+			threshold = atof(argv[++index]);
+		}
+		else if(!strcmp(argv[index], "--exchange-threshold") && (index + 1 < argc))
+		{
+			exchangeThreshold = atof(argv[++index]);
+		}
+		else if(!strcmp(argv[index], "--filter") && (index + 1 < argc))
+		{
+			filter = argv[++index];
+		}
+		else
+		{
+			fprintf(stderr, "usage: %s [--baseline file] [--threshold percent] [--exchange-threshold percent] [--filter text]\n", argv[0]);
+			return 2;
+		}
+	}
+	
+	if(baselineName && !LoadBaseline(baselineName))
+	{
+		fprintf(stderr, "benchmark: %s can't be read\n", baselineName);
+		return 2;
+	}
+	
+	Init();
+	
+	const uint32_t count = sizeof(CASES) / sizeof(CASES[0]);
+	for(uint32_t repeat = 0; repeat < BENCH_REPEATS; repeat++)
+	{
+		for(uint32_t index = 0; index < count; index++)
+		{
+			if(!filter || strstr(CASES[index].Name, filter))
+			{
+				Measure(&CASES[index], &Results[index], repeat);
+			}
+		}
+	}
+	
+	bool regression = false;
+	printf("case,iterations,ns_per_op,baseline_ns,change_percent,status\n");
+	for(uint32_t index = 0; index < count; index++)
+	{
+		const Bench_t* bench = &CASES[index];
+		if(filter && !strstr(bench->Name, filter))
+		{
+			continue;
+		}
+		
+		const Result_t* result = &Results[index];
+		double ns = result->Times[BENCH_REPEATS / 2];
+		double baseline = FindBaseline(bench->Name);
+		if(!baseline)
+		{
+			printf("%s,%u,%.2f,,,new\n", bench->Name, (unsigned)result->Iterations, ns);
+		}
+		else
+		{
+			double change = (ns - baseline) * 100 / baseline;
+			bool slower = change > (bench->Exchange ? exchangeThreshold : threshold);
+			regression |= slower;
+			printf("%s,%u,%.2f,%.2f,%+.1f,%s\n", bench->Name, (unsigned)result->Iterations, ns, baseline, change, slower ? "regression" : "ok");
+		}
+	}
+	
+	return regression ? 1 : 0;
+}
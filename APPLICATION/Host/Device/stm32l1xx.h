@@ -0,0 +1,416 @@
+/**
+* @file stm32l1xx.h
+* @brief Host build device header
+* @note Stands for the STM32L1xx CMSIS device header in the host build (see Host/CMakeLists.txt).
+* The peripherals keep their device addresses, the simulator maps plain memory there
+* (see Simulator::Init), so the firmware sources access the registers unchanged.
+* Only the registers and bits used by the host-built sources are defined.
+* The core registers, which aren't memory-mapped (PRIMASK, BASEPRI, IPSR), live in HostCore.
+*/
+
+#ifndef __STM32L1XX_H
+#define __STM32L1XX_H
+
+#include <stdint.h>
+
+
+#define __IO	volatile
+#define __I		volatile const
+
+#define __NVIC_PRIO_BITS	4
+
+typedef enum {RESET = 0, SET = !RESET} FlagStatus, ITStatus;
+
+
+/// Interrupt numbers
+typedef enum
+{
+	NonMaskableInt_IRQn = -14, HardFault_IRQn = -13, MemoryManagement_IRQn = -12, BusFault_IRQn = -11,
+	UsageFault_IRQn = -10, SVCall_IRQn = -5, DebugMonitor_IRQn = -4, PendSV_IRQn = -2, SysTick_IRQn = -1,
+	WWDG_IRQn = 0, PVD_IRQn = 1, TAMPER_STAMP_IRQn = 2, RTC_WKUP_IRQn = 3, FLASH_IRQn = 4, RCC_IRQn = 5,
+	EXTI0_IRQn = 6, EXTI1_IRQn = 7, EXTI2_IRQn = 8, EXTI3_IRQn = 9, EXTI4_IRQn = 10,
+	DMA1_Channel1_IRQn = 11, DMA1_Channel2_IRQn = 12, DMA1_Channel3_IRQn = 13, DMA1_Channel4_IRQn = 14,
+	DMA1_Channel5_IRQn = 15, DMA1_Channel6_IRQn = 16, DMA1_Channel7_IRQn = 17, ADC1_IRQn = 18,
+	USB_HP_IRQn = 19, USB_LP_IRQn = 20, DAC_IRQn = 21, COMP_IRQn = 22, EXTI9_5_IRQn = 23, LCD_IRQn = 24,
+	TIM9_IRQn = 25, TIM10_IRQn = 26, TIM11_IRQn = 27, TIM2_IRQn = 28, TIM3_IRQn = 29, TIM4_IRQn = 30,
+	I2C1_EV_IRQn = 31, I2C1_ER_IRQn = 32, I2C2_EV_IRQn = 33, I2C2_ER_IRQn = 34, SPI1_IRQn = 35, SPI2_IRQn = 36,
+	USART1_IRQn = 37, USART2_IRQn = 38, USART3_IRQn = 39, EXTI15_10_IRQn = 40, RTC_Alarm_IRQn = 41,
+	USB_FS_WKUP_IRQn = 42, TIM6_IRQn = 43, TIM7_IRQn = 44,
+} IRQn_Type;
+
+
+///--- Registers ---///
+
+typedef struct
+{
+	__IO uint32_t CR, ICSCR, CFGR, CIR, AHBRSTR, APB2RSTR, APB1RSTR, AHBENR, APB2ENR, APB1ENR, AHBLPENR, APB2LPENR, APB1LPENR, CSR;
+} RCC_TypeDef;
+
+/// GPIO set/reset register: a write is applied to ODR at once, as the next one replaces it
+struct HostBsrr_t
+{
+	uint32_t Value;
+	
+	void operator=(uint32_t value) volatile
+	{
+		volatile uint32_t* odr = (volatile uint32_t *)((uintptr_t)&Value - sizeof(uint32_t));
+		*odr = (*odr & ~(value >> 16)) | (value & 0xFFFF);
+	}
+};
+
+typedef struct
+{
+	__IO uint32_t MODER, OTYPER, OSPEEDR, PUPDR, IDR, ODR;
+	__IO HostBsrr_t BSRR;
+	__IO uint32_t LCKR;
+	__IO uint32_t AFR[2];
+} GPIO_TypeDef;
+
+typedef struct
+{
+	__IO uint32_t ACR, PECR, PDKEYR, PEKEYR, PRGKEYR, OPTKEYR, SR, OBR, WRPR;
+} FLASH_TypeDef;
+
+typedef struct
+{
+	__IO uint16_t SR;	uint16_t RESERVED0;
+	__IO uint16_t DR;	uint16_t RESERVED1;
+	__IO uint16_t BRR;	uint16_t RESERVED2;
+	__IO uint16_t CR1;	uint16_t RESERVED3;
+	__IO uint16_t CR2;	uint16_t RESERVED4;
+	__IO uint16_t CR3;	uint16_t RESERVED5;
+	__IO uint16_t GTPR;	uint16_t RESERVED6;
+} USART_TypeDef;
+
+typedef struct
+{
+	__IO uint32_t CCR, CNDTR, CPAR, CMAR;
+} DMA_Channel_TypeDef;
+
+typedef struct
+{
+	__IO uint32_t KR, PR, RLR, SR;
+} IWDG_TypeDef;
+
+typedef struct
+{
+	__IO uint32_t CR, CSR;
+} PWR_TypeDef;
+
+typedef struct
+{
+	__IO uint32_t MEMRMP, PMC;
+	__IO uint32_t EXTICR[4];
+} SYSCFG_TypeDef;
+
+typedef struct
+{
+	__IO uint32_t IMR, EMR, RTSR, FTSR, SWIER, PR;
+} EXTI_TypeDef;
+
+typedef struct
+{
+	__IO uint32_t TR, DR, CR, ISR, PRER, WUTR, CALIBR, ALRMAR, ALRMBR, WPR, SSR;
+} RTC_TypeDef;
+
+typedef struct
+{
+	__IO uint32_t IDCODE, CR, APB1FZ, APB2FZ;
+} DBGMCU_TypeDef;
+
+typedef struct
+{
+	__I uint32_t CPUID;
+	__IO uint32_t ICSR, VTOR, AIRCR, SCR, CCR;
+	__IO uint8_t SHP[12];
+	__IO uint32_t SHCSR, CFSR, HFSR, DFSR, MMFAR, BFAR, AFSR;
+} SCB_Type;
+
+typedef struct
+{
+	__IO uint32_t ISER[8];	uint32_t RESERVED0[24];
+	__IO uint32_t ICER[8];	uint32_t RESERVED1[24];
+	__IO uint32_t ISPR[8];	uint32_t RESERVED2[24];
+	__IO uint32_t ICPR[8];	uint32_t RESERVED3[24];
+	__IO uint32_t IABR[8];	uint32_t RESERVED4[56];
+	__IO uint8_t IP[240];
+} NVIC_Type;
+
+typedef struct
+{
+	__IO uint32_t CTRL, LOAD, VAL, CALIB;
+} SysTick_Type;
+
+typedef struct
+{
+	__IO uint32_t CTRL, CYCCNT, CPICNT, EXCCNT, SLEEPCNT, LSUCNT, FOLDCNT, PCSR;
+} DWT_Type;
+
+typedef struct
+{
+	__IO uint32_t DHCSR, DCRSR, DCRDR, DEMCR;
+} CoreDebug_Type;
+
+
+///--- Memory map ---///
+
+#define FLASH_BASE			((uint32_t)0x08000000)
+#define DATA_EEPROM_BASE	((uint32_t)0x08080000)
+#define SRAM_BASE			((uint32_t)0x20000000)
+#define PERIPH_BASE			((uint32_t)0x40000000)
+
+#define RTC_BASE			(PERIPH_BASE + 0x2800)
+#define IWDG_BASE			(PERIPH_BASE + 0x3000)
+#define USART2_BASE			(PERIPH_BASE + 0x4400)
+#define PWR_BASE			(PERIPH_BASE + 0x7000)
+#define SYSCFG_BASE			(PERIPH_BASE + 0x10000)
+#define EXTI_BASE			(PERIPH_BASE + 0x10400)
+#define USART1_BASE			(PERIPH_BASE + 0x13800)
+#define GPIOA_BASE			(PERIPH_BASE + 0x20000)
+#define GPIOB_BASE			(PERIPH_BASE + 0x20400)
+#define RCC_BASE			(PERIPH_BASE + 0x23800)
+#define FLASH_R_BASE		(PERIPH_BASE + 0x23C00)
+#define DMA1_BASE			(PERIPH_BASE + 0x26000)
+#define DMA1_Channel4_BASE	(DMA1_BASE + 0x44)
+#define DMA1_Channel5_BASE	(DMA1_BASE + 0x58)
+
+#define DWT_BASE			((uint32_t)0xE0001000)
+#define SysTick_BASE		((uint32_t)0xE000E010)
+#define NVIC_BASE			((uint32_t)0xE000E100)
+#define SCB_BASE			((uint32_t)0xE000ED00)
+#define CoreDebug_BASE		((uint32_t)0xE000EDF0)
+#define DBGMCU_BASE			((uint32_t)0xE0042000)
+
+#define RTC					((RTC_TypeDef *)RTC_BASE)
+#define IWDG				((IWDG_TypeDef *)IWDG_BASE)
+#define USART2				((USART_TypeDef *)USART2_BASE)
+#define PWR					((PWR_TypeDef *)PWR_BASE)
+#define SYSCFG				((SYSCFG_TypeDef *)SYSCFG_BASE)
+#define EXTI				((EXTI_TypeDef *)EXTI_BASE)
+#define USART1				((USART_TypeDef *)USART1_BASE)
+#define GPIOA				((GPIO_TypeDef *)GPIOA_BASE)
+#define GPIOB				((GPIO_TypeDef *)GPIOB_BASE)
+#define RCC					((RCC_TypeDef *)RCC_BASE)
+#define FLASH				((FLASH_TypeDef *)FLASH_R_BASE)
+#define DMA1_Channel4		((DMA_Channel_TypeDef *)DMA1_Channel4_BASE)
+#define DMA1_Channel5		((DMA_Channel_TypeDef *)DMA1_Channel5_BASE)
+#define DWT					((DWT_Type *)DWT_BASE)
+#define SysTick				((SysTick_Type *)SysTick_BASE)
+#define NVIC				((NVIC_Type *)NVIC_BASE)
+#define SCB					((SCB_Type *)SCB_BASE)
+#define CoreDebug			((CoreDebug_Type *)CoreDebug_BASE)
+#define DBGMCU				((DBGMCU_TypeDef *)DBGMCU_BASE)
+
+
+///--- Bits ---///
+
+#define RCC_CR_MSION				((uint32_t)0x00000100)
+#define RCC_CR_MSIRDY				((uint32_t)0x00000200)
+#define RCC_CR_HSEON				((uint32_t)0x00010000)
+#define RCC_CR_HSERDY				((uint32_t)0x00020000)
+#define RCC_CR_PLLON				((uint32_t)0x01000000)
+#define RCC_CR_PLLRDY				((uint32_t)0x02000000)
+#define RCC_CR_CSSON				((uint32_t)0x10000000)
+
+#define RCC_CFGR_SW					((uint32_t)0x00000003)
+#define RCC_CFGR_SW_MSI				((uint32_t)0x00000000)
+#define RCC_CFGR_SW_HSE				((uint32_t)0x00000002)
+#define RCC_CFGR_SW_PLL				((uint32_t)0x00000003)
+#define RCC_CFGR_SWS				((uint32_t)0x0000000C)
+#define RCC_CFGR_SWS_HSE			((uint32_t)0x00000008)
+#define RCC_CFGR_PLLSRC				((uint32_t)0x00010000)
+#define RCC_CFGR_PLLSRC_HSE			((uint32_t)0x00010000)
+#define RCC_CFGR_PLLMUL				((uint32_t)0x003C0000)
+#define RCC_CFGR_PLLMUL8			((uint32_t)0x000C0000)
+#define RCC_CFGR_PLLDIV				((uint32_t)0x00C00000)
+#define RCC_CFGR_PLLDIV3			((uint32_t)0x00800000)
+
+#define RCC_AHBRSTR_GPIOARST		((uint32_t)0x00000001)
+#define RCC_AHBRSTR_DMA1RST			((uint32_t)0x01000000)
+#define RCC_AHBENR_GPIOAEN			((uint32_t)0x00000001)
+#define RCC_AHBENR_DMA1EN			((uint32_t)0x01000000)
+#define RCC_APB2RSTR_USART1RST		((uint32_t)0x00004000)
+#define RCC_APB2ENR_SYSCFGEN		((uint32_t)0x00000001)
+#define RCC_APB2ENR_USART1EN		((uint32_t)0x00004000)
+#define RCC_APB1RSTR_USART2RST		((uint32_t)0x00020000)
+#define RCC_APB1ENR_USART2EN		((uint32_t)0x00020000)
+#define RCC_APB1ENR_PWREN			((uint32_t)0x10000000)
+
+#define RCC_CSR_LSION				((uint32_t)0x00000001)
+#define RCC_CSR_LSIRDY				((uint32_t)0x00000002)
+#define RCC_CSR_LSEON				((uint32_t)0x00000100)
+#define RCC_CSR_RTCSEL_0			((uint32_t)0x00010000)
+#define RCC_CSR_RTCSEL_1			((uint32_t)0x00020000)
+#define RCC_CSR_RTCEN				((uint32_t)0x00400000)
+#define RCC_CSR_RTCRST				((uint32_t)0x00800000)
+#define RCC_CSR_RMVF				((uint32_t)0x01000000)
+#define RCC_CSR_OBLRSTF				((uint32_t)0x02000000)
+#define RCC_CSR_PINRSTF				((uint32_t)0x04000000)
+#define RCC_CSR_PORRSTF				((uint32_t)0x08000000)
+#define RCC_CSR_SFTRSTF				((uint32_t)0x10000000)
+#define RCC_CSR_IWDGRSTF			((uint32_t)0x20000000)
+#define RCC_CSR_WWDGRSTF			((uint32_t)0x40000000)
+#define RCC_CSR_LPWRRSTF			((uint32_t)0x80000000)
+
+#define FLASH_ACR_LATENCY			((uint32_t)0x00000001)
+#define FLASH_ACR_PRFTEN			((uint32_t)0x00000002)
+#define FLASH_ACR_ACC64				((uint32_t)0x00000004)
+#define FLASH_PECR_PELOCK			((uint32_t)0x00000001)
+#define FLASH_PECR_PRGLOCK			((uint32_t)0x00000002)
+#define FLASH_PECR_PROG				((uint32_t)0x00000008)
+#define FLASH_PECR_ERASE			((uint32_t)0x00000200)
+#define FLASH_PECR_FPRG				((uint32_t)0x00000400)
+#define FLASH_SR_BSY				((uint32_t)0x00000001)
+#define FLASH_SR_WRPERR				((uint32_t)0x00000100)
+
+#define PWR_CR_LPSDSR				((uint32_t)0x00000001)
+#define PWR_CR_PDDS					((uint32_t)0x00000002)
+#define PWR_CR_CWUF					((uint32_t)0x00000004)
+#define PWR_CR_DBP					((uint32_t)0x00000100)
+#define PWR_CR_VOS					((uint32_t)0x00001800)
+#define PWR_CSR_VOSF				((uint32_t)0x00000010)
+
+#define USART_SR_PE					((uint16_t)0x0001)
+#define USART_SR_ORE				((uint16_t)0x0008)
+#define USART_SR_IDLE				((uint16_t)0x0010)
+#define USART_SR_RXNE				((uint16_t)0x0020)
+#define USART_SR_TC					((uint16_t)0x0040)
+#define USART_SR_TXE				((uint16_t)0x0080)
+#define USART_CR1_RE				((uint16_t)0x0004)
+#define USART_CR1_TE				((uint16_t)0x0008)
+#define USART_CR1_IDLEIE			((uint16_t)0x0010)
+#define USART_CR1_RXNEIE			((uint16_t)0x0020)
+#define USART_CR1_TCIE				((uint16_t)0x0040)
+#define USART_CR1_TXEIE				((uint16_t)0x0080)
+#define USART_CR1_PEIE				((uint16_t)0x0100)
+#define USART_CR1_PCE				((uint16_t)0x0400)
+#define USART_CR1_M					((uint16_t)0x1000)
+#define USART_CR1_UE				((uint16_t)0x2000)
+#define USART_CR2_LBCL				((uint16_t)0x0100)
+#define USART_CR2_CLKEN				((uint16_t)0x0800)
+#define USART_CR2_STOP				((uint16_t)0x3000)
+#define USART_CR3_NACK				((uint16_t)0x0010)
+#define USART_CR3_SCEN				((uint16_t)0x0020)
+#define USART_CR3_DMAR				((uint16_t)0x0040)
+#define USART_CR3_DMAT				((uint16_t)0x0080)
+
+#define DMA_CCR_EN					((uint32_t)0x00000001)
+#define DMA_CCR_DIR					((uint32_t)0x00000010)
+#define DMA_CCR_CIRC				((uint32_t)0x00000020)
+#define DMA_CCR_MINC				((uint32_t)0x00000080)
+#define DMA_CCR_PL_0				((uint32_t)0x00001000)
+#define DMA_CNDTR1_NDT				((uint32_t)0x0000FFFF)
+#define DMA_CNDTR4_NDT				((uint32_t)0x0000FFFF)
+#define DMA_CPAR4_PA				((uint32_t)0xFFFFFFFF)
+#define DMA_CPAR5_PA				((uint32_t)0xFFFFFFFF)
+#define DMA_CMAR4_MA				((uint32_t)0xFFFFFFFF)
+#define DMA_CMAR5_MA				((uint32_t)0xFFFFFFFF)
+
+#define IWDG_KR_KEY					((uint32_t)0x0000FFFF)
+#define IWDG_RLR_RL					((uint32_t)0x00000FFF)
+#define IWDG_SR_PVU					((uint32_t)0x00000001)
+#define IWDG_SR_RVU					((uint32_t)0x00000002)
+
+#define SYSCFG_EXTICR1_EXTI0		((uint32_t)0x0000000F)
+#define SYSCFG_EXTICR3_EXTI10		((uint32_t)0x00000F00)
+
+#define EXTI_IMR_MR0				((uint32_t)0x00000001)
+#define EXTI_IMR_MR10				((uint32_t)0x00000400)
+#define EXTI_IMR_MR20				((uint32_t)0x00100000)
+#define EXTI_RTSR_TR0				((uint32_t)0x00000001)
+#define EXTI_RTSR_TR20				((uint32_t)0x00100000)
+#define EXTI_FTSR_TR0				((uint32_t)0x00000001)
+#define EXTI_FTSR_TR10				((uint32_t)0x00000400)
+#define EXTI_PR_PR0					((uint32_t)0x00000001)
+#define EXTI_PR_PR10				((uint32_t)0x00000400)
+#define EXTI_PR_PR20				((uint32_t)0x00100000)
+
+#define RTC_CR_WUCKSEL				((uint32_t)0x00000007)
+#define RTC_CR_FMT					((uint32_t)0x00000040)
+#define RTC_CR_WUTE					((uint32_t)0x00000400)
+#define RTC_CR_WUTIE				((uint32_t)0x00004000)
+#define RTC_ISR_WUTWF				((uint32_t)0x00000004)
+#define RTC_ISR_INITS				((uint32_t)0x00000010)
+#define RTC_ISR_RSF					((uint32_t)0x00000020)
+#define RTC_ISR_INITF				((uint32_t)0x00000040)
+#define RTC_ISR_INIT				((uint32_t)0x00000080)
+#define RTC_ISR_WUTF				((uint32_t)0x00000400)
+
+#define SCB_ICSR_PENDSVSET_Msk		((uint32_t)0x10000000)
+#define SCB_ICSR_ISRPENDING_Msk		((uint32_t)0x00400000)
+#define SCB_SCR_SLEEPONEXIT_Msk		((uint32_t)0x00000002)
+#define SCB_SCR_SLEEPDEEP_Msk		((uint32_t)0x00000004)
+#define DWT_CTRL_CYCCNTENA_Msk		((uint32_t)0x00000001)
+#define CoreDebug_DEMCR_TRCENA_Msk	((uint32_t)0x01000000)
+
+
+///--- Core functions ---///
+
+/// Core registers, which aren't memory-mapped
+struct HostCore_t
+{
+	uint32_t Primask;	///< PRIMASK
+	uint32_t Basepri;	///< BASEPRI
+	uint32_t Ipsr;		///< Active exception number (0 - thread mode)
+	uint32_t Msp;		///< Main stack pointer (the stack top, the host stack is used)
+};
+
+extern volatile HostCore_t HostCore;	///< Core registers (see Simulator)
+
+void HostWaitForInterrupt();	/// __WFI() (see Simulator::Idle)
+void HostSystemReset();			/// NVIC_SystemReset() (see Simulator)
+
+static inline void __disable_irq()					{ HostCore.Primask = 1; }
+static inline void __enable_irq()					{ HostCore.Primask = 0; }
+static inline uint32_t __get_PRIMASK()				{ return HostCore.Primask; }
+static inline void __set_PRIMASK(uint32_t value)	{ HostCore.Primask = value & 1; }
+static inline uint32_t __get_BASEPRI()				{ return HostCore.Basepri; }
+static inline void __set_BASEPRI(uint32_t value)	{ HostCore.Basepri = value & 0xFF; }
+static inline uint32_t __get_IPSR()					{ return HostCore.Ipsr; }
+static inline uint32_t __get_MSP()					{ return HostCore.Msp; }
+
+static inline void __set_BASEPRI_MAX(uint32_t value)
+{
+	value &= 0xFF;
+	if(value && (!HostCore.Basepri || (value < HostCore.Basepri)))
+	{
+		HostCore.Basepri = value;
+	}
+}
+
+static inline void __WFI()		{ HostWaitForInterrupt(); }
+static inline void __DSB()		{ __sync_synchronize(); }
+static inline void __DMB()		{ __sync_synchronize(); }
+static inline void __ISB()		{ }
+static inline void __NOP()		{ }
+static inline void __CLREX()	{ }
+
+/// Exclusive access: the simulated interrupts are taken between the statements only, so a store always succeeds
+static inline uint32_t __LDREXW(volatile uint32_t* address)					{ return *address; }
+static inline uint32_t __STREXW(uint32_t value, volatile uint32_t* address)	{ *address = value; return 0; }
+static inline uint8_t __CLZ(uint32_t value)									{ return value ? __builtin_clz(value) : 32; }
+
+static inline void NVIC_EnableIRQ(IRQn_Type irqn)		{ NVIC->ISER[irqn >> 5] |= 1UL << (irqn & 0x1F); }
+static inline void NVIC_DisableIRQ(IRQn_Type irqn)		{ NVIC->ISER[irqn >> 5] &= ~(1UL << (irqn & 0x1F)); }
+static inline void NVIC_SetPendingIRQ(IRQn_Type irqn)	{ NVIC->ISPR[irqn >> 5] |= 1UL << (irqn & 0x1F); }
+static inline void NVIC_ClearPendingIRQ(IRQn_Type irqn)	{ NVIC->ISPR[irqn >> 5] &= ~(1UL << (irqn & 0x1F)); }
+static inline void NVIC_SystemReset()					{ HostSystemReset(); }
+
+static inline void NVIC_SetPriority(IRQn_Type irqn, uint32_t priority)
+{
+	if(irqn < 0)
+	{
+		SCB->SHP[(irqn & 0x0F) - 4] = (uint8_t)(priority << (8 - __NVIC_PRIO_BITS));
+	}
+	else
+	{
+		NVIC->IP[irqn] = (uint8_t)(priority << (8 - __NVIC_PRIO_BITS));
+	}
+}
+
+static inline uint32_t NVIC_GetPriority(IRQn_Type irqn)
+{
+	return (irqn < 0 ? SCB->SHP[(irqn & 0x0F) - 4] : NVIC->IP[irqn]) >> (8 - __NVIC_PRIO_BITS);
+}
+
+#endif /* __STM32L1XX_H */
@@ -0,0 +1,691 @@
+/**
+* @file replay.cpp
+* @brief Captured card and bus replay
+* @note Plays a device capture (see Capture) back to the firmware drivers
+* in the host simulation and measures the tap latencies on the simulated time.
+*
+* The input holds the data of BUS_CAPTURE_DATA frames, one frame per line
+* in hex (spaces allowed, # starts a comment), in the reading order. Each card
+* reset starts a tap. The card bytes are presented with their captured delay
+* after the last firmware byte (or the reset), so the card procedure byte
+* timing, NULL bytes and PPS answers are reproduced. The bus bytes follow
+* the last transmitted frame the same way, a received burst is spread
+* back from its captured idle time. The echo of the transmitted card bytes
+* is made by the simulated line, so the captured one is skipped.
+*
+* A tap runs the reader sequence (activation and PPS, SELECT MF, SELECT EF ICCID,
+* READ BINARY, deactivation), then, if the controller has answered in
+* the capture, the decision request. The firmware card bytes are compared
+* with the captured ones, the bus ones are not (sequence and identifier differ).
+* One CSV line per tap:
+* tap,status,activation_us,exchange_us,decision_us,total_us,card_mismatches,baseline_us,change_percent,result
+* The simulated time follows the line timing and the firmware waiting,
+* not the host speed, so the results are repeatable. A previous output
+* passed as the baseline (--baseline file) is compared by total_us, a tap
+* slower than the threshold (--threshold percent, 10 by default) is
+* a regression and the exit code is 1.
+* The sample captures (Replay/sample*_capture.txt) with their baselines are
+* the CTest tests of the host build.
+*
+* Usage: replay [--baseline file] [--threshold percent] <capture.txt>
+*/
+
+#include "simulator.hpp"
+#include "card.hpp"
+#include "bus_line.hpp"
+#include "system_timer.hpp"
+#include "board.hpp"
+#include "iso7816.hpp"
+#include "uart.hpp"
+#include "bus.hpp"
+#include "capture.hpp"
+#include "access.hpp"
+#include "timer_service.hpp"
+#include "event_queue.hpp"
+#include "work_queue.hpp"
+#include "options.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/// Replay options
+enum Options_t
+{
+	REPLAY_MAX_EVENTS = 4096,		///< Max events per line and tap
+	REPLAY_MAX_TAPS = 256,			///< Max baseline taps
+	REPLAY_DECISION_TIMEOUT = 200000,	///< Controller decision timeout (us., see main.cpp)
+};
+
+
+/// Captured byte
+struct LineByte_t
+{
+	uint64_t Time;		///< Capture time (us.)
+	uint8_t Data;		///< Byte
+	bool Inbound;		///< Received by the firmware
+};
+
+
+/**
+* @brief Replayed line script
+* @note The inbound bytes are anchored to the last outbound byte
+* (or the script begin): captured delay after it, replayed after its replay
+*/
+class Script
+{
+	public:
+		/**
+		* @brief Script clearing
+		* @param origin - capture time of the script begin (us.)
+		*/
+		void Clear(uint64_t origin)
+		{
+			Origin = origin;
+			Count = 0;
+			Inbound = 0;
+			Mismatches = 0;
+			Position = 0;
+		};
+		
+		/**
+		* @brief Byte adding
+		* @param time - capture time (us.)
+		* @param data - byte
+		* @param inbound - true, if received by the firmware
+		*/
+		void Add(uint64_t time, uint8_t data, bool inbound)
+		{
+			if(Count < REPLAY_MAX_EVENTS)
+			{
+				Events[Count].Time = time;
+				Events[Count].Data = data;
+				Events[Count].Inbound = inbound;
+				Count++;
+				Inbound += inbound;
+			}
+		};
+		
+		/**
+		* @brief Replay beginning
+		* @param now - replay time (us.)
+		*/
+		void Begin(uint64_t now)
+		{
+			Position = 0;
+			Mismatches = 0;
+			CapturedAnchor = Origin;
+			ReplayAnchor = now;
+		};
+		
+		/**
+		* @brief Outbound byte following
+		* @param data - byte, transmitted by the firmware
+		* @param now - replay time (us.)
+		* @param charTime - character time (us., 0 - no bursts)
+		* @note A byte of the captured burst keeps the burst anchor
+		*/
+		void Follow(uint8_t data, uint64_t now, uint32_t charTime)
+		{
+			if((Position >= Count) || Events[Position].Inbound)
+			{
+				Mismatches++;
+				ReplayAnchor = now;
+				return;
+			}
+			
+			if(!IsBurst(Position, charTime))
+			{
+				CapturedAnchor = Events[Position].Time;
+				ReplayAnchor = now;
+			}
+			if(Events[Position].Data != data)
+			{
+				Mismatches++;
+			}
+			Position++;
+		};
+		
+		/**
+		* @brief Next inbound byte taking
+		* @param charTime - character time (us., 0 - no bursts), the burst is stamped
+		* at its line idle, so its bytes end a character time apart before the first stamp
+		* @param time - destination replay time pointer (us.)
+		* @param data - destination byte pointer
+		* @return true, if the next byte is inbound
+		*/
+		bool Take(uint32_t charTime, uint64_t* time, uint8_t* data)
+		{
+			if((Position >= Count) || !Events[Position].Inbound)
+			{
+				return false;
+			}
+			
+			uint32_t first = Position;
+			while(IsBurst(first, charTime))
+			{
+				first--;
+			}
+			uint32_t end = Position + 1;
+			while((end < Count) && IsBurst(end, charTime))
+			{
+				end++;
+			}
+			
+			int64_t delay = (int64_t)(Events[first].Time - CapturedAnchor) - (int64_t)(end - Position) * charTime;
+			*time = ReplayAnchor + (delay > 0 ? delay : 0);
+			*data = Events[Position].Data;
+			Position++;
+			return true;
+		};
+		
+		/**
+		* @brief Get received bytes count
+		* @return inbound bytes count
+		*/
+		uint32_t GetInbound()
+		{
+			return Inbound;
+		};
+		
+		/**
+		* @brief Get mismatching outbound bytes count
+		* @return bytes count
+		*/
+		uint32_t GetMismatches()
+		{
+			return Mismatches;
+		};
+	
+	private:
+		/**
+		* @brief Check, whether the byte continues the previous one burst
+		* @param index - byte index
+		* @param charTime - character time (us., 0 - no bursts)
+		* @return true, if the bytes go the same way closer than a half of the character time
+		* @note The device stamps a burst in a loop, the line keeps its bytes a character time apart
+		*/
+		bool IsBurst(uint32_t index, uint32_t charTime)
+		{
+			return index && (Events[index - 1].Inbound == Events[index].Inbound) && (Events[index].Time - Events[index - 1].Time < charTime / 2);
+		};
+		
+		LineByte_t Events[REPLAY_MAX_EVENTS];	///< Captured bytes
+		uint32_t Count;					///< Captured bytes count
+		uint32_t Inbound;				///< Inbound bytes count
+		uint32_t Position;				///< Next byte
+		uint32_t Mismatches;			///< Outbound bytes, which differ from the captured ones
+		uint64_t Origin;				///< Script begin (capture time, us.)
+		uint64_t CapturedAnchor;		///< Last outbound byte (capture time, us.)
+		uint64_t ReplayAnchor;			///< Last outbound byte (replay time, us.)
+};
+
+
+/**
+* @brief Replayed card
+*/
+class ReplayCard : public SimCard
+{
+	public:
+		ReplayCard() : Line(0)
+		{
+		};
+		
+		/**
+		* @brief Script setting
+		* @param line - card line script
+		*/
+		void Load(Script* line)
+		{
+			Line = line;
+		};
+	
+	protected:
+		virtual void Reset()
+		{
+			Line->Begin(Simulator::GetMicros());
+			Schedule();
+		};
+		
+		virtual void Receive(uint8_t data)
+		{
+			Line->Follow(data, Simulator::GetMicros(), 0);
+			Schedule();
+		};
+	
+	private:
+		/**
+		* @brief Card bytes up to the next firmware byte queuing
+		*/
+		void Schedule()
+		{
+			uint64_t time;
+			uint8_t data;
+			while(Line->Take(0, &time, &data))
+			{
+				SendAt(time, data);
+			}
+		};
+		
+		Script* Line;	///< Card line script
+};
+
+
+/**
+* @brief Replayed controller
+*/
+class ReplayBus : public SimBusLine
+{
+	public:
+		ReplayBus() : Line(0)
+		{
+		};
+		
+		/**
+		* @brief Script starting
+		* @param line - bus line script
+		*/
+		void Start(Script* line)
+		{
+			Line = line;
+			Line->Begin(Simulator::GetMicros());
+			Schedule();
+		};
+	
+	protected:
+		virtual void Transmit(uint8_t data)
+		{
+			Line->Follow(data, Simulator::GetMicros(), GetCharTime());
+			Schedule();
+		};
+	
+	private:
+		/**
+		* @brief Controller bytes up to the next firmware byte queuing
+		*/
+		void Schedule()
+		{
+			uint64_t time;
+			uint8_t data;
+			while(Line->Take(GetCharTime(), &time, &data))
+			{
+				SendAt(time, data);
+			}
+		};
+		
+		Script* Line;	///< Bus line script
+};
+
+
+/// Baseline entry
+struct Baseline_t
+{
+	uint32_t Tap;		///< Tap number
+	uint64_t Total;		///< Tap time (us.)
+};
+
+
+static ReplayCard Card;							///< Replayed card
+static ReplayBus Controller;					///< Replayed controller
+static Script CardLine;							///< Card line script of the tap
+static Script BusLine;							///< Bus line script of the tap
+static Baseline_t Baseline[REPLAY_MAX_TAPS];	///< Baseline entries
+static uint32_t BaselineCount;					///< Baseline entries count
+
+
+/// MF and EF ICCID identifiers (see main.cpp)
+static const char MF[] = {0x3F, 0x00};
+static const char EFiccid[] = {0x2F, (char)0xE2};
+
+/// Reader status names (see ReaderStatus_t)
+static const char* const STATUS[] = {"ok", "activation_error", "mf_error", "ef_error", "read_error"};
+
+
+/**
+* @brief Capture reading
+* @param file - capture file
+* @param records - destination records buffer
+* @param times - destination capture times buffer (us., extended to 64 bits)
+* @param count - buffers size (records)
+* @return records count
+*/
+static uint32_t ReadCapture(FILE* file, CaptureRecord_t* records, uint64_t* times, uint32_t count)
+{
+	uint32_t result = 0;
+	uint64_t time = 0;
+	uint32_t previous = 0;
+	char line[2048];
+	
+	while(fgets(line, sizeof(line), file))
+	{
+		uint8_t data[Bus::MAX_DATA];
+		uint32_t length = 0;
+		for(char* chr = line; *chr && (*chr != '#') && (length < sizeof(data));)
+		{
+			unsigned value;
+			int used;
+			if(sscanf(chr, " %2x%n", &value, &used) != 1)
+			{
+				break;
+			}
+			data[length++] = (uint8_t)value;
+			chr += used;
+		}
+		
+		if(length < sizeof(uint16_t))
+		{
+			continue;
+		}
+		
+		uint16_t lost;
+		memcpy(&lost, data, sizeof(lost));
+		if(lost)
+		{
+			fprintf(stderr, "replay: %u records were dropped by the device, the capture is incomplete\n", (unsigned)lost);
+		}
+		
+		for(uint32_t offset = sizeof(lost); (offset + sizeof(CaptureRecord_t) <= length) && (result < count); offset += sizeof(CaptureRecord_t))
+		{
+			CaptureRecord_t* record = &records[result];
+			memcpy(record, &data[offset], sizeof(CaptureRecord_t));
+			time += result ? (uint32_t)(record->Time - previous) : 0;
+			previous = record->Time;
+			times[result++] = time;
+		}
+	}
+	
+	return result;
+}
+
+
+/**
+* @brief Baseline loading
+* @param fileName - previous output file name
+* @return true, if the file is read
+*/
+static bool LoadBaseline(const char* fileName)
+{
+	FILE* file = fopen(fileName, "r");
+	if(!file)
+	{
+		return false;
+	}
+	
+	char line[256];
+	while(fgets(line, sizeof(line), file) && (BaselineCount < REPLAY_MAX_TAPS))
+	{
+		unsigned tap;
+		unsigned long long total;
+		if(sscanf(line, "%u,%*[^,],%*[^,],%*[^,],%*[^,],%llu", &tap, &total) == 2)
+		{
+			Baseline[BaselineCount].Tap = tap;
+			Baseline[BaselineCount].Total = total;
+			BaselineCount++;
+		}
+	}
+	
+	fclose(file);
+	return true;
+}
+
+
+/**
+* @brief Baseline searching
+* @param tap - tap number
+* @return tap time (us., 0 - not found)
+*/
+static uint64_t FindBaseline(uint32_t tap)
+{
+	for(uint32_t index = 0; index < BaselineCount; index++)
+	{
+		if(Baseline[index].Tap == tap)
+		{
+			return Baseline[index].Total;
+		}
+	}
+	return 0;
+}
+
+
+/**
+* @brief Controller decision request
+* @param credential - credential pointer
+* @return true, if the controller has answered
+* @note The waiting loops poll the time, so the line model progresses
+*/
+static bool AskController(const Credential_t* credential)
+{
+	while(Uart1.IsTransmitting())
+	{
+		SystemTimer::GetMicros();
+	}
+	
+	uint8_t data[sizeof(CredentialId_t) + sizeof(Credential_t)];
+	CredentialId_t id = CREDENTIAL_NONE;
+	memcpy(data, &id, sizeof(id));
+	memcpy(&data[sizeof(id)], credential, sizeof(Credential_t));
+	uint8_t sequence = Bus::Request(BUS_DECISION_REQUEST, data, sizeof(data));
+	
+	for(uint64_t waitTo = SystemTimer::GetMicros() + REPLAY_DECISION_TIMEOUT; SystemTimer::GetMicros() < waitTo;)
+	{
+		BusFrame_t frame;
+		if(Bus::Receive(&frame) && (frame.Header.Command == BUS_DECISION) && (frame.Header.Sequence == sequence))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+
+/**
+* @brief Tap replaying
+* @param tap - tap number
+* @param threshold - regression threshold (percent)
+* @return true, if the tap is a regression
+*/
+static bool ReplayTap(uint32_t tap, double threshold)
+{
+	Card.Load(&CardLine);
+	Controller.Start(&BusLine);
+	
+	/// Reader sequence (see ReadCredential in main.cpp)
+	uint64_t start = SystemTimer::GetMicros();
+	ReaderStatus_t status = READER_OK;
+	Credential_t credential;
+	memset(&credential, 0, sizeof(credential));
+	
+	bool activated = ISO7816_1.ActivateCard();
+	uint64_t activation = SystemTimer::GetMicros();
+	if(!activated)
+	{
+		status = READER_ACTIVATION_ERROR;
+	}
+	else if(!ISO7816_1.SelectFile(0xA0, 0x00, 0x00, MF, sizeof(MF)))
+	{
+		status = READER_MF_ERROR;
+	}
+	else if(!ISO7816_1.SelectFile(0xA0, 0x00, 0x00, EFiccid, sizeof(EFiccid)))
+	{
+		status = READER_EF_ERROR;
+	}
+	else if(ISO7816_1.ReadBinary(0xA0, credential.Value, sizeof(credential.Value)) == -1)
+	{
+		status = READER_READ_ERROR;
+	}
+	ISO7816_1.DeactivateCard();
+	uint64_t exchange = SystemTimer::GetMicros();
+	
+	/// Controller decision, if it has answered in the capture
+	char decision[24] = "";
+	if((status == READER_OK) && BusLine.GetInbound())
+	{
+		bool answered = AskController(&credential);
+		snprintf(decision, sizeof(decision), answered ? "%llu" : "timeout", (unsigned long long)(SystemTimer::GetMicros() - exchange));
+	}
+	uint64_t total = SystemTimer::GetMicros() - start;
+	
+	printf("%u,%s,%llu,%llu,%s,%llu,%u", (unsigned)tap, STATUS[status], (unsigned long long)(activation - start),
+		(unsigned long long)(exchange - activation), decision, (unsigned long long)total, (unsigned)CardLine.GetMismatches());
+	
+	bool slower = false;
+	uint64_t baseline = FindBaseline(tap);
+	if(baseline)
+	{
+		double change = ((double)total - baseline) * 100 / baseline;
+		slower = change > threshold;
+		printf(",%llu,%+.1f,%s\n", (unsigned long long)baseline, change, slower ? "regression" : "ok");
+	}
+	else
+	{
+		printf(",,,new\n");
+	}
+	
+	/// The rest of the capture is played out, the bus receiver is cleaned for the next tap
+	while(Controller.GetNextEvent() != Simulator::NO_EVENT)
+	{
+		Simulator::Advance(Controller.GetNextEvent() - Simulator::GetMicros() + 1);
+	}
+	Uart1.Flush();
+	
+	return slower;
+}
+
+
+int main(int argc, char** argv)
+{
+	const char* baselineName = 0;
+	const char* captureName = 0;
+	double threshold = 10;
+	
+	for(int index = 1; index < argc; index++)
+	{
+		if(!strcmp(argv[index], "--baseline") && (index + 1 < argc))
+		{
+			baselineName = argv[++index];
+		}
+		else if(!strcmp(argv[index], "--threshold") && (index + 1 < argc))
+		{
+			threshold = atof(argv[++index]);
+		}
+		else if(!captureName && (argv[index][0] != '-'))
+		{
+			captureName = argv[index];
+		}
+		else
+		{
+			captureName = 0;
+			break;
+		}
+	}
+	
+	if(!captureName)
+	{
+		fprintf(stderr, "usage: %s [--baseline file] [--threshold percent] <capture.txt>\n", argv[0]);
+		return 2;
+	}
+	
+	if(baselineName && !LoadBaseline(baselineName))
+	{
+		fprintf(stderr, "replay: %s can't be read\n", baselineName);
+		return 2;
+	}
+	
+	FILE* file = fopen(captureName, "r");
+	if(!file)
+	{
+		fprintf(stderr, "replay: %s can't be read\n", captureName);
+		return 2;
+	}
+	
+	static CaptureRecord_t records[REPLAY_MAX_EVENTS * 2];
+	static uint64_t times[REPLAY_MAX_EVENTS * 2];
+	uint32_t count = ReadCapture(file, records, times, REPLAY_MAX_EVENTS * 2);
+	fclose(file);
+	
+	Simulator::Init();
+	EventQueue::Init();
+	WorkQueue::Init();
+	SystemTimer::Init();
+	TimerService::Init();
+	Board::Init();
+	Bus::Init(DEFAULT_DEVICE_ID);
+	Simulator::Attach(&Card);
+	Simulator::Attach(&Controller);
+	
+	printf("tap,status,activation_us,exchange_us,decision_us,total_us,card_mismatches,baseline_us,change_percent,result\n");
+	
+	/// A tap lasts from a card reset to the next one, the echo of the firmware card bytes is skipped
+	bool regression = false;
+	uint32_t taps = 0;
+	uint32_t echo = 0;
+	for(uint32_t index = 0; index <= count; index++)
+	{
+		if((index == count) || (records[index].Channel == CAPTURE_CARD_RESET))
+		{
+			if(taps)
+			{
+				regression |= ReplayTap(taps, threshold);
+			}
+			if(index == count)
+			{
+				break;
+			}
+			
+			taps++;
+			echo = 0;
+			CardLine.Clear(times[index]);
+			BusLine.Clear(times[index]);
+			continue;
+		}
+		
+		if(!taps)
+		{
+			continue;
+		}
+		
+		const CaptureRecord_t* record = &records[index];
+		switch(record->Channel)
+		{
+			case CAPTURE_CARD_TX:
+			{
+				echo++;
+				CardLine.Add(times[index], record->Data, false);
+				break;
+			}
+			
+			case CAPTURE_CARD_RX:
+			{
+				if(echo)
+				{
+					echo--;
+				}
+				else
+				{
+					CardLine.Add(times[index], record->Data, true);
+				}
+				break;
+			}
+			
+			case CAPTURE_BUS_TX:
+			case CAPTURE_BUS_RX:
+			{
+				BusLine.Add(times[index], record->Data, record->Channel == CAPTURE_BUS_RX);
+				break;
+			}
+			
+			default:
+			{
+				break;
+			}
+		}
+	}
+	
+	if(!taps)
+	{
+		fprintf(stderr, "replay: no card reset in the capture\n");
+		return 2;
+	}
+	
+	return regression ? 1 : 0;
+}
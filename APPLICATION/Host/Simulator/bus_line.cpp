@@ -0,0 +1,182 @@
+/**
+* @file bus_line.cpp
+* @brief Simulated bus line implementation
+*/
+
+#include "bus_line.hpp"
+#include "clock.hpp"
+
+
+/**
+* @brief Constructor
+*/
+SimBusLine::SimBusLine() : Head(0), Tail(0), RxReload(0), RxEnabled(false), IdleTime(Simulator::NO_EVENT), IdleRaised(false),
+	TxIndex(0), TxCount(0), TxBusyUntil(0), TxEnding(false), Now(0)
+{
+}
+
+
+/**
+* @brief Character time
+* @return time (us.)
+* @note BRR is the clock to baudrate ratio (see Uart::SetBaudrate)
+*/
+uint32_t SimBusLine::GetCharTime()
+{
+	return (uint32_t)(((uint64_t)CHAR_BITS * USART1->BRR * 1000000) / Clock::GetFrequency());
+}
+
+
+/**
+* @brief Check, whether the interface is enabled
+* @return true, if enabled
+*/
+bool SimBusLine::IsActive()
+{
+	return (RCC->APB2ENR & RCC_APB2ENR_USART1EN) && (USART1->CR1 & USART_CR1_UE);
+}
+
+
+/**
+* @brief Check, whether the interrupt is pending
+* @return true, if pending
+*/
+bool SimBusLine::IsPending()
+{
+	return NVIC->ISPR[USART1_IRQn >> 5] & (1UL << (USART1_IRQn & 0x1F));
+}
+
+
+/**
+* @brief Byte to the firmware queuing
+* @param time - receiving end time (us.)
+* @param data - byte
+* @note The bytes are kept a character time apart, a full queue drops the byte
+*/
+void SimBusLine::SendAt(uint64_t time, uint8_t data)
+{
+	uint64_t last = Head != Tail ? Queue[(Head - 1) & (QUEUE_SIZE - 1)].Time + GetCharTime() : Now;
+	if(Head - Tail < QUEUE_SIZE)
+	{
+		Queue[Head & (QUEUE_SIZE - 1)].Time = time > last ? time : last;
+		Queue[Head & (QUEUE_SIZE - 1)].Data = data;
+		Head++;
+	}
+}
+
+
+/**
+* @brief State advancing
+* @param now - current time (us.)
+*/
+void SimBusLine::Step(uint64_t now)
+{
+	Now = now;
+	
+	if(!IsActive())
+	{
+		Head = Tail;
+		IdleTime = Simulator::NO_EVENT;
+		return;
+	}
+	
+	///--- RX ---///
+	/// The buffer size is the count at the channel enabling
+	bool rxEnabled = (DMA1_Channel5->CCR & DMA_CCR_EN) && (USART1->CR3 & USART_CR3_DMAR);
+	if(rxEnabled && !RxEnabled)
+	{
+		RxReload = DMA1_Channel5->CNDTR;
+	}
+	RxEnabled = rxEnabled;
+	
+	while((Head != Tail) && (Queue[Tail & (QUEUE_SIZE - 1)].Time <= Now))
+	{
+		uint8_t data = Queue[Tail & (QUEUE_SIZE - 1)].Data;
+		Tail++;
+		if(!RxEnabled || !RxReload)
+		{
+			continue;
+		}
+		
+		uint8_t* buffer = (uint8_t *)(uintptr_t)DMA1_Channel5->CMAR;
+		buffer[RxReload - DMA1_Channel5->CNDTR] = data;
+		DMA1_Channel5->CNDTR = DMA1_Channel5->CNDTR > 1 ? DMA1_Channel5->CNDTR - 1 : RxReload;
+		IdleTime = Now + GetCharTime();
+	}
+	
+	/// IDLE is cleared by SR and DR reading in the handler
+	if(IdleRaised && !IsPending())
+	{
+		USART1->SR &= ~USART_SR_IDLE;
+		IdleRaised = false;
+	}
+	if(Now >= IdleTime)
+	{
+		IdleTime = Simulator::NO_EVENT;
+		USART1->SR |= USART_SR_IDLE;
+		if(USART1->CR1 & USART_CR1_IDLEIE)
+		{
+			IdleRaised = true;
+			Simulator::Raise(USART1_IRQn);
+		}
+	}
+	
+	///--- TX ---///
+	/// A new transfer is the count set after the previous one has ended
+	uint32_t count = (DMA1_Channel4->CCR & DMA_CCR_EN) ? DMA1_Channel4->CNDTR : 0;
+	if(count && !TxCount)
+	{
+		TxIndex = 0;
+	}
+	TxCount = count;
+	
+	if(Now < TxBusyUntil)
+	{
+		return;
+	}
+	
+	if(TxEnding)
+	{
+		TxEnding = false;
+		USART1->SR |= USART_SR_TC;
+		if(USART1->CR1 & USART_CR1_TCIE)
+		{
+			Simulator::Raise(USART1_IRQn);
+		}
+	}
+	
+	if(count && (USART1->CR3 & USART_CR3_DMAT))
+	{
+		uint8_t* buffer = (uint8_t *)(uintptr_t)DMA1_Channel4->CMAR;
+		uint8_t data = buffer[TxIndex++];
+		DMA1_Channel4->CNDTR = count - 1;
+		TxCount = count - 1;
+		TxBusyUntil = Now + GetCharTime();
+		TxEnding = (count == 1);
+		Transmit(data);
+	}
+}
+
+
+/**
+* @brief Next own event time
+* @return time (us., NO_EVENT - none)
+*/
+uint64_t SimBusLine::GetNextEvent()
+{
+	if(!IsActive())
+	{
+		return Simulator::NO_EVENT;
+	}
+	
+	uint64_t next = IdleTime;
+	if(TxCount || TxEnding)
+	{
+		next = TxBusyUntil < next ? TxBusyUntil : next;
+	}
+	if((Head != Tail) && (Queue[Tail & (QUEUE_SIZE - 1)].Time < next))
+	{
+		next = Queue[Tail & (QUEUE_SIZE - 1)].Time;
+	}
+	return next;
+}
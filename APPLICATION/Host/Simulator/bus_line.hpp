@@ -0,0 +1,65 @@
+/**
+* @file bus_line.hpp
+* @brief Simulated bus line header
+*/
+
+#ifndef __BUS_LINE_HPP
+#define __BUS_LINE_HPP
+
+#include "simulator.hpp"
+#include <stdint.h>
+
+
+/**
+* @brief Simulated bus line
+* @note Plays USART1 with the DMA channels, the way Uart uses them:
+* the bytes, queued by Send(), are written by the receive channel (5)
+* to its circular buffer, the line idle follows the last one by a character
+* time. The transmit channel (4) takes a byte per character time, each one
+* is passed to Transmit(), the transfer end raises TC.
+*/
+class SimBusLine : public SimDevice
+{
+	public:
+		SimBusLine();
+		
+		virtual void Step(uint64_t now);
+		virtual uint64_t GetNextEvent();
+	
+	protected:
+		virtual void Transmit(uint8_t data) = 0;		/// Byte from the firmware
+		void SendAt(uint64_t time, uint8_t data);		/// Byte to the firmware queuing
+		uint32_t GetCharTime();							/// Character time (us.)
+	
+	private:
+		enum Options_t
+		{
+			QUEUE_SIZE = 1024,		///< Receive queue size (power of 2)
+			CHAR_BITS = 10,			///< Character length (start, 8 data bits, stop)
+		};
+		
+		/// Queued byte
+		struct Char_t
+		{
+			uint64_t Time;			///< Receiving end time (us.)
+			uint8_t Data;			///< Byte
+		};
+		
+		bool IsActive();			/// Check, whether the interface is enabled
+		bool IsPending();			/// Check, whether the interrupt is pending
+		
+		Char_t Queue[QUEUE_SIZE];	///< Bytes to the firmware
+		uint32_t Head;				///< Queued bytes
+		uint32_t Tail;				///< Received bytes
+		uint32_t RxReload;			///< Receive channel buffer size
+		bool RxEnabled;				///< Receive channel was enabled
+		uint64_t IdleTime;			///< Line idle time (NO_EVENT - none)
+		bool IdleRaised;			///< IDLE is raised
+		uint32_t TxIndex;			///< Transmit channel position
+		uint32_t TxCount;			///< Transmit channel count seen
+		uint64_t TxBusyUntil;		///< Character transmission end (us.)
+		bool TxEnding;				///< The last character is being transmitted
+		uint64_t Now;				///< Model time (us.)
+};
+
+#endif /* __BUS_LINE_HPP */
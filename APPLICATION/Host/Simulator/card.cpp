@@ -0,0 +1,385 @@
+/**
+* @file card.cpp
+* @brief Simulated smart card implementation
+*/
+
+#include "card.hpp"
+#include "clock.hpp"
+#include <string.h>
+
+
+/**
+* @brief Constructor
+*/
+SimCard::SimCard() : Head(0), Tail(0), State(STATE_IDLE), Now(0), TxBusyUntil(0), Powered(false), Instant(false)
+{
+}
+
+
+/**
+* @brief Card insertion
+* @note Card detect is active low (see Board), the edge is latched by EXTI0
+*/
+void SimCard::Insert()
+{
+	GPIOA->IDR &= ~(1UL << 0);
+	EXTI->PR |= EXTI_PR_PR0;
+	if(EXTI->IMR & EXTI_IMR_MR0)
+	{
+		Simulator::Raise(EXTI0_IRQn);
+	}
+}
+
+
+/**
+* @brief Card removal
+*/
+void SimCard::Remove()
+{
+	GPIOA->IDR |= 1UL << 0;
+	EXTI->PR |= EXTI_PR_PR0;
+	if(EXTI->IMR & EXTI_IMR_MR0)
+	{
+		Simulator::Raise(EXTI0_IRQn);
+	}
+}
+
+
+/**
+* @brief Character time
+* @return time (us.), 0 in the instant mode
+* @note The baudrate divider is the system clocks count per etu (see ISO7816::SetEtu)
+*/
+uint32_t SimCard::GetCharTime()
+{
+	if(Instant)
+	{
+		return 0;
+	}
+	return (uint32_t)(((uint64_t)CHAR_ETU * USART2->BRR * 1000000) / Clock::GetFrequency());
+}
+
+
+/**
+* @brief Check, whether the interface is powered and enabled
+* @return true, if active
+*/
+bool SimCard::IsActive()
+{
+	return (GPIOA->ODR & (1UL << 5)) && (RCC->APB1ENR & RCC_APB1ENR_USART2EN) && (USART2->CR1 & USART_CR1_UE);
+}
+
+
+/**
+* @brief Byte queuing
+* @param time - presenting time (us.)
+* @param data - byte
+* @note A full queue drops the byte, as the line would lose it
+*/
+void SimCard::Put(uint64_t time, uint8_t data)
+{
+	if(Head - Tail < QUEUE_SIZE)
+	{
+		Queue[Head & (QUEUE_SIZE - 1)].Time = time;
+		Queue[Head & (QUEUE_SIZE - 1)].Data = data;
+		Head++;
+	}
+}
+
+
+/**
+* @brief Bytes to the firmware queuing
+* @param data - source data pointer
+* @param count - bytes count
+* @note The bytes follow the queued ones and the current transmission back to back
+*/
+void SimCard::Send(const uint8_t* data, uint32_t count)
+{
+	uint32_t charTime = GetCharTime();
+	uint64_t time = Head != Tail ? Queue[(Head - 1) & (QUEUE_SIZE - 1)].Time : Now;
+	if(time < TxBusyUntil)
+	{
+		time = TxBusyUntil;
+	}
+	
+	while(count--)
+	{
+		time += charTime;
+		Put(time, *data++);
+	}
+}
+
+
+/**
+* @brief Byte to the firmware queuing at the time
+* @param time - presenting time (us.)
+* @param data - byte
+* @note The bytes are kept in the order, a byte can't be presented before the queued ones
+*/
+void SimCard::SendAt(uint64_t time, uint8_t data)
+{
+	uint64_t last = Head != Tail ? Queue[(Head - 1) & (QUEUE_SIZE - 1)].Time : Now;
+	Put(time > last ? time : last, data);
+}
+
+
+/**
+* @brief State advancing
+* @param now - current time (us.)
+*/
+void SimCard::Step(uint64_t now)
+{
+	Now = now;
+	
+	/// Power, reset and the interface enabling
+	bool powered = (GPIOA->ODR & (1UL << 5)) && (GPIOA->ODR & (1UL << 6));
+	if(!IsActive())
+	{
+		Head = Tail;
+		State = STATE_IDLE;
+		USART2->SR = 0;
+		Powered = powered;
+		return;
+	}
+	if(powered && !Powered)
+	{
+		Powered = true;
+		Reset();
+	}
+	Powered = powered;
+	
+	bool pending = NVIC->ISPR[USART2_IRQn >> 5] & (1UL << (USART2_IRQn & 0x1F));
+	switch(State)
+	{
+		case STATE_RX:
+		{
+			/// The handler has read the byte
+			if(!pending)
+			{
+				USART2->SR = 0;
+				State = STATE_IDLE;
+			}
+			break;
+		}
+		
+		case STATE_TX:
+		{
+			if(pending)
+			{
+				break;
+			}
+			
+			/// The handler has written a byte: echo it and pass it to the card
+			USART2->SR = 0;
+			State = STATE_IDLE;
+			if(USART2->DR != TX_IDLE)
+			{
+				uint8_t data = (uint8_t)USART2->DR;
+				TxBusyUntil = Now + GetCharTime();
+				Put(TxBusyUntil, data);
+				Receive(data);
+			}
+			break;
+		}
+		
+		default:
+		{
+			break;
+		}
+	}
+	
+	if(State != STATE_IDLE)
+	{
+		return;
+	}
+	
+	/// Reception first, the line is half-duplex
+	if((Head != Tail) && (Queue[Tail & (QUEUE_SIZE - 1)].Time <= Now))
+	{
+		USART2->DR = Queue[Tail & (QUEUE_SIZE - 1)].Data;
+		Tail++;
+		if(USART2->CR1 & USART_CR1_RXNEIE)
+		{
+			USART2->SR = USART_SR_RXNE;
+			State = STATE_RX;
+			Simulator::Raise(USART2_IRQn);
+		}
+	}
+	else if((Now >= TxBusyUntil) && (USART2->CR1 & (USART_CR1_TXEIE | USART_CR1_TCIE)))
+	{
+		USART2->DR = TX_IDLE;
+		USART2->SR = USART_SR_TXE | USART_SR_TC;
+		State = STATE_TX;
+		Simulator::Raise(USART2_IRQn);
+	}
+}
+
+
+/**
+* @brief Next own event time
+* @return time (us., NO_EVENT - none)
+*/
+uint64_t SimCard::GetNextEvent()
+{
+	if(!IsActive())
+	{
+		return Simulator::NO_EVENT;
+	}
+	if((State == STATE_IDLE) && (USART2->CR1 & (USART_CR1_TXEIE | USART_CR1_TCIE)))
+	{
+		return TxBusyUntil;
+	}
+	if(Head != Tail)
+	{
+		return Queue[Tail & (QUEUE_SIZE - 1)].Time;
+	}
+	return Simulator::NO_EVENT;
+}
+
+
+/// ATR: direct convention, TA1 = 0x96 (Fi 512, Di 32), TD1 - T=0 only (no TCK), 15 historical bytes
+static const uint8_t SCRIPTED_ATR[] =
+{
+	0x3B, 0x9F, 0x96, 0x00, 0x80, 0x31, 0xE0, 0x73, 0xFE, 0x21,
+	0x13, 0x57, 0x86, 0x81, 0x02, 0x86, 0x98, 0x44, 0x18,
+};
+
+/// Instructions
+enum ScriptedIns_t
+{
+	SCRIPTED_SELECT_FILE = 0xA4,
+	SCRIPTED_READ_BINARY = 0xB0,
+	SCRIPTED_GET_RESPONSE = 0xC0,
+};
+
+
+/**
+* @brief Constructor
+*/
+ScriptedCard::ScriptedCard() : Count(0), DataLeft(0), Negotiated(false), Response(0)
+{
+	static const uint8_t ICCID[ICCID_SIZE] = {0x98, 0x10, 0x14, 0x30, 0x21, 0x43, 0x65, 0x87, 0x09, 0xF1};
+	SetIccid(ICCID);
+}
+
+
+/**
+* @brief EF ICCID contents setting
+* @param iccid - ICCID (ICCID_SIZE bytes, BCD, low nibble first)
+*/
+void ScriptedCard::SetIccid(const uint8_t* iccid)
+{
+	memcpy(Iccid, iccid, ICCID_SIZE);
+}
+
+
+/**
+* @brief Card reset
+*/
+void ScriptedCard::Reset()
+{
+	Count = 0;
+	DataLeft = 0;
+	Negotiated = false;
+	Response = 0;
+	
+	Send(SCRIPTED_ATR, sizeof(SCRIPTED_ATR));
+}
+
+
+/**
+* @brief Byte from the firmware
+* @param data - byte
+*/
+void ScriptedCard::Receive(uint8_t data)
+{
+	/// Command data (SELECT FILE identifier)
+	if(DataLeft)
+	{
+		if(!--DataLeft)
+		{
+			Response = RESPONSE_SIZE;
+			Status(0x9F00 | RESPONSE_SIZE);
+		}
+		return;
+	}
+	
+	Buffer[Count++] = data;
+	
+	/// PPS request is confirmed as is
+	if(!Negotiated && (Buffer[0] == 0xFF))
+	{
+		if(Count == 4)
+		{
+			Send(Buffer, 4);
+			Negotiated = true;
+			Count = 0;
+		}
+		return;
+	}
+	
+	if(Count == sizeof(Buffer))
+	{
+		Count = 0;
+		Command();
+	}
+}
+
+
+/**
+* @brief Command header handling
+*/
+void ScriptedCard::Command()
+{
+	uint8_t ins = Buffer[1];
+	uint8_t length = Buffer[4];
+	
+	switch(ins)
+	{
+		case SCRIPTED_SELECT_FILE:
+		{
+			DataLeft = length;
+			Send(&ins, 1);
+			break;
+		}
+		
+		case SCRIPTED_READ_BINARY:
+		{
+			uint8_t data[256];
+			memset(data, 0xFF, sizeof(data));
+			memcpy(data, Iccid, length < ICCID_SIZE ? length : (uint8_t)ICCID_SIZE);
+			Send(&ins, 1);
+			Send(data, length);
+			Status(0x9000);
+			break;
+		}
+		
+		case SCRIPTED_GET_RESPONSE:
+		{
+			uint8_t data[256];
+			memset(data, 0, sizeof(data));
+			Send(&ins, 1);
+			Send(data, length);
+			Status(length <= Response ? 0x9000 : 0x6700);
+			Response = 0;
+			break;
+		}
+		
+		default:
+		{
+			Status(0x6D00);
+			break;
+		}
+	}
+}
+
+
+/**
+* @brief Status word sending
+* @param sw - SW1 SW2
+*/
+void ScriptedCard::Status(uint16_t sw)
+{
+	uint8_t data[2] = {(uint8_t)(sw >> 8), (uint8_t)sw};
+	Send(data, sizeof(data));
+}
@@ -0,0 +1,126 @@
+/**
+* @file card.hpp
+* @brief Simulated smart card header
+*/
+
+#ifndef __CARD_HPP
+#define __CARD_HPP
+
+#include "simulator.hpp"
+#include <stdint.h>
+
+
+/**
+* @brief Simulated smart card interface
+* @note Plays USART2 in the smart card mode and the card pins (see Board):
+* the bytes, sent by the firmware, are echoed back (single wire) and passed
+* to Receive(), the bytes, queued by Send(), are presented one by one
+* with RXNE. The line is half-duplex, so TXE is never presented during
+* the reception. A raised status is kept until the handler runs
+* (the NVIC pending bit is cleared). The card is reset on VCC and RST high.
+*/
+class SimCard : public SimDevice
+{
+	public:
+		SimCard();
+		
+		void Insert();						/// Card insertion (card detect low)
+		void Remove();						/// Card removal (card detect high)
+		
+		/**
+		* @brief Instant mode setting
+		* @param instant - true, if the bytes take no time on the line
+		* @note Measures the firmware only, the line time is left out
+		*/
+		void SetInstant(bool instant)
+		{
+			Instant = instant;
+		};
+		
+		virtual void Step(uint64_t now);
+		virtual uint64_t GetNextEvent();
+	
+	protected:
+		virtual void Reset() = 0;						/// Card reset (VCC and RST high)
+		virtual void Receive(uint8_t data) = 0;			/// Byte from the firmware
+		void Send(const uint8_t* data, uint32_t count);	/// Bytes to the firmware queuing
+		void SendAt(uint64_t time, uint8_t data);		/// Byte to the firmware queuing at the time
+		uint32_t GetCharTime();							/// Character time (us.)
+	
+	private:
+		enum Options_t
+		{
+			QUEUE_SIZE = 256,		///< Receive queue size (power of 2)
+			CHAR_ETU = 12,			///< Character time (etu, guard time included)
+			TX_IDLE = 0xFFFF,		///< Data register value of no transmission
+		};
+		
+		/// Interface state
+		enum State_t
+		{
+			STATE_IDLE,				///< Nothing raised
+			STATE_RX,				///< RXNE raised
+			STATE_TX,				///< TXE raised
+		};
+		
+		/// Queued byte
+		struct Char_t
+		{
+			uint64_t Time;			///< Presenting time (us.)
+			uint8_t Data;			///< Byte
+		};
+		
+		void Put(uint64_t time, uint8_t data);	/// Byte queuing
+		bool IsActive();						/// Check, whether the interface is powered and enabled
+		
+		Char_t Queue[QUEUE_SIZE];	///< Bytes to the firmware
+		uint32_t Head;				///< Queued bytes
+		uint32_t Tail;				///< Presented bytes
+		State_t State;				///< Interface state
+		uint64_t Now;				///< Model time (us.)
+		uint64_t TxBusyUntil;		///< Transmission end (us.)
+		bool Powered;				///< VCC and RST were high
+		bool Instant;				///< The bytes take no time
+};
+
+
+/**
+* @brief Scripted SIM card
+* @note Answers the reset with a fixed T=0 ATR (only the fields, which ISO7816
+* parses), confirms any PPS and serves SELECT FILE, READ BINARY (EF ICCID)
+* and GET RESPONSE, the rest are rejected with 6D00
+*/
+class ScriptedCard : public SimCard
+{
+	public:
+		ScriptedCard();
+		
+		void SetIccid(const uint8_t* iccid);	/// EF ICCID contents setting
+		
+		enum Options_t
+		{
+			ICCID_SIZE = 10,		///< EF ICCID size (bytes)
+		};
+	
+	protected:
+		virtual void Reset();
+		virtual void Receive(uint8_t data);
+	
+	private:
+		enum
+		{
+			RESPONSE_SIZE = 15,		///< SELECT FILE response size (bytes)
+		};
+		
+		void Command();				/// Command header handling
+		void Status(uint16_t sw);	/// Status word sending
+		
+		uint8_t Buffer[5];			///< Received header or PPS
+		uint8_t Count;				///< Received bytes count
+		uint8_t DataLeft;			///< Command data bytes expected
+		bool Negotiated;			///< PPS is done
+		uint8_t Iccid[ICCID_SIZE];	///< EF ICCID contents
+		uint8_t Response;			///< Response bytes for GET RESPONSE
+};
+
+#endif /* __CARD_HPP */
@@ -0,0 +1,366 @@
+/**
+* @file simulator.cpp
+* @brief Host simulation implementation
+*/
+
+#include "simulator.hpp"
+#include "core.hpp"
+#include "clock.hpp"
+#include "memory_map.h"
+#include <sys/mman.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/// Scatter file region bounds (see application.sct), placed in the mapped SRAM
+#define SIMULATOR_STRING(value)			SIMULATOR_STRING_(value)
+#define SIMULATOR_STRING_(value)		#value
+#define SIMULATOR_SYMBOL(name, value)	__asm__(".globl " name "\n.set " name ", " SIMULATOR_STRING(value))
+
+SIMULATOR_SYMBOL("Image$$ARM_LIB_STACK$$ZI$$Base", MAP_STACK_BASE);
+SIMULATOR_SYMBOL("Image$$ARM_LIB_STACK$$ZI$$Limit", MAP_STACK_BASE + MAP_STACK_SIZE);
+SIMULATOR_SYMBOL("Image$$RW_IRAM_NOINIT$$ZI$$Base", MAP_NOINIT_BASE);
+SIMULATOR_SYMBOL("Image$$RW_IRAM_NOINIT$$ZI$$Limit", MAP_NOINIT_BASE + MAP_NOINIT_SIZE);
+
+
+/// Mapped windows
+enum Options_t
+{
+	FLASH_SIZE = 0x20000,				///< Flash (128 kbytes, erased to 0)
+	DATA_EEPROM_SIZE = 0x1000,			///< Data EEPROM (4 kbytes)
+	PERIPH_SIZE = 0x30000,				///< APB1, APB2 and AHB peripherals
+	CORE_BASE = 0xE0000000,				///< Core peripherals (DWT, NVIC, SysTick, SCB, DBGMCU)
+	CORE_SIZE = 0x43000,				///< Core peripherals size
+};
+
+
+volatile HostCore_t HostCore;
+
+const uint64_t Simulator::NO_EVENT;
+uint64_t Simulator::Now;
+SimDevice* Simulator::Devices;
+uint64_t Simulator::AlarmTime = Simulator::NO_EVENT;
+IRQn_Type Simulator::AlarmIrq;
+bool Simulator::Mapped;
+
+
+/**
+* @brief Plain memory mapping at the device address
+* @param address - window address
+* @param size - window size
+* @note The firmware is linked without PIE (see CMakeLists.txt), so the low 4 GB are free there
+*/
+void Simulator::Map(uint32_t address, uint32_t size)
+{
+	void* window = mmap((void *)(uintptr_t)address, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+	if(window != (void *)(uintptr_t)address)
+	{
+		fprintf(stderr, "simulator: 0x%08X can't be mapped\n", (unsigned)address);
+		exit(2);
+	}
+}
+
+
+/**
+* @brief Memory mapping and reset
+* @note The first call maps the windows. The next ones reset the time, the core,
+* the SRAM and the peripherals, the flash and the data EEPROM keep their contents.
+* The attached models are detached.
+*/
+void Simulator::Init()
+{
+	if(!Mapped)
+	{
+		Map(FLASH_BASE, FLASH_SIZE);
+		Map(DATA_EEPROM_BASE, DATA_EEPROM_SIZE);
+		Map(MAP_RAM_BASE, MAP_RAM_SIZE);
+		Map(PERIPH_BASE, PERIPH_SIZE);
+		Map(CORE_BASE, CORE_SIZE);
+		Mapped = true;
+	}
+	
+	memset((void *)(uintptr_t)MAP_RAM_BASE, 0, MAP_RAM_SIZE);
+	memset((void *)(uintptr_t)PERIPH_BASE, 0, PERIPH_SIZE);
+	memset((void *)(uintptr_t)CORE_BASE, 0, CORE_SIZE);
+	
+	HostCore.Primask = 0;
+	HostCore.Basepri = 0;
+	HostCore.Ipsr = 0;
+	HostCore.Msp = MAP_STACK_BASE + MAP_STACK_SIZE;
+	
+	/// Vectors of the firmware table (see Core::RegIrqHandler)
+	IrqHandler_t* table = (IrqHandler_t *)MAP_IRQ_BASE;
+	for(uint32_t index = 0; index < Core::VECTORS; index++)
+	{
+		table[index] = 0;
+	}
+	
+	Now = 0;
+	Devices = 0;
+	AlarmTime = NO_EVENT;
+}
+
+
+/**
+* @brief Peripheral model adding
+* @param device - model pointer
+*/
+void Simulator::Attach(SimDevice* device)
+{
+	device->Next = Devices;
+	Devices = device;
+}
+
+
+/**
+* @brief Peripheral model removing
+* @param device - model pointer
+*/
+void Simulator::Detach(SimDevice* device)
+{
+	for(SimDevice** link = &Devices; *link; link = &(*link)->Next)
+	{
+		if(*link == device)
+		{
+			*link = device->Next;
+			break;
+		}
+	}
+}
+
+
+/**
+* @brief Time polling
+* @return current time (us.)
+* @note The time moves by POLL_STEP, so the firmware waiting loops end
+*/
+uint64_t Simulator::Poll()
+{
+	Now += POLL_STEP;
+	Run();
+	return Now;
+}
+
+
+/**
+* @brief Time advancing
+* @param us - interval (us.)
+* @note The models events on the way are played at their time
+*/
+void Simulator::Advance(uint64_t us)
+{
+	uint64_t target = Now + us;
+	while(Now < target)
+	{
+		uint64_t next = GetNextEvent();
+		Now = (next > Now) && (next < target) ? next : target;
+		Run();
+	}
+}
+
+
+/**
+* @brief Sleep until an interrupt (__WFI)
+* @note Jumps to the next event, or by IDLE_STEP without events
+*/
+void Simulator::Idle()
+{
+	if(Dispatch())
+	{
+		return;
+	}
+	
+	uint64_t next = GetNextEvent();
+	Now = (next != NO_EVENT) && (next > Now) ? next : Now + IDLE_STEP;
+	Run();
+}
+
+
+/**
+* @brief Interrupt pending
+* @param irqn - interrupt number (device interrupts and PendSV)
+*/
+void Simulator::Raise(IRQn_Type irqn)
+{
+	if(irqn == PendSV_IRQn)
+	{
+		SCB->ICSR |= SCB_ICSR_PENDSVSET_Msk;
+	}
+	else
+	{
+		NVIC_SetPendingIRQ(irqn);
+	}
+}
+
+
+/**
+* @brief Interrupt taking at once
+* @param irqn - interrupt number
+* @return true, if the handler has run, otherwise the interrupt stays pending
+*/
+bool Simulator::Interrupt(IRQn_Type irqn)
+{
+	Raise(irqn);
+	while(Dispatch())
+	{
+		if(!IsPending(irqn))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+
+/**
+* @brief Interrupt pending at the time
+* @param time - time (us.), NO_EVENT cancels
+* @param irqn - interrupt number
+*/
+void Simulator::SetAlarm(uint64_t time, IRQn_Type irqn)
+{
+	AlarmTime = time;
+	AlarmIrq = irqn;
+}
+
+
+/**
+* @brief Models stepping and interrupts taking
+* @note The handlers run in the thread mode only, the models are not stepped from them
+*/
+void Simulator::Run()
+{
+	if(HostCore.Ipsr)
+	{
+		return;
+	}
+	
+	DWT->CYCCNT = (uint32_t)(Now * (Clock::GetFrequency() / 1000000));
+	
+	if(Now >= AlarmTime)
+	{
+		AlarmTime = NO_EVENT;
+		Raise(AlarmIrq);
+	}
+	
+	for(SimDevice* device = Devices; device; device = device->Next)
+	{
+		device->Step(Now);
+	}
+	
+	while(Dispatch());
+}
+
+
+/**
+* @brief Check, whether the interrupt is pending
+* @param irqn - interrupt number
+* @return true, if pending
+*/
+bool Simulator::IsPending(int32_t irqn)
+{
+	if(irqn == PendSV_IRQn)
+	{
+		return SCB->ICSR & SCB_ICSR_PENDSVSET_Msk;
+	}
+	return NVIC->ISPR[irqn >> 5] & (1UL << (irqn & 0x1F));
+}
+
+
+/**
+* @brief The highest priority deliverable interrupt taking
+* @return true, if a handler has run
+* @note Pending, enabled, not masked by PRIMASK and BASEPRI, no active handler.
+* The lower number wins the same priority, PendSV is the last one.
+*/
+bool Simulator::Dispatch()
+{
+	if(HostCore.Ipsr || HostCore.Primask)
+	{
+		return false;
+	}
+	
+	int32_t best = 0;
+	uint32_t bestPriority = 0x100;
+	for(int32_t irqn = 0; irqn < Core::IRQS; irqn++)
+	{
+		if(IsPending(irqn) && (NVIC->ISER[irqn >> 5] & (1UL << (irqn & 0x1F))) && (NVIC->IP[irqn] < bestPriority))
+		{
+			best = irqn;
+			bestPriority = NVIC->IP[irqn];
+		}
+	}
+	
+	uint32_t pendsvPriority = NVIC_GetPriority(PendSV_IRQn) << (8 - __NVIC_PRIO_BITS);
+	if(IsPending(PendSV_IRQn) && (pendsvPriority < bestPriority))
+	{
+		best = PendSV_IRQn;
+		bestPriority = pendsvPriority;
+	}
+	
+	if((bestPriority == 0x100) || (HostCore.Basepri && (bestPriority >= HostCore.Basepri)))
+	{
+		return false;
+	}
+	
+	if(best == PendSV_IRQn)
+	{
+		SCB->ICSR &= ~SCB_ICSR_PENDSVSET_Msk;
+	}
+	else
+	{
+		NVIC_ClearPendingIRQ((IRQn_Type)best);
+	}
+	
+	IrqHandler_t handler = ((IrqHandler_t *)MAP_IRQ_BASE)[Core::EXCEPTIONS + best];
+	if(!handler)
+	{
+		fprintf(stderr, "simulator: unhandled interrupt %d\n", (int)best);
+		exit(2);
+	}
+	
+	HostCore.Ipsr = Core::EXCEPTIONS + best;
+	handler();
+	HostCore.Ipsr = 0;
+	return true;
+}
+
+
+/**
+* @brief Nearest event of the models and the alarm
+* @return time (us., NO_EVENT - none)
+*/
+uint64_t Simulator::GetNextEvent()
+{
+	uint64_t next = AlarmTime;
+	for(SimDevice* device = Devices; device; device = device->Next)
+	{
+		uint64_t event = device->GetNextEvent();
+		if(event < next)
+		{
+			next = event;
+		}
+	}
+	return next;
+}
+
+
+/**
+* @brief __WFI() of the firmware
+*/
+void HostWaitForInterrupt()
+{
+	Simulator::Idle();
+}
+
+
+/**
+* @brief NVIC_SystemReset() of the firmware
+* @note The simulation can't restart the firmware, so it ends
+*/
+void HostSystemReset()
+{
+	fprintf(stderr, "simulator: system reset at %llu us\n", (unsigned long long)Simulator::GetMicros());
+	exit(3);
+}
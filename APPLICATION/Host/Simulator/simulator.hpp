@@ -0,0 +1,91 @@
+/**
+* @file simulator.hpp
+* @brief Host simulation header
+*/
+
+#ifndef __SIMULATOR_HPP
+#define __SIMULATOR_HPP
+
+#include "stm32l1xx.h"                  // Device header
+#include <stdint.h>
+
+
+/**
+* @brief Simulated peripheral
+* @note Stepped by the simulator between the firmware statements, which poll
+* the time (see SystemTimer::GetMicros), or while the firmware sleeps
+*/
+class SimDevice
+{
+	public:
+		SimDevice() : Next(0)
+		{
+		};
+		
+		virtual ~SimDevice()
+		{
+		};
+		
+		virtual void Step(uint64_t now) = 0;	/// State advancing up to the time (us.)
+		virtual uint64_t GetNextEvent() = 0;	/// Next own event time (us., NO_EVENT - none)
+		
+		SimDevice* Next;	///< Next attached device
+};
+
+
+/**
+* @brief Host simulation class
+* @note The firmware sources run unchanged on the host: the flash, the data EEPROM,
+* the SRAM and the peripheral windows are mapped at the device addresses as plain memory,
+* the attached models play the peripherals behaviour. The time is virtual, it advances
+* by POLL_STEP per time polling and jumps to the next event while the firmware waits
+* (Delay, WFI). Interrupts are taken in the thread mode only, between the statements,
+* which poll the time, in the priority order and respecting PRIMASK and BASEPRI.
+* A waiting loop, which doesn't poll the time (e.g. on a DMA counter), doesn't
+* see the models progress, so the host code waits by polling before it.
+*/
+class Simulator
+{
+	public:
+		enum Options_t
+		{
+			POLL_STEP = 1,			///< Time advance per polling (us.)
+			IDLE_STEP = 1000,		///< Time advance of the sleep without events (us.)
+		};
+		
+		static const uint64_t NO_EVENT = ~(uint64_t)0;	///< No pending event
+		
+		static void Init();										/// Memory mapping and reset
+		static void Attach(SimDevice* device);					/// Peripheral model adding
+		static void Detach(SimDevice* device);					/// Peripheral model removing
+		static uint64_t Poll();									/// Time polling
+		static void Advance(uint64_t us);						/// Time advancing
+		static void Idle();										/// Sleep until an interrupt
+		static void Raise(IRQn_Type irqn);						/// Interrupt pending
+		static bool Interrupt(IRQn_Type irqn);					/// Interrupt taking at once
+		static void SetAlarm(uint64_t time, IRQn_Type irqn);	/// Interrupt pending at the time
+		
+		/**
+		* @brief Get current time
+		* @return time (us.)
+		*/
+		static uint64_t GetMicros()
+		{
+			return Now;
+		};
+	
+	private:
+		static void Map(uint32_t address, uint32_t size);		/// Plain memory mapping at the device address
+		static void Run();										/// Models stepping and interrupts taking
+		static bool IsPending(int32_t irqn);					/// Check, whether the interrupt is pending
+		static bool Dispatch();									/// The highest priority deliverable interrupt taking
+		static uint64_t GetNextEvent();							/// Nearest event of the models and the alarm
+		
+		static uint64_t Now;				///< Current time (us.)
+		static SimDevice* Devices;			///< Attached models
+		static uint64_t AlarmTime;			///< Alarm time (NO_EVENT - none)
+		static IRQn_Type AlarmIrq;			///< Alarm interrupt
+		static bool Mapped;					///< Memory is mapped
+};
+
+#endif /* __SIMULATOR_HPP */
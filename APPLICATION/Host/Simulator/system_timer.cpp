@@ -0,0 +1,145 @@
+/**
+* @file system_timer.cpp
+* @brief System timer implementation (host build)
+* @note Stands for HAL/system_timer.cpp: the time is the simulator time,
+* the alarm is the simulator alarm on the timer interrupt
+*/
+
+#include "system_timer.hpp"
+#include "simulator.hpp"
+#include "critical_section.hpp"
+#include "stack.hpp"
+
+
+volatile uint64_t SystemTimer::Base;
+volatile uint32_t SystemTimer::Scale;
+volatile bool SystemTimer::AlarmActive;
+uint64_t SystemTimer::AlarmTime;
+IrqHandler_t SystemTimer::AlarmHandler;
+
+/**
+* @brief System timer initialization
+*/
+void SystemTimer::Init()
+{
+	Base = 0;
+	AlarmActive = false;
+	Core::RegIrqHandler(TIM9_IRQn, SystemTimer::Handler, IRQ_PRIORITY_TIM9);
+}
+
+
+/**
+* @brief Get current system timer value
+* @return current system timer value (s.)
+*/
+uint32_t SystemTimer::GetTime()
+{
+	return GetMicros() / 1000000;
+}
+
+
+/**
+* @brief Get current monotonic time
+* @return microseconds since initialization
+* @note Each call is a simulator time step (see Simulator::Poll)
+*/
+uint64_t SystemTimer::GetMicros()
+{
+	return Simulator::Poll() + Base;
+}
+
+
+/**
+* @brief Busy wait
+* @param us - wait time (us.)
+*/
+void SystemTimer::Delay(uint32_t us)
+{
+	Simulator::Advance(us);
+}
+
+
+/**
+* @brief Clock advancing (time spent with the timer stopped)
+* @param us - time to add (us.)
+*/
+void SystemTimer::Skip(uint64_t us)
+{
+	PriorityLock lock(LOCK_PRIORITY_SYSTEM_TIMER);
+	
+	Base += us;
+	if(AlarmActive)
+	{
+		ArmAlarm();
+	}
+}
+
+
+/**
+* @brief Alarm setting
+* @param time - alarm time (us., see GetMicros())
+* @param handler - handler, called from the timer interrupt
+* @note Replaces the previous alarm, an alarm in the past fires immediately
+*/
+void SystemTimer::SetAlarm(uint64_t time, IrqHandler_t handler)
+{
+	PriorityLock lock(LOCK_PRIORITY_SYSTEM_TIMER);
+	
+	AlarmTime = time;
+	AlarmHandler = handler;
+	AlarmActive = true;
+	ArmAlarm();
+}
+
+
+/**
+* @brief Alarm cancelling
+*/
+void SystemTimer::CancelAlarm()
+{
+	PriorityLock lock(LOCK_PRIORITY_SYSTEM_TIMER);
+	
+	AlarmActive = false;
+	Simulator::SetAlarm(Simulator::NO_EVENT, TIM9_IRQn);
+}
+
+
+/**
+* @brief Alarm programming
+*/
+void SystemTimer::ArmAlarm()
+{
+	Simulator::SetAlarm(AlarmTime > Base ? AlarmTime - Base : 0, TIM9_IRQn);
+}
+
+
+/**
+* @brief Prescaler tuning for the current system clock
+* @note The simulator time doesn't depend on the clock
+*/
+void SystemTimer::SetPrescaler()
+{
+}
+
+
+/**
+* @brief System clock change handler
+*/
+void SystemTimer::ClockChanged()
+{
+}
+
+
+/**
+* @brief System timer interrupt handler
+*/
+void SystemTimer::Handler()
+{
+	IsrGuard guard;
+	
+	if(AlarmActive && (Simulator::GetMicros() + Base >= AlarmTime))
+	{
+		AlarmActive = false;
+		AlarmHandler();
+	}
+}
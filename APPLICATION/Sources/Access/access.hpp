@@ -0,0 +1,54 @@
+/**
+* @file access.hpp
+* @brief Access control definitions header
+*/
+
+#ifndef __ACCESS_HPP
+#define __ACCESS_HPP
+
+#include <stdint.h>
+
+
+/// Access decision
+enum Decision_t
+{
+	DECISION_NONE		= 0,	///< No local decision (left to the controller)
+	DECISION_GRANTED	= 1,	///< Access granted
+	DECISION_DENIED		= 2,	///< Access denied
+};
+
+
+/// Reader status
+enum ReaderStatus_t
+{
+	READER_OK					= 0,	///< Credential is read
+	READER_ACTIVATION_ERROR		= 1,	///< Card activation error
+	READER_MF_ERROR				= 2,	///< MF file selection error
+	READER_EF_ERROR				= 3,	///< EFiccid file selection error
+	READER_READ_ERROR			= 4,	///< ICCID reading error
+};
+
+
+#pragma pack(1)
+
+/// Credential (ICCID, BCD)
+struct Credential_t
+{
+	uint8_t Value[10];
+};
+
+#pragma pack()
+
+
+/// Credential identifier (dictionary code of a credential)
+/// 0x0000...0x7FFF - local credential table slot
+/// 0x8000...0xFFFE - unknown credential entry (0x8000 | serial number)
+typedef uint16_t CredentialId_t;
+
+enum CredentialIdOptions_t
+{
+	CREDENTIAL_OVERFLOW	= 0x8000,	///< Unknown credential entry flag
+	CREDENTIAL_NONE		= 0xFFFF,	///< No credential (reading error)
+};
+
+#endif /* __ACCESS_HPP */
@@ -0,0 +1,314 @@
+/**
+* @file credential_db.cpp
+* @brief Flash-resident credential database implementation
+*/
+
+#include "credential_db.hpp"
+#include "flash.hpp"
+#include "watchdog_timer.hpp"
+#include "crc.hpp"
+#include "options.hpp"
+#include <string.h>
+
+
+/// Module options
+enum Options_t
+{
+	DB_MAGIC = 0x31424443,										///< Format signature ("CDB1")
+	DB_KEYS_ADDRESS = CREDENTIAL_DB_ADDRESS + Flash::PAGE_SIZE,	///< First key address (after the header page)
+	DB_CAPACITY = (CREDENTIAL_DB_SIZE - Flash::PAGE_SIZE) / sizeof(uint64_t),	///< Max keys count
+	DB_KEY_DIGITS = 19,											///< ICCID digits in the key (without check digit)
+};
+
+
+uint64_t CredentialDb::Index[MAX_BLOCKS];
+uint32_t CredentialDb::Count;
+uint32_t CredentialDb::LoadCount;
+bool CredentialDb::Checked;
+
+
+/**
+* @brief Header pointer
+* @return header pointer (memory-mapped flash)
+*/
+const CredentialDb::Header_t* CredentialDb::GetHeader()
+{
+	return (const Header_t *)CREDENTIAL_DB_ADDRESS;
+}
+
+
+/**
+* @brief Keys pointer
+* @return keys pointer (memory-mapped flash)
+*/
+const uint64_t* CredentialDb::GetKeys()
+{
+	return (const uint64_t *)DB_KEYS_ADDRESS;
+}
+
+
+/**
+* @brief Database initialization
+* @note The keys are checked on the first lookup, not at boot:
+* the CRC of the whole database takes a while
+*/
+void CredentialDb::Init()
+{
+	Count = 0;
+	Checked = false;
+}
+
+
+/**
+* @brief Database checking (RAM index building)
+* @note The database is used only if its header and keys CRC are valid
+* (a firmware image written over it invalidates it). Once per boot.
+*/
+void CredentialDb::Check()
+{
+	if(Checked)
+	{
+		return;
+	}
+	Checked = true;
+	
+	const Header_t* header = GetHeader();
+	if((header->Magic != DB_MAGIC) || (header->Count > DB_CAPACITY) || (header->Count > BLOCK_SIZE * MAX_BLOCKS))
+	{
+		return;
+	}
+	
+	if(Crc::Calc16((char *)GetKeys(), header->Count * sizeof(uint64_t), 0) != header->Crc)
+	{
+		return;
+	}
+	
+	Count = header->Count;
+	BuildIndex();
+}
+
+
+/**
+* @brief RAM index building
+*/
+void CredentialDb::BuildIndex()
+{
+	const uint64_t* keys = GetKeys();
+	for(uint32_t block = 0; block * BLOCK_SIZE < Count; block++)
+	{
+		Index[block] = keys[block * BLOCK_SIZE];
+	}
+}
+
+
+/**
+* @brief Check, whether the database is loaded
+* @return true, if the database is valid
+*/
+bool CredentialDb::IsValid()
+{
+	Check();
+	return Count != 0;
+}
+
+
+/**
+* @brief Credential to key conversion
+* @param credential - credential pointer
+* @return key (the first 19 ICCID digits as a binary number)
+* @note ICCID digits are stored low nibble first, 0x0F nibble ends the number
+*/
+uint64_t CredentialDb::MakeKey(const Credential_t* credential)
+{
+	uint64_t key = 0;
+	for(uint8_t index = 0; index < DB_KEY_DIGITS; index++)
+	{
+		uint8_t byte = credential->Value[index >> 1];
+		uint8_t digit = (index & 1) ? (byte >> 4) : (byte & 0x0F);
+		if(digit > 9)
+		{
+			digit = 0;
+		}
+		key = key * 10 + digit;
+	}
+	return key;
+}
+
+
+/**
+* @brief Credential searching
+* @param credential - credential pointer
+* @return true, if the credential is in the database
+*/
+bool CredentialDb::Contains(const Credential_t* credential)
+{
+	if(!IsValid())
+	{
+		return false;
+	}
+	
+	uint64_t key = MakeKey(credential);
+	
+	/// RAM index: the last block, which first key is not greater than the key
+	uint32_t blocks = (Count + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	if(key < Index[0])
+	{
+		return false;
+	}
+	uint32_t low = 0;
+	uint32_t high = blocks - 1;
+	while(low < high)
+	{
+		uint32_t middle = (low + high + 1) >> 1;
+		if(Index[middle] <= key)
+		{
+			low = middle;
+		}
+		else
+		{
+			high = middle - 1;
+		}
+	}
+	
+	/// Block in flash
+	const uint64_t* keys = GetKeys() + low * BLOCK_SIZE;
+	int32_t first = 0;
+	int32_t last = ((Count - low * BLOCK_SIZE) < BLOCK_SIZE ? (Count - low * BLOCK_SIZE) : (uint32_t)BLOCK_SIZE) - 1;
+	while(first <= last)
+	{
+		int32_t middle = (first + last) >> 1;
+		if(keys[middle] == key)
+		{
+			return true;
+		}
+		
+		if(keys[middle] < key)
+		{
+			first = middle + 1;
+		}
+		else
+		{
+			last = middle - 1;
+		}
+	}
+	
+	return false;
+}
+
+
+/**
+* @brief Database loading start
+* @param request - BUS_DB_BEGIN request frame (keys count)
+* @note The header and the pages for the keys are erased, the database is invalid until commit
+*/
+void CredentialDb::ProcessBegin(const BusFrame_t* request)
+{
+	uint32_t count;
+	if(request->Header.Length < sizeof(count))
+	{
+		Bus::Reply(request, BUS_NACK);
+		return;
+	}
+	
+	memcpy(&count, request->Data, sizeof(count));
+	if((count > DB_CAPACITY) || (count > BLOCK_SIZE * MAX_BLOCKS))
+	{
+		Bus::Reply(request, BUS_NACK);
+		return;
+	}
+	
+	/// The stored database is replaced, it is not checked anymore
+	Count = 0;
+	Checked = true;
+	LoadCount = count;
+	
+	uint32_t end = DB_KEYS_ADDRESS + count * sizeof(uint64_t);
+	for(uint32_t address = CREDENTIAL_DB_ADDRESS; address < end; address += Flash::PAGE_SIZE)
+	{
+		WatchdogTimer::Kick();
+		if(!Flash::ErasePage(address))
+		{
+			LoadCount = 0;
+			Bus::Reply(request, BUS_NACK);
+			return;
+		}
+	}
+	
+	Bus::Reply(request, BUS_ACK);
+}
+
+
+/**
+* @brief Database chunk writing
+* @param request - BUS_DB_WRITE request frame (byte offset of the keys, 128 bytes of keys)
+*/
+void CredentialDb::ProcessWrite(const BusFrame_t* request)
+{
+	uint32_t offset;
+	uint32_t chunk[CHUNK_SIZE / sizeof(uint32_t)];
+	
+	if(request->Header.Length < sizeof(offset) + CHUNK_SIZE)
+	{
+		Bus::Reply(request, BUS_NACK);
+		return;
+	}
+	
+	memcpy(&offset, request->Data, sizeof(offset));
+	if((offset % CHUNK_SIZE) || (offset >= LoadCount * sizeof(uint64_t)))
+	{
+		Bus::Reply(request, BUS_NACK);
+		return;
+	}
+	
+	memcpy(chunk, &request->Data[sizeof(offset)], CHUNK_SIZE);
+	bool result = Flash::WriteHalfPage(DB_KEYS_ADDRESS + offset, chunk);
+	
+	Bus::Reply(request, result ? BUS_ACK : BUS_NACK);
+}
+
+
+/**
+* @brief Database loading end
+* @param request - BUS_DB_COMMIT request frame (keys CRC16)
+* @note Keys are checked (CRC, ascending order), then the header is written
+*/
+void CredentialDb::ProcessCommit(const BusFrame_t* request)
+{
+	uint16_t crc;
+	if((request->Header.Length < sizeof(crc)) || !LoadCount)
+	{
+		Bus::Reply(request, BUS_NACK);
+		return;
+	}
+	
+	memcpy(&crc, request->Data, sizeof(crc));
+	
+	const uint64_t* keys = GetKeys();
+	bool result = (Crc::Calc16((char *)keys, LoadCount * sizeof(uint64_t), 0) == crc);
+	for(uint32_t index = 1; result && (index < LoadCount); index++)
+	{
+		if(keys[index - 1] >= keys[index])
+		{
+			result = false;
+		}
+	}
+	
+	if(result)
+	{
+		uint32_t header[Flash::HALF_PAGE_SIZE / sizeof(uint32_t)];
+		memset(header, 0, sizeof(header));
+		header[0] = DB_MAGIC;
+		header[1] = LoadCount;
+		header[2] = crc;
+		result = Flash::WriteHalfPage(CREDENTIAL_DB_ADDRESS, header);
+	}
+	
+	if(result)
+	{
+		Count = LoadCount;
+		BuildIndex();
+	}
+	LoadCount = 0;
+	
+	Bus::Reply(request, result ? BUS_ACK : BUS_NACK);
+}
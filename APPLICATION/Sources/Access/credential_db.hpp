@@ -0,0 +1,60 @@
+/**
+* @file credential_db.hpp
+* @brief Flash-resident credential database header
+*/
+
+#ifndef __CREDENTIAL_DB_HPP
+#define __CREDENTIAL_DB_HPP
+
+#include "access.hpp"
+#include "bus.hpp"
+#include <stdint.h>
+
+
+/**
+* @brief Flash-resident credential database class
+* @note Database of granted credentials in the spare image sectors: a header half page
+* followed by ascending 64-bit keys (the first 19 ICCID digits). Keys are grouped in
+* blocks, the first key of each block is kept in the RAM index. Lookups binary-search
+* the RAM index, then the block directly in memory-mapped flash.
+*/
+class CredentialDb
+{
+	public:
+		enum Options_t
+		{
+			BLOCK_SIZE = 128,		///< Keys per block
+			MAX_BLOCKS = 64,		///< RAM index size (blocks)
+			CHUNK_SIZE = 128,		///< Loading chunk size (half page)
+		};
+		
+		static void Init();										/// Database initialization
+		static bool IsValid();									/// Check, whether the database is loaded
+		static bool Contains(const Credential_t* credential);	/// Credential searching
+		static uint64_t MakeKey(const Credential_t* credential);	/// Credential to key conversion
+		
+		static void ProcessBegin(const BusFrame_t* request);	/// BUS_DB_BEGIN (keys count)
+		static void ProcessWrite(const BusFrame_t* request);	/// BUS_DB_WRITE (offset, 128 bytes of keys)
+		static void ProcessCommit(const BusFrame_t* request);	/// BUS_DB_COMMIT (keys CRC16)
+		
+	private:
+		/// Database header
+		struct Header_t
+		{
+			uint32_t Magic;		///< Format signature
+			uint32_t Count;		///< Keys count
+			uint32_t Crc;		///< Keys CRC16
+		};
+		
+		static const Header_t* GetHeader();		/// Header pointer (memory-mapped)
+		static const uint64_t* GetKeys();		/// Keys pointer (memory-mapped)
+		static void Check();					/// Database checking (RAM index building)
+		static void BuildIndex();				/// RAM index building
+		
+		static uint64_t Index[MAX_BLOCKS];		///< First key of each block
+		static uint32_t Count;					///< Keys count (0 - no database)
+		static uint32_t LoadCount;				///< Keys count being loaded
+		static bool Checked;					///< The stored database is checked
+};
+
+#endif /* __CREDENTIAL_DB_HPP */
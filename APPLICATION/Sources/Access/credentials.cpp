@@ -0,0 +1,243 @@
+/**
+* @file credentials.cpp
+* @brief Credential dictionary implementation
+*/
+
+#include "credentials.hpp"
+#include "data_eeprom.hpp"
+#include "options.hpp"
+#include <string.h>
+
+
+/// Module options
+enum Options_t
+{
+	CREDENTIALS_SLOTS = CREDENTIALS_SIZE / 12,			///< Local table slots count (sizeof(Slot_t))
+	OVERFLOW_MAGIC = 0x4F56,							///< Unknown credential entries signature ("VO")
+	OVERFLOW_ENTRIES = 16,								///< Unknown credential entries count
+	OVERFLOW_ENTRIES_ADDRESS = OVERFLOW_ADDRESS + 4,	///< First entry address (after the header)
+	OVERFLOW_SERIAL_LIMIT = 0x7FF0,						///< Serial number limit (multiple of OVERFLOW_ENTRIES)
+};
+
+
+uint16_t Credentials::NextSerial;
+
+
+/**
+* @brief Dictionary initialization
+* @note Unknown credential entries are cleared, if their header is not valid
+*/
+void Credentials::Init()
+{
+	uint16_t header[2];
+	DataEeprom::Read(OVERFLOW_ADDRESS, header, sizeof(header));
+	
+	if((header[0] != OVERFLOW_MAGIC) || (header[1] >= OVERFLOW_SERIAL_LIMIT))
+	{
+		Entry_t entry;
+		memset(&entry, 0, sizeof(entry));
+		entry.Id = CREDENTIAL_NONE;
+		for(uint16_t index = 0; index < OVERFLOW_ENTRIES; index++)
+		{
+			DataEeprom::Update(OVERFLOW_ENTRIES_ADDRESS + index * sizeof(Entry_t), &entry, sizeof(entry));
+		}
+		
+		header[0] = OVERFLOW_MAGIC;
+		header[1] = 0;
+		DataEeprom::Update(OVERFLOW_ADDRESS, header, sizeof(header));
+		DataEeprom::Commit();
+	}
+	
+	NextSerial = header[1];
+}
+
+
+/**
+* @brief Local table slot pointer
+* @param slot - slot number
+* @return slot pointer (memory-mapped data EEPROM)
+*/
+const Credentials::Slot_t* Credentials::GetSlot(uint16_t slot)
+{
+	return (const Slot_t *)(CREDENTIALS_ADDRESS + slot * sizeof(Slot_t));
+}
+
+
+/**
+* @brief Unknown credential entry pointer
+* @param index - entry index
+* @return entry pointer (memory-mapped data EEPROM)
+*/
+const Credentials::Entry_t* Credentials::GetEntry(uint16_t index)
+{
+	return (const Entry_t *)(OVERFLOW_ENTRIES_ADDRESS + index * sizeof(Entry_t));
+}
+
+
+/**
+* @brief Credential to identifier
+* @param credential - credential pointer
+* @return identifier (local table slot or unknown credential entry)
+* @note Unknown credential gets a new entry, the oldest one is reused
+*/
+CredentialId_t Credentials::Encode(const Credential_t* credential)
+{
+	/// Local table
+	for(uint16_t slot = 0; slot < CREDENTIALS_SLOTS; slot++)
+	{
+		const Slot_t* pSlot = GetSlot(slot);
+		if((pSlot->Flags & FLAG_USED) && !memcmp(&pSlot->Credential, credential, sizeof(Credential_t)))
+		{
+			return slot;
+		}
+	}
+	
+	/// Unknown credential entries
+	for(uint16_t index = 0; index < OVERFLOW_ENTRIES; index++)
+	{
+		const Entry_t* pEntry = GetEntry(index);
+		if((pEntry->Id != CREDENTIAL_NONE) && !memcmp(&pEntry->Credential, credential, sizeof(Credential_t)))
+		{
+			return pEntry->Id;
+		}
+	}
+	
+	/// New unknown credential entry
+	Entry_t entry;
+	entry.Id = CREDENTIAL_OVERFLOW | NextSerial;
+	memcpy(&entry.Credential, credential, sizeof(Credential_t));
+	DataEeprom::Update(OVERFLOW_ENTRIES_ADDRESS + (NextSerial % OVERFLOW_ENTRIES) * sizeof(Entry_t), &entry, sizeof(entry));
+	
+	NextSerial = (NextSerial + 1) % OVERFLOW_SERIAL_LIMIT;
+	uint16_t header[2] = {OVERFLOW_MAGIC, NextSerial};
+	DataEeprom::Update(OVERFLOW_ADDRESS, header, sizeof(header));
+	DataEeprom::Commit();
+	
+	return entry.Id;
+}
+
+
+/**
+* @brief Identifier to credential
+* @param id - identifier
+* @param credential - destination credential pointer
+* @return true, if the identifier is still valid
+*/
+bool Credentials::Resolve(CredentialId_t id, Credential_t* credential)
+{
+	if(id == CREDENTIAL_NONE)
+	{
+		return false;
+	}
+	
+	if(id & CREDENTIAL_OVERFLOW)
+	{
+		const Entry_t* pEntry = GetEntry((id & ~CREDENTIAL_OVERFLOW) % OVERFLOW_ENTRIES);
+		if(pEntry->Id != id)
+		{
+			return false;
+		}
+		memcpy(credential, &pEntry->Credential, sizeof(Credential_t));
+		return true;
+	}
+	
+	if((id >= CREDENTIALS_SLOTS) || !(GetSlot(id)->Flags & FLAG_USED))
+	{
+		return false;
+	}
+	memcpy(credential, &GetSlot(id)->Credential, sizeof(Credential_t));
+	return true;
+}
+
+
+/**
+* @brief Local access decision
+* @param id - identifier
+* @return DECISION_GRANTED or DECISION_DENIED for local table slots, DECISION_NONE otherwise
+*/
+Decision_t Credentials::Decide(CredentialId_t id)
+{
+	if((id & CREDENTIAL_OVERFLOW) || (id >= CREDENTIALS_SLOTS))
+	{
+		return DECISION_NONE;
+	}
+	
+	uint8_t flags = GetSlot(id)->Flags;
+	if(!(flags & FLAG_USED))
+	{
+		return DECISION_NONE;
+	}
+	
+	return (flags & FLAG_GRANTED) ? DECISION_GRANTED : DECISION_DENIED;
+}
+
+
+/**
+* @brief Local table slot writing
+* @param slot - slot number
+* @param credential - credential pointer
+* @param flags - flags (see Options_t), 0 - free the slot
+* @return true, if operation successful
+*/
+bool Credentials::WriteSlot(uint16_t slot, const Credential_t* credential, uint8_t flags)
+{
+	if(slot >= CREDENTIALS_SLOTS)
+	{
+		return false;
+	}
+	
+	Slot_t data;
+	memcpy(&data.Credential, credential, sizeof(Credential_t));
+	data.Flags = flags;
+	data.Reserved = 0;
+	
+	DataEeprom::Update(CREDENTIALS_ADDRESS + slot * sizeof(Slot_t), &data, sizeof(data));
+	return DataEeprom::Commit();
+}
+
+
+/**
+* @brief Local table slot writing request
+* @param request - BUS_CREDENTIAL_WRITE request frame (slot, Credential_t, flags)
+*/
+void Credentials::ProcessWrite(const BusFrame_t* request)
+{
+	if(request->Header.Length < sizeof(uint16_t) + sizeof(Credential_t) + 1)
+	{
+		Bus::Reply(request, BUS_NACK);
+		return;
+	}
+	
+	uint16_t slot;
+	memcpy(&slot, request->Data, sizeof(slot));
+	bool result = WriteSlot(slot, (const Credential_t *)&request->Data[sizeof(slot)], request->Data[sizeof(slot) + sizeof(Credential_t)]);
+	
+	Bus::Reply(request, result ? BUS_ACK : BUS_NACK);
+}
+
+
+/**
+* @brief Credential identifier resolving request
+* @param request - BUS_CREDENTIAL_RESOLVE request frame (CredentialId_t)
+*/
+void Credentials::ProcessResolve(const BusFrame_t* request)
+{
+	uint8_t data[sizeof(CredentialId_t) + sizeof(Credential_t)];
+	
+	if(request->Header.Length < sizeof(CredentialId_t))
+	{
+		Bus::Reply(request, BUS_NACK);
+		return;
+	}
+	
+	CredentialId_t id;
+	memcpy(&id, request->Data, sizeof(id));
+	if(!Resolve(id, (Credential_t *)&data[sizeof(id)]))
+	{
+		Bus::Reply(request, BUS_NACK);
+		return;
+	}
+	
+	memcpy(data, &id, sizeof(id));
+	Bus::Reply(request, BUS_CREDENTIAL_DATA, data, sizeof(data));
+}
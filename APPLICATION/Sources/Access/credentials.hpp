@@ -0,0 +1,65 @@
+/**
+* @file credentials.hpp
+* @brief Credential dictionary header
+*/
+
+#ifndef __CREDENTIALS_HPP
+#define __CREDENTIALS_HPP
+
+#include "access.hpp"
+#include "bus.hpp"
+#include <stdint.h>
+
+
+/**
+* @brief Credential dictionary class
+* @note The full credential value is stored once (local table slot or unknown
+* credential entry), journal and caches refer to it by CredentialId_t.
+* Unknown credential entries are reused round-robin, an identifier stays
+* resolvable until its entry is reused.
+*/
+class Credentials
+{
+	public:
+		enum Options_t
+		{
+			FLAG_USED = 0x01,		///< Slot is used
+			FLAG_GRANTED = 0x02,	///< Access is granted
+		};
+		
+		static void Init();															/// Dictionary initialization
+		static CredentialId_t Encode(const Credential_t* credential);				/// Credential to identifier
+		static bool Resolve(CredentialId_t id, Credential_t* credential);			/// Identifier to credential
+		static Decision_t Decide(CredentialId_t id);								/// Local access decision
+		static bool WriteSlot(uint16_t slot, const Credential_t* credential, uint8_t flags);	/// Local table slot writing
+		
+		static void ProcessWrite(const BusFrame_t* request);						/// BUS_CREDENTIAL_WRITE
+		static void ProcessResolve(const BusFrame_t* request);						/// BUS_CREDENTIAL_RESOLVE
+		
+	private:
+		#pragma pack(1)
+		
+		/// Local table slot
+		struct Slot_t
+		{
+			Credential_t Credential;	///< Credential
+			uint8_t Flags;				///< Flags (see Options_t)
+			uint8_t Reserved;			///< Reserved (word alignment)
+		};
+		
+		/// Unknown credential entry
+		struct Entry_t
+		{
+			CredentialId_t Id;			///< Identifier
+			Credential_t Credential;	///< Credential
+		};
+		
+		#pragma pack()
+		
+		static const Slot_t* GetSlot(uint16_t slot);		/// Local table slot pointer (memory-mapped)
+		static const Entry_t* GetEntry(uint16_t index);		/// Unknown credential entry pointer (memory-mapped)
+		
+		static uint16_t NextSerial;	///< Next unknown credential serial number
+};
+
+#endif /* __CREDENTIALS_HPP */
@@ -0,0 +1,214 @@
+/**
+* @file decision_cache.cpp
+* @brief Controller decision cache implementation
+*/
+
+#include "decision_cache.hpp"
+#include "system_timer.hpp"
+#include "retained.hpp"
+#include <string.h>
+
+
+DecisionCache::Entry_t DecisionCache::Entries[SIZE] RETAINED;
+uint8_t DecisionCache::Head RETAINED;
+uint8_t DecisionCache::Tail RETAINED;
+uint8_t DecisionCache::Free RETAINED;
+
+
+/**
+* @brief Cache initialization
+* @note The entries survive a warm reset (see Retained)
+*/
+void DecisionCache::Init()
+{
+	if(!Retained::IsRestored())
+	{
+		Invalidate(CREDENTIAL_NONE);
+	}
+}
+
+
+/**
+* @brief Entry searching
+* @param id - credential identifier
+* @return entry index or -1, if not found
+*/
+int32_t DecisionCache::Find(CredentialId_t id)
+{
+	for(uint8_t index = Head; index != NONE; index = Entries[index].Next)
+	{
+		if(Entries[index].Id == id)
+		{
+			return index;
+		}
+	}
+	return -1;
+}
+
+
+/**
+* @brief Entry removing from the LRU list
+* @param index - entry index
+*/
+void DecisionCache::Unlink(uint8_t index)
+{
+	Entry_t* entry = &Entries[index];
+	
+	if(entry->Prev != NONE)
+	{
+		Entries[entry->Prev].Next = entry->Next;
+	}
+	else
+	{
+		Head = entry->Next;
+	}
+	
+	if(entry->Next != NONE)
+	{
+		Entries[entry->Next].Prev = entry->Prev;
+	}
+	else
+	{
+		Tail = entry->Prev;
+	}
+}
+
+
+/**
+* @brief Entry adding to the LRU list head
+* @param index - entry index
+*/
+void DecisionCache::LinkFirst(uint8_t index)
+{
+	Entries[index].Prev = NONE;
+	Entries[index].Next = Head;
+	if(Head != NONE)
+	{
+		Entries[Head].Prev = index;
+	}
+	else
+	{
+		Tail = index;
+	}
+	Head = index;
+}
+
+
+/**
+* @brief Decision searching
+* @param id - credential identifier
+* @param decision - destination decision pointer
+* @return true, if a live decision is found
+*/
+bool DecisionCache::Lookup(CredentialId_t id, Decision_t* decision)
+{
+	int32_t index = Find(id);
+	if(index < 0)
+	{
+		return false;
+	}
+	
+	Unlink(index);
+	
+	/// Expired entry is released
+	if((int32_t)(Entries[index].Expiry - SystemTimer::GetTime()) <= 0)
+	{
+		Entries[index].Next = Free;
+		Free = index;
+		Retained::Seal();
+		return false;
+	}
+	
+	LinkFirst(index);
+	Retained::Seal();
+	*decision = (Decision_t)Entries[index].Decision;
+	return true;
+}
+
+
+/**
+* @brief Decision adding
+* @param id - credential identifier
+* @param decision - controller decision
+* @param ttl - time to live (s.), 0 - don't cache
+*/
+void DecisionCache::Insert(CredentialId_t id, Decision_t decision, uint32_t ttl)
+{
+	if((id == CREDENTIAL_NONE) || !ttl)
+	{
+		return;
+	}
+	
+	int32_t index = Find(id);
+	if(index >= 0)
+	{
+		Unlink(index);
+	}
+	else if(Free != NONE)
+	{
+		index = Free;
+		Free = Entries[index].Next;
+	}
+	else
+	{
+		/// Evict the least recently used entry
+		index = Tail;
+		Unlink(index);
+	}
+	
+	Entries[index].Id = id;
+	Entries[index].Decision = decision;
+	Entries[index].Expiry = SystemTimer::GetTime() + ttl;
+	LinkFirst(index);
+	Retained::Seal();
+}
+
+
+/**
+* @brief Decision removing
+* @param id - credential identifier, CREDENTIAL_NONE - all decisions
+*/
+void DecisionCache::Invalidate(CredentialId_t id)
+{
+	if(id == CREDENTIAL_NONE)
+	{
+		Head = NONE;
+		Tail = NONE;
+		Free = 0;
+		for(uint8_t index = 0; index < SIZE; index++)
+		{
+			Entries[index].Next = (index + 1 < SIZE) ? index + 1 : NONE;
+		}
+		Retained::Seal();
+		return;
+	}
+	
+	int32_t index = Find(id);
+	if(index >= 0)
+	{
+		Unlink(index);
+		Entries[index].Next = Free;
+		Free = index;
+		Retained::Seal();
+	}
+}
+
+
+/**
+* @brief Decision removing request
+* @param request - BUS_CACHE_INVALIDATE request frame (CredentialId_t, CREDENTIAL_NONE - all)
+*/
+void DecisionCache::ProcessInvalidate(const BusFrame_t* request)
+{
+	CredentialId_t id;
+	if(request->Header.Length < sizeof(id))
+	{
+		Bus::Reply(request, BUS_NACK);
+		return;
+	}
+	
+	memcpy(&id, request->Data, sizeof(id));
+	Invalidate(id);
+	
+	Bus::Reply(request, BUS_ACK);
+}
@@ -0,0 +1,61 @@
+/**
+* @file decision_cache.hpp
+* @brief Controller decision cache header
+*/
+
+#ifndef __DECISION_CACHE_HPP
+#define __DECISION_CACHE_HPP
+
+#include "access.hpp"
+#include "bus.hpp"
+#include "memory_map.h"
+#include "static_assert.hpp"
+#include <stdint.h>
+
+
+/**
+* @brief Controller decision cache class
+* @note Recent controller decisions keyed by credential identifier, each entry lives
+* for the TTL given by the controller. When the cache is full, the least recently
+* used entry is evicted. The cache is kept in the retained RAM and survives a warm reset.
+*/
+class DecisionCache
+{
+	public:
+		enum Options_t
+		{
+			SIZE = 64,			///< Cache size (entries)
+			NONE = 0xFF,		///< No entry (list end)
+		};
+		
+		static void Init();																/// Cache initialization
+		static bool Lookup(CredentialId_t id, Decision_t* decision);					/// Decision searching
+		static void Insert(CredentialId_t id, Decision_t decision, uint32_t ttl);		/// Decision adding
+		static void Invalidate(CredentialId_t id);										/// Decision removing (CREDENTIAL_NONE - all)
+		
+		static void ProcessInvalidate(const BusFrame_t* request);						/// BUS_CACHE_INVALIDATE
+		
+	private:
+		/// Cache entry
+		struct Entry_t
+		{
+			uint32_t Expiry;		///< Expiry time (SystemTimer)
+			CredentialId_t Id;		///< Credential identifier
+			uint8_t Decision;		///< Decision (see Decision_t)
+			uint8_t Prev;			///< More recently used entry
+			uint8_t Next;			///< Less recently used entry
+		};
+		
+		static int32_t Find(CredentialId_t id);		/// Entry searching
+		static void Unlink(uint8_t index);			/// Entry removing from the LRU list
+		static void LinkFirst(uint8_t index);		/// Entry adding to the LRU list head
+		
+		static Entry_t Entries[SIZE];	///< Entries
+		static uint8_t Head;			///< Most recently used entry
+		static uint8_t Tail;			///< Least recently used entry
+		static uint8_t Free;			///< Free entries list
+		
+		STATIC_ASSERT(sizeof(Entry_t) * SIZE + 3 <= CACHE_RAM_BUDGET, cache_ram_budget);
+};
+
+#endif /* __DECISION_CACHE_HPP */
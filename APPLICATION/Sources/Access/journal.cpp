@@ -0,0 +1,267 @@
+/**
+* @file journal.cpp
+* @brief Access event journal implementation
+*/
+
+#include "journal.hpp"
+#include "data_eeprom.hpp"
+#include "options.hpp"
+#include "retained.hpp"
+#include <string.h>
+
+
+/// Module options
+enum Options_t
+{
+	JOURNAL_MAGIC = 0x324E524A,		///< Format signature ("JRN2")
+	JOURNAL_RECORDS_ADDRESS = JOURNAL_ADDRESS + 8,	///< First record address (after the header)
+	JOURNAL_CAPACITY = (JOURNAL_SIZE - 8) / sizeof(JournalRecord_t),	///< EEPROM capacity (records)
+};
+
+
+Journal::Header_t Journal::Header;
+JournalRecord_t Journal::Ram[RAM_SIZE] RETAINED;
+uint8_t Journal::RamTail RETAINED;
+uint8_t Journal::RamCount RETAINED;
+TimerService::Handle_t Journal::FlushTimer;
+uint8_t Journal::UploadSequence RETAINED;
+uint8_t Journal::UploadCount RETAINED;
+
+
+/**
+* @brief Journal initialization
+* @note EEPROM journal is formatted, if its header is not valid.
+* RAM records and the pending upload survive a warm reset (see Retained).
+*/
+void Journal::Init()
+{
+	DataEeprom::Read(JOURNAL_ADDRESS, &Header, sizeof(Header));
+	
+	if((Header.Magic != JOURNAL_MAGIC) || (Header.Tail >= JOURNAL_CAPACITY) || (Header.Count > JOURNAL_CAPACITY))
+	{
+		Header.Magic = JOURNAL_MAGIC;
+		Header.Tail = 0;
+		Header.Count = 0;
+		DataEeprom::Update(JOURNAL_ADDRESS, &Header, sizeof(Header));
+		DataEeprom::Commit();
+		UploadCount = 0;
+	}
+	
+	if(!Retained::IsRestored())
+	{
+		RamTail = 0;
+		RamCount = 0;
+		UploadCount = 0;
+	}
+	Retained::Seal();
+	
+	FlushTimer = TimerService::Create(Journal::FlushTimeout, 0);
+	if(RamCount)
+	{
+		TimerService::Start(FlushTimer, FLUSH_DELAY * 1000000);
+	}
+}
+
+
+/**
+* @brief Record adding
+* @param record - record pointer
+*/
+void Journal::Add(const JournalRecord_t* record)
+{
+	/// The oldest RAM record is overwritten, if the EEPROM can't take them
+	if((RamCount >= RAM_SIZE) && !Flush())
+	{
+		RamTail = (RamTail + 1) % RAM_SIZE;
+		RamCount--;
+	}
+	
+	if(!RamCount)
+	{
+		TimerService::Start(FlushTimer, FLUSH_DELAY * 1000000);
+	}
+	
+	memcpy(&Ram[(RamTail + RamCount) % RAM_SIZE], record, sizeof(JournalRecord_t));
+	RamCount++;
+	Retained::Seal();
+	
+	if(RamCount >= FLUSH_THRESHOLD)
+	{
+		Flush();
+	}
+}
+
+
+/**
+* @brief RAM records flushing to EEPROM
+* @return true, if operation successful
+* @note All records and the header are programmed within one EEPROM commit.
+* If the EEPROM journal is full, the oldest records are overwritten.
+* The RAM records are removed after the commit only, a failed one keeps
+* them (and the header copy) for the next attempt.
+*/
+bool Journal::Flush()
+{
+	if(!RamCount)
+	{
+		return true;
+	}
+	
+	TimerService::Stop(FlushTimer);
+	
+	Header_t header = Header;
+	uint8_t uploadCount = UploadCount;
+	uint8_t tail = RamTail;
+	for(uint8_t count = RamCount; count; count--)
+	{
+		if(Header.Count >= JOURNAL_CAPACITY)
+		{
+			Header.Tail = (Header.Tail + 1) % JOURNAL_CAPACITY;
+			Header.Count--;
+			
+			/// The oldest record may be a part of the pending upload
+			if(UploadCount)
+			{
+				UploadCount--;
+			}
+		}
+		
+		uint32_t index = (Header.Tail + Header.Count) % JOURNAL_CAPACITY;
+		DataEeprom::Update(JOURNAL_RECORDS_ADDRESS + index * sizeof(JournalRecord_t), &Ram[tail], sizeof(JournalRecord_t));
+		Header.Count++;
+		tail = (tail + 1) % RAM_SIZE;
+	}
+	
+	DataEeprom::Update(JOURNAL_ADDRESS, &Header, sizeof(Header));
+	bool result = DataEeprom::Commit();
+	if(result)
+	{
+		RamTail = tail;
+		RamCount = 0;
+	}
+	else
+	{
+		/// The retry stages the same words again
+		Header = header;
+		UploadCount = uploadCount;
+		TimerService::Start(FlushTimer, FLUSH_DELAY * 1000000);
+	}
+	Retained::Seal();
+	return result;
+}
+
+
+/**
+* @brief Delayed flushing (timer callback)
+* @param context - not used
+*/
+void Journal::FlushTimeout(void* /*context*/)
+{
+	Flush();
+}
+
+
+/**
+* @brief Stored records count
+* @return records count (EEPROM and RAM)
+*/
+uint32_t Journal::GetCount()
+{
+	return Header.Count + RamCount;
+}
+
+
+/**
+* @brief Record reading (EEPROM, then RAM)
+* @param index - record index (0 - the oldest one)
+* @param record - destination record pointer
+*/
+void Journal::Read(uint32_t index, JournalRecord_t* record)
+{
+	if(index < Header.Count)
+	{
+		uint32_t position = (Header.Tail + index) % JOURNAL_CAPACITY;
+		DataEeprom::Read(JOURNAL_RECORDS_ADDRESS + position * sizeof(JournalRecord_t), record, sizeof(JournalRecord_t));
+	}
+	else
+	{
+		memcpy(record, &Ram[(RamTail + index - Header.Count) % RAM_SIZE], sizeof(JournalRecord_t));
+	}
+}
+
+
+/**
+* @brief Oldest records removing
+* @param count - records count
+*/
+void Journal::Remove(uint32_t count)
+{
+	/// EEPROM records
+	uint32_t eepromCount = count < Header.Count ? count : Header.Count;
+	if(eepromCount)
+	{
+		Header.Tail = (Header.Tail + eepromCount) % JOURNAL_CAPACITY;
+		Header.Count -= eepromCount;
+		DataEeprom::Update(JOURNAL_ADDRESS, &Header, sizeof(Header));
+		DataEeprom::Commit();
+	}
+	
+	/// RAM records
+	uint32_t ramCount = count - eepromCount;
+	if(ramCount > RamCount)
+	{
+		ramCount = RamCount;
+	}
+	RamTail = (RamTail + ramCount) % RAM_SIZE;
+	RamCount -= ramCount;
+	Retained::Seal();
+}
+
+
+/**
+* @brief Bulk upload
+* @param request - BUS_JOURNAL_READ request frame
+* @note Reply data: records count, records (the oldest first)
+*/
+void Journal::Upload(const BusFrame_t* request)
+{
+	uint8_t data[1 + BULK_SIZE * sizeof(JournalRecord_t)];
+	
+	uint32_t count = GetCount();
+	if(count > BULK_SIZE)
+	{
+		count = BULK_SIZE;
+	}
+	
+	data[0] = count;
+	for(uint32_t index = 0; index < count; index++)
+	{
+		Read(index, (JournalRecord_t *)&data[1 + index * sizeof(JournalRecord_t)]);
+	}
+	
+	UploadSequence = request->Header.Sequence;
+	UploadCount = count;
+	Retained::Seal();
+	
+	Bus::Reply(request, BUS_JOURNAL_DATA, data, 1 + count * sizeof(JournalRecord_t));
+}
+
+
+/**
+* @brief Upload acknowledgement
+* @param request - BUS_JOURNAL_ACK request frame (records count)
+* @note The sequence number should match the upload one
+*/
+void Journal::Acknowledge(const BusFrame_t* request)
+{
+	if((request->Header.Length < 1) || (request->Header.Sequence != UploadSequence) || (request->Data[0] > UploadCount))
+	{
+		Bus::Reply(request, BUS_NACK);
+		return;
+	}
+	
+	UploadCount = 0;
+	Remove(request->Data[0]);
+	
+	Bus::Reply(request, BUS_ACK);
+}
@@ -0,0 +1,80 @@
+/**
+* @file journal.hpp
+* @brief Access event journal header
+*/
+
+#ifndef __JOURNAL_HPP
+#define __JOURNAL_HPP
+
+#include "access.hpp"
+#include "bus.hpp"
+#include "timer_service.hpp"
+#include "memory_map.h"
+#include "static_assert.hpp"
+#include <stdint.h>
+
+
+#pragma pack(1)
+
+/// Journal record
+struct JournalRecord_t
+{
+	uint32_t Timestamp;			///< RTC time (s. since 2000-01-01)
+	CredentialId_t Credential;	///< Credential identifier (see Credentials)
+	uint8_t Decision;			///< Access decision (see Decision_t)
+	uint8_t Status;				///< Reader status (see ReaderStatus_t)
+};
+
+#pragma pack()
+
+
+/**
+* @brief Access event journal class
+* @note Records are collected in the RAM ring and flushed to the data EEPROM in batches.
+* The controller drains the oldest records (EEPROM first, then RAM) in bulk frames
+* and acknowledges them, acknowledged RAM records never reach the EEPROM.
+* RAM records and the pending upload are kept in the retained RAM and survive a warm reset.
+*/
+class Journal
+{
+	public:
+		enum Options_t
+		{
+			RAM_SIZE = 16,			///< RAM ring size (records)
+			FLUSH_THRESHOLD = 8,	///< RAM records count, which causes flushing
+			FLUSH_DELAY = 10,		///< Max RAM record age before flushing (s.)
+			BULK_SIZE = (Bus::MAX_DATA - 1) / sizeof(JournalRecord_t),	///< Max records per frame
+		};
+		
+		static void Init();										/// Journal initialization
+		static void Add(const JournalRecord_t* record);		/// Record adding
+		static bool Flush();									/// RAM records flushing to EEPROM
+		static void Upload(const BusFrame_t* request);			/// Bulk upload (BUS_JOURNAL_READ)
+		static void Acknowledge(const BusFrame_t* request);	/// Upload acknowledgement (BUS_JOURNAL_ACK)
+		static uint32_t GetCount();								/// Stored records count
+		
+	private:
+		/// EEPROM journal header
+		struct Header_t
+		{
+			uint32_t Magic;		///< Format signature
+			uint16_t Tail;		///< Oldest record index
+			uint16_t Count;		///< Records count
+		};
+		
+		static void Read(uint32_t index, JournalRecord_t* record);	/// Record reading (EEPROM, then RAM)
+		static void Remove(uint32_t count);							/// Oldest records removing
+		static void FlushTimeout(void* context);					/// Delayed flushing (timer callback)
+		
+		static Header_t Header;						///< EEPROM journal header (copy)
+		static JournalRecord_t Ram[RAM_SIZE];		///< RAM ring
+		static uint8_t RamTail;						///< RAM ring tail
+		static uint8_t RamCount;					///< RAM ring records count
+		static TimerService::Handle_t FlushTimer;	///< Oldest RAM record age timer
+		static uint8_t UploadSequence;				///< Sequence number of the last upload
+		static uint8_t UploadCount;					///< Records count of the last upload
+		
+		STATIC_ASSERT(sizeof(JournalRecord_t) * RAM_SIZE + 4 <= JOURNAL_RAM_BUDGET, journal_ram_budget);
+};
+
+#endif /* __JOURNAL_HPP */
@@ -3,16 +3,18 @@
 * @brief Circular buffer implementation
 */
 #include "circular_buffer.hpp"
+#include "compiler.hpp"
 #include <string.h>
 
 
 /**
 * @brief Constructor
+* @param buffer - storage pointer
 * @param size - buffer size
 */
-CircularBuffer::CircularBuffer(uint32_t size)
+CircularBuffer::CircularBuffer(uint8_t* buffer, uint32_t size)
 {
-    Buffer = new uint8_t[size];
+    Buffer = buffer;
     Size = size;
     Head = Buffer;
     Tail = Buffer;
@@ -73,7 +75,7 @@ uint32_t CircularBuffer::Put(const void* data, uint32_t count)
 * @brief Put char to the buffer
 * @param chr - source char
 */
-bool CircularBuffer::PutChar(uint8_t chr)
+RAMFUNC bool CircularBuffer::PutChar(uint8_t chr)
 {
 	/// Add char, increment tail pointer
     *Tail++ = chr;
@@ -133,7 +135,7 @@ uint32_t CircularBuffer::Get(void* buffer, uint32_t count)
 * @param buffer - destination buffer pointer
 * @return true, whether operation is successfull
 */
-bool CircularBuffer::GetChar(void* buffer)
+RAMFUNC bool CircularBuffer::GetChar(void* buffer)
 {
     if(ByteCount)
     {
@@ -203,7 +205,7 @@ void CircularBuffer::Delete(uint32_t count)
     Head += count;
 	if(Head >= bufferEnd)
 	{
-        Head = Buffer + ((uint32_t)Head - (uint32_t)bufferEnd);
+        Head = Buffer + (Head - bufferEnd);
     }
 
     /// Decrement bytes counter
@@ -10,6 +10,7 @@
 
 /**
 * @brief Circular buffer class
+* @note The storage is provided by the owner (statically placed, there is no heap)
 */
 class CircularBuffer
 {
@@ -41,7 +42,7 @@ class CircularBuffer
 		};
 		
 		/// Constructor
-		CircularBuffer(uint32_t size);
+		CircularBuffer(uint8_t* buffer, uint32_t size);
 		
 	private:
 		uint8_t* Buffer;	///< Buffer
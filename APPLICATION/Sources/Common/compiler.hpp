@@ -0,0 +1,26 @@
+/**
+* @file compiler.hpp
+* @brief Compiler specific definitions header
+*/
+
+#ifndef __COMPILER_HPP
+#define __COMPILER_HPP
+
+
+/**
+* @brief Function placement into SRAM (ER_IRAM_CODE, copied by __main, see application.sct)
+* @note SRAM runs without wait states, calls to flash go through linker veneers.
+* For hot paths only: interrupt handlers, ring buffer primitives, CRC kernels.
+* Never inlined, so a flash resident caller can't take the code back to flash
+* (flash programming must not fetch from it).
+*/
+#define RAMFUNC			__attribute__((section("RamCode"), noinline))
+
+/// Forced inlining
+#if defined(__CC_ARM)
+#define FORCE_INLINE	__forceinline
+#else
+#define FORCE_INLINE	inline __attribute__((always_inline))
+#endif
+
+#endif /* __COMPILER_HPP */
@@ -3,6 +3,7 @@
 * @brief Cyclic redundancy check functions implementation
 */
 #include "crc.hpp"
+#include "compiler.hpp"
 
 /// CRC8 table (polynome x^8 + x^7 + x^4 + x^0)
 const uint8_t Crc8Table[256] = {
@@ -66,13 +67,13 @@ uint8_t Crc::Calc8(char* data, uint32_t count, uint16_t vector)
 
 
 /**
-* @brief CRC16 calculation
+* @brief CRC16 kernel (inlined into the SRAM and flash copies)
 * @param data - data pointer
 * @param count - bytes count
 * @param vector - init vector
 * @retrun CRC16
 */
-uint16_t Crc::Calc16(char* data, uint32_t count, uint16_t vector)
+FORCE_INLINE uint16_t Crc::Kernel16(char* data, uint32_t count, uint16_t vector)
 {
 	uint16_t CRC = 0xFFFF - vector;
 	while(count--)
@@ -84,3 +85,30 @@ uint16_t Crc::Calc16(char* data, uint32_t count, uint16_t vector)
 	}
 	return(0xFFFF - CRC);
 }
+
+
+/**
+* @brief CRC16 calculation
+* @param data - data pointer
+* @param count - bytes count
+* @param vector - init vector
+* @retrun CRC16
+*/
+RAMFUNC uint16_t Crc::Calc16(char* data, uint32_t count, uint16_t vector)
+{
+	return Kernel16(data, count, vector);
+}
+
+
+/**
+* @brief CRC16 calculation (executed from flash)
+* @param data - data pointer
+* @param count - bytes count
+* @param vector - init vector
+* @retrun CRC16
+* @note Reference for the SRAM execution benchmark
+*/
+uint16_t Crc::Calc16Flash(char* data, uint32_t count, uint16_t vector)
+{
+	return Kernel16(data, count, vector);
+}
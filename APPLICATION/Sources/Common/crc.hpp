@@ -16,6 +16,10 @@ class Crc
 	public:
 		static uint8_t Calc8(char* data, uint32_t count, uint16_t vector);
 		static uint16_t Calc16(char* data, uint32_t count, uint16_t vector);
+		static uint16_t Calc16Flash(char* data, uint32_t count, uint16_t vector);
+	
+	private:
+		static uint16_t Kernel16(char* data, uint32_t count, uint16_t vector);
 };
 
 #endif	/* __CRC_HPP */
@@ -29,9 +29,20 @@ enum MemoryMap_t
 	
 	EXPORT_TABLE_ADDRESS				= 0x08000200,	///< Sector 0+0x200 (export table address)
 	FIRMWARE_ADDRESS					= 0x08002000,	///< Sector 2 (firmware start address)
-	FIRMWARE_IMAGE_ADDRESS				= 0x08003000,	///< Sector 16 (firmware image start address)
+	FIRMWARE_IMAGE_ADDRESS				= 0x08010000,	///< Sector 16 (firmware image start address)
+	
+	CREDENTIAL_DB_ADDRESS				= 0x08010000,	///< Sectors 16-31 (credential database, shares the image and reserved regions)
+	CREDENTIAL_DB_SIZE					= 0x10000,		///< Credential database size
 	
 	DATA_EEPROM_ADDRESS					= 0x08080000,	///< Data EEPROM (0x0808 0000 - 0x0808 0FFF) (4096 bytes)
+	DATA_EEPROM_SIZE					= 0x1000,		///< Data EEPROM size
+	
+	CREDENTIALS_ADDRESS					= 0x08080000,	///< Data EEPROM 0x000-0x5FF (local credential table)
+	CREDENTIALS_SIZE					= 0x0600,		///< Local credential table size
+	OVERFLOW_ADDRESS					= 0x08080600,	///< Data EEPROM 0x600-0x6FF (unknown credential entries)
+	OVERFLOW_SIZE						= 0x0100,		///< Unknown credential entries size
+	JOURNAL_ADDRESS						= 0x08080800,	///< Data EEPROM 0x800-0xFFF (access event journal)
+	JOURNAL_SIZE						= 0x0800,		///< Access event journal size
 };
 
 #endif	/* __OPTIONS_HPP */
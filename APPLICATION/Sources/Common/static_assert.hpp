@@ -0,0 +1,22 @@
+/**
+* @file static_assert.hpp
+* @brief Compile-time assertion header
+*/
+
+#ifndef __STATIC_ASSERT_HPP
+#define __STATIC_ASSERT_HPP
+
+
+#define STATIC_ASSERT_JOIN(a, b)		STATIC_ASSERT_JOIN_(a, b)
+#define STATIC_ASSERT_JOIN_(a, b)		a##b
+
+/**
+* @brief Compile-time assertion (C++03)
+* @param condition - constant expression
+* @param message - identifier, which appears in the error message
+* @note Valid at the namespace, class and function scope
+*/
+#define STATIC_ASSERT(condition, message) \
+	typedef char STATIC_ASSERT_JOIN(message##_, __LINE__)[(condition) ? 1 : -1]
+
+#endif /* __STATIC_ASSERT_HPP */
@@ -6,20 +6,95 @@
 #ifndef __BOARD_HPP
 #define __BOARD_HPP
 
+#include "core.hpp"
+#include "gpio.hpp"
 
 /**
 * @brief Target board class
+* @note The pins are compile-time types (see Pin), their accessors are inline
+* single stores, so they cost nothing in the interrupt handlers.
 */
 class Board
 {
 	public:
 		static void Init();					/// Target board initalization
-		static void SetRead485();			/// RS485 Read (RE receiver enable)
-		static void SetWrite485();			/// RS485 Write (DE driver enable)
-		static void Set_ISO7816_VCC_High();	/// Set ISO-7816 VCC high
-		static void Set_ISO7816_VCC_Low();	/// Set ISO-7816 VCC low
-		static void Set_ISO7816_RST_High();	/// Set ISO-7816 RST high
-		static void Set_ISO7816_RST_Low();	/// Set ISO-7816 RST low
+		static void SetCardDetectHandler(IrqHandler_t handler);	/// Card detect change handler setting
+		
+		/**
+		* @brief RS485 Read (RE receiver enable)
+		*/
+		static void SetRead485()
+		{
+			Rs485Direction::Clear();
+		};
+		
+		/**
+		* @brief RS485 Write (DE driver enable)
+		*/
+		static void SetWrite485()
+		{
+			Rs485Direction::Set();
+		};
+		
+		/**
+		* @brief Set ISO-7816 VCC high
+		*/
+		static void Set_ISO7816_VCC_High()
+		{
+			CardVcc::Set();
+		};
+		
+		/**
+		* @brief Set ISO-7816 VCC low
+		*/
+		static void Set_ISO7816_VCC_Low()
+		{
+			CardVcc::Clear();
+		};
+		
+		/**
+		* @brief Set ISO-7816 RST high
+		*/
+		static void Set_ISO7816_RST_High()
+		{
+			CardReset::Set();
+		};
+		
+		/**
+		* @brief Set ISO-7816 RST low
+		*/
+		static void Set_ISO7816_RST_Low()
+		{
+			CardReset::Clear();
+		};
+		
+		/**
+		* @brief Check, whether the card is inserted
+		* @return true, if the card detect switch is closed (active low)
+		*/
+		static bool IsCardPresent()
+		{
+			return !CardDetect::Read();
+		};
+	
+	private:
+		///--- Pins ---///
+		typedef Pin<GPIOA_BASE, 0, GPIO_INPUT, 0, GPIO_PULL_UP> CardDetect;		///< PA0 - ISO7816 card detect, EXTI0 on both edges
+		typedef Pin<GPIOA_BASE, 2, GPIO_ALTERNATE, 7> CardIo;					///< PA2 (USART2_TX) - ISO7816 IO
+		typedef Pin<GPIOA_BASE, 3, GPIO_ALTERNATE, 7> CardRx;					///< PA3 (USART2_RX) - not connected, but tuned as UART
+		typedef Pin<GPIOA_BASE, 4, GPIO_ALTERNATE, 7> CardClock;				///< PA4 (USART2_CK) - ISO7816 CLK
+		typedef Pin<GPIOA_BASE, 5, GPIO_OUTPUT> CardVcc;						///< PA5 - ISO7816 VCC
+		typedef Pin<GPIOA_BASE, 6, GPIO_OUTPUT> CardReset;						///< PA6 - ISO7816 RST
+		typedef Pin<GPIOA_BASE, 8, GPIO_OUTPUT> Rs485Direction;					///< PA8 - 485R/W
+		typedef Pin<GPIOA_BASE, 9, GPIO_ALTERNATE, 7> Rs485Tx;					///< PA9 (USART1_TX) - 485TX
+		typedef Pin<GPIOA_BASE, 10, GPIO_ALTERNATE, 7> Rs485Rx;					///< PA10 (USART1_RX) - 485RX, EXTI10 wakeup (see Power)
+		
+		/// Port A configuration
+		typedef GpioPort<GPIOA_BASE, CardDetect, CardIo, CardRx, CardClock, CardVcc, CardReset, Rs485Direction, Rs485Tx, Rs485Rx> PortA;
+		
+		static void CardDetect_Handler();	/// EXTI0 interrupt handler
+		
+		static IrqHandler_t CardDetectHandler;	///< Card detect change handler
 };
 
 #endif /* __BOARD_HPP */
@@ -0,0 +1,43 @@
+/**
+* @file boot.cpp
+* @brief Boot time measurement implementation
+*/
+
+#include "boot.hpp"
+#include "clock.hpp"
+#include "stm32l1xx.h"                  // Device header
+
+
+uint32_t Boot::Time[BOOT_PHASES];
+uint32_t Boot::Cycles;
+bool Boot::Finished;
+
+
+/**
+* @brief Phase end marking
+* @param phase - phase (see BootPhase_t)
+* @note The first mark of a phase only is taken, marks after Finish() are ignored
+*/
+void Boot::Mark(uint8_t phase)
+{
+	uint32_t cycles = DWT->CYCCNT;
+	
+	if(Finished || (phase >= BOOT_PHASES) || Time[phase])
+	{
+		return;
+	}
+	
+	/// The profile is not switched during the boot
+	Time[phase] = (uint32_t)(((uint64_t)(cycles - Cycles) * 1000000) / Clock::GetFrequency());
+	Cycles = cycles;
+}
+
+
+/**
+* @brief Measurement closing
+* @note Called before the first sleep
+*/
+void Boot::Finish()
+{
+	Finished = true;
+}
@@ -0,0 +1,53 @@
+/**
+* @file boot.hpp
+* @brief Boot time measurement header
+*/
+
+#ifndef __BOOT_HPP
+#define __BOOT_HPP
+
+#include <stdint.h>
+
+
+/// Boot phases
+enum BootPhase_t
+{
+	BOOT_STARTUP = 0,	///< Reset to main() (clocks, vector table, static objects)
+	BOOT_BOARD,			///< Pins and watchdog
+	BOOT_SERVICES,		///< Queues, timers, RTC, power management and bus
+	BOOT_DATA,			///< Credential tables, decision cache and journal
+	BOOT_ATR,			///< First card answer to reset (card inserted at power-on only)
+	BOOT_PHASES,		///< Phases count
+};
+
+
+/**
+* @brief Boot time measurement class
+* @note The startup code enables the cycle counter and keeps it counting
+* in HSE clocks since the reset. Each phase is measured from the end of
+* the previous one. Sleeping stops the counter, so the measurement is
+* closed before the event loop starts.
+*/
+class Boot
+{
+	public:
+		static void Mark(uint8_t phase);		/// Phase end marking
+		static void Finish();					/// Measurement closing
+		
+		/**
+		* @brief Get phase duration
+		* @param phase - phase (see BootPhase_t)
+		* @return duration (us.), 0 - the phase is not passed
+		*/
+		static uint32_t GetTime(uint8_t phase)
+		{
+			return phase < BOOT_PHASES ? Time[phase] : 0;
+		};
+	
+	private:
+		static uint32_t Time[BOOT_PHASES];		///< Phases duration (us.)
+		static uint32_t Cycles;					///< Previous phase end (cycles)
+		static bool Finished;					///< Measurement is closed
+};
+
+#endif /* __BOOT_HPP */
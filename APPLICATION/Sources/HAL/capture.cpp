@@ -0,0 +1,84 @@
+/**
+* @file capture.cpp
+* @brief Line capture implementation
+*/
+
+#include "capture.hpp"
+#include "system_timer.hpp"
+#include "critical_section.hpp"
+#include "compiler.hpp"
+
+
+CaptureRecord_t Capture::Records[SIZE];
+uint32_t Capture::Head;
+uint32_t Capture::Tail;
+uint32_t Capture::Lost;
+volatile uint32_t Capture::Mask;
+
+
+/**
+* @brief Capture start
+* @param mask - captured channels (bit per CaptureChannel_t, 0 - stop)
+* @note The ring is cleared
+*/
+void Capture::Start(uint32_t mask)
+{
+	CriticalSection section;
+	
+	Head = 0;
+	Tail = 0;
+	Lost = 0;
+	Mask = mask & ((1UL << CAPTURE_CHANNELS) - 1);
+}
+
+
+/**
+* @brief Record storing
+* @param channel - channel (see CaptureChannel_t)
+* @param data - byte
+* @note Any context. The stamp is taken inside the section, so the records
+* are in the time order.
+*/
+RAMFUNC void Capture::Write(uint8_t channel, uint8_t data)
+{
+	CriticalSection section;
+	
+	if(Head - Tail >= SIZE)
+	{
+		Lost++;
+		return;
+	}
+	
+	CaptureRecord_t* record = &Records[Head & (SIZE - 1)];
+	record->Time = (uint32_t)SystemTimer::GetMicros();
+	record->Channel = channel;
+	record->Data = data;
+	Head++;
+}
+
+
+/**
+* @brief Oldest records reading
+* @param buffer - destination buffer pointer
+* @param count - buffer size (records)
+* @param lost - destination pointer of the records dropped since the previous reading
+* @return records count
+* @note Thread mode only. Stops the capture.
+*/
+uint32_t Capture::Read(CaptureRecord_t* buffer, uint32_t count, uint16_t* lost)
+{
+	CriticalSection section;
+	
+	Mask = 0;
+	*lost = Lost > UINT16_MAX ? UINT16_MAX : (uint16_t)Lost;
+	Lost = 0;
+	
+	uint32_t result = 0;
+	while((result < count) && (Tail != Head))
+	{
+		buffer[result++] = Records[Tail & (SIZE - 1)];
+		Tail++;
+	}
+	
+	return result;
+}
@@ -0,0 +1,95 @@
+/**
+* @file capture.hpp
+* @brief Line capture header
+*/
+
+#ifndef __CAPTURE_HPP
+#define __CAPTURE_HPP
+
+#include "memory_map.h"
+#include "static_assert.hpp"
+#include <stdint.h>
+
+
+/// Captured channels
+enum CaptureChannel_t
+{
+	CAPTURE_CARD_RESET = 0,	///< Card reset released (no data)
+	CAPTURE_CARD_RX,		///< Card line byte received (the echo of the transmitted ones included)
+	CAPTURE_CARD_TX,		///< Card line byte transmitted
+	CAPTURE_BUS_RX,			///< Bus byte received (stamped at the line idle, see Uart)
+	CAPTURE_BUS_TX,			///< Bus byte transmitted (stamped at the transmission start)
+	CAPTURE_CHANNELS,		///< Channels count
+};
+
+
+/// Capture record (8 bytes)
+struct CaptureRecord_t
+{
+	uint32_t Time;			///< System timer (us., low 32 bits)
+	uint8_t Channel;		///< Channel (see CaptureChannel_t)
+	uint8_t Data;			///< Byte
+	uint16_t Reserved;		///< Alignment
+};
+
+
+/**
+* @brief Line capture class
+* @note Records the card (USART2) and the bus (USART1) bytes with their time,
+* so a real card and controller can be replayed by the host simulation
+* (Host/Replay). The capture is off after reset, BUS_CAPTURE_START clears
+* the ring and enables the channels, the reading (BUS_CAPTURE_READ) stops it,
+* as the reading frames would be captured as well. The newest records are
+* dropped, when the ring is full, so the capture is complete from its start.
+* A card tap with the controller decision takes about a hundred records,
+* so the capture is read and started again after each tap.
+*/
+class Capture
+{
+	public:
+		enum Options_t
+		{
+			SIZE = 128,				///< Ring size (records, power of 2)
+		};
+		
+		static void Start(uint32_t mask);												/// Capture start
+		static uint32_t Read(CaptureRecord_t* buffer, uint32_t count, uint16_t* lost);	/// Oldest records reading
+		
+		/**
+		* @brief Byte recording
+		* @param channel - channel (see CaptureChannel_t)
+		* @param data - byte
+		* @note A disabled channel costs a load and a branch
+		*/
+		static void Record(uint8_t channel, uint8_t data = 0)
+		{
+			if(Mask & (1UL << channel))
+			{
+				Write(channel, data);
+			}
+		};
+		
+		/**
+		* @brief Check, whether the channel is captured
+		* @param channel - channel (see CaptureChannel_t)
+		* @return true, if enabled
+		*/
+		static bool IsEnabled(uint8_t channel)
+		{
+			return Mask & (1UL << channel);
+		};
+	
+	private:
+		static void Write(uint8_t channel, uint8_t data);	/// Record storing
+		
+		static CaptureRecord_t Records[SIZE];	///< Records ring
+		static uint32_t Head;					///< Records written
+		static uint32_t Tail;					///< Records read
+		static uint32_t Lost;					///< Records dropped since the previous reading
+		static volatile uint32_t Mask;			///< Captured channels
+		
+		STATIC_ASSERT(sizeof(CaptureRecord_t) == 8, capture_record_size);
+		STATIC_ASSERT(sizeof(CaptureRecord_t) * SIZE + 16 <= CAPTURE_RAM_BUDGET, capture_ram_budget);
+};
+
+#endif /* __CAPTURE_HPP */
@@ -0,0 +1,176 @@
+/**
+* @file clock.cpp
+* @brief System clock implementation
+*/
+
+#include "clock.hpp"
+#include "critical_section.hpp"
+#include "trace.hpp"
+#include "stm32l1xx.h"                  // Device header
+
+
+/// Profiles settings
+const Clock::Settings_t Clock::SETTINGS[CLOCK_PROFILES] = 
+{
+	{32000000,	RCC_CFGR_SW_PLL,	1,	1},		///< CLOCK_PERFORMANCE
+	{HSE_VALUE,	RCC_CFGR_SW_HSE,	2,	1},		///< CLOCK_BALANCED
+	{2097152,	RCC_CFGR_SW_MSI,	3,	1},		///< CLOCK_LOW_POWER
+};
+
+/// The startup code runs from HSE
+uint8_t Clock::Profile = CLOCK_BALANCED;
+uint32_t Clock::Frequency = HSE_VALUE;
+ClockListener_t Clock::Listeners[CLOCK_LISTENERS];
+
+
+/**
+* @brief Clock profile switching
+* @param profile - profile (see ClockProfile_t)
+* @return true, if the profile is valid
+* @note Interrupts are masked until all the listeners have recomputed their dividers,
+* so the profile must not be switched during a card or bus exchange
+*/
+bool Clock::SetProfile(uint8_t profile)
+{
+	if(profile >= CLOCK_PROFILES)
+	{
+		return false;
+	}
+	
+	if(profile == Profile)
+	{
+		return true;
+	}
+	
+	const Settings_t* settings = &SETTINGS[profile];
+	
+	CriticalSection section;
+	
+	/// Speeding up: voltage and wait states first, slowing down: clock first
+	if(settings->Frequency > Frequency)
+	{
+		SetRange(settings->Range);
+		SetLatency(settings->Latency);
+		SetSource(settings->Source);
+	}
+	else
+	{
+		SetSource(settings->Source);
+		SetLatency(settings->Latency);
+		SetRange(settings->Range);
+	}
+	
+	Profile = profile;
+	Frequency = settings->Frequency;
+	Trace::Record(TRACE_CLOCK, Frequency / 100000);
+	
+	for(uint8_t index = 0; index < CLOCK_LISTENERS; index++)
+	{
+		if(Listeners[index])
+		{
+			Listeners[index]();
+		}
+	}
+	
+	return true;
+}
+
+
+/**
+* @brief Clock source restarting (after STOP mode)
+* @note The core wakes up from MSI, voltage range and wait states are kept
+*/
+void Clock::Restore()
+{
+	SetSource(SETTINGS[Profile].Source);
+}
+
+
+/**
+* @brief Clock change listener setting
+* @param slot - listener slot (see ClockListenerSlot_t)
+* @param listener - listener, called with interrupts masked
+* @note The slot is replaced, so a repeated subscription is harmless
+*/
+void Clock::Subscribe(ClockListenerSlot_t slot, ClockListener_t listener)
+{
+	Listeners[slot] = listener;
+}
+
+
+/**
+* @brief Voltage range setting
+* @param range - voltage range (1...3)
+*/
+void Clock::SetRange(uint8_t range)
+{
+	while(PWR->CSR & PWR_CSR_VOSF);
+	PWR->CR = (PWR->CR & ~PWR_CR_VOS) | ((uint32_t)range << 11);
+	while(PWR->CSR & PWR_CSR_VOSF);
+}
+
+
+/**
+* @brief Flash wait states setting
+* @param latency - wait states (0, 1)
+* @note 64-bit access must be on, while the latency is 1
+*/
+void Clock::SetLatency(uint8_t latency)
+{
+	if(latency)
+	{
+		FLASH->ACR |= FLASH_ACR_ACC64;
+		FLASH->ACR |= FLASH_ACR_PRFTEN | FLASH_ACR_LATENCY;
+		while(!(FLASH->ACR & FLASH_ACR_LATENCY));
+	}
+	else
+	{
+		FLASH->ACR &= ~(FLASH_ACR_PRFTEN | FLASH_ACR_LATENCY);
+		while(FLASH->ACR & FLASH_ACR_LATENCY);
+		FLASH->ACR &= ~FLASH_ACR_ACC64;
+	}
+}
+
+
+/**
+* @brief System clock source switching
+* @param source - clock source (RCC_CFGR_SW_x)
+* @note Unused oscillators are stopped, the clock security system
+* follows HSE
+*/
+void Clock::SetSource(uint8_t source)
+{
+	if(source == RCC_CFGR_SW_MSI)
+	{
+		RCC->CR |= RCC_CR_MSION;
+		while(!(RCC->CR & RCC_CR_MSIRDY));
+	}
+	else
+	{
+		RCC->CR |= RCC_CR_HSEON;
+		while(!(RCC->CR & RCC_CR_HSERDY));
+		RCC->CR |= RCC_CR_CSSON;
+	}
+	
+	if((source == RCC_CFGR_SW_PLL) && !(RCC->CR & RCC_CR_PLLRDY))
+	{
+		/// PLL = HSE * 8 / 3 (VCO 96 MHz)
+		RCC->CFGR = (RCC->CFGR & ~(RCC_CFGR_PLLSRC | RCC_CFGR_PLLMUL | RCC_CFGR_PLLDIV)) | 
+			RCC_CFGR_PLLSRC_HSE | RCC_CFGR_PLLMUL8 | RCC_CFGR_PLLDIV3;
+		RCC->CR |= RCC_CR_PLLON;
+		while(!(RCC->CR & RCC_CR_PLLRDY));
+	}
+	
+	RCC->CFGR = (RCC->CFGR & ~RCC_CFGR_SW) | source;
+	while(((RCC->CFGR & RCC_CFGR_SWS) >> 2) != source);
+	
+	if(source != RCC_CFGR_SW_PLL)
+	{
+		RCC->CR &= ~RCC_CR_PLLON;
+	}
+	if(source == RCC_CFGR_SW_MSI)
+	{
+		RCC->CR &= ~RCC_CR_CSSON;
+		RCC->CR &= ~RCC_CR_HSEON;
+	}
+}
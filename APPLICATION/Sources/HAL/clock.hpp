@@ -0,0 +1,91 @@
+/**
+* @file clock.hpp
+* @brief System clock header
+*/
+
+#ifndef __CLOCK_HPP
+#define __CLOCK_HPP
+
+#include <stdint.h>
+
+
+/// Clock profiles
+enum ClockProfile_t
+{
+	CLOCK_PERFORMANCE = 0,	///< PLL (HSE * 8 / 3), 32 MHz, range 1 (1.8 V), 1 wait state
+	CLOCK_BALANCED,			///< HSE, 12 MHz, range 2 (1.5 V), 1 wait state
+	CLOCK_LOW_POWER,		///< MSI, 2.097 MHz, range 3 (1.2 V), 1 wait state
+	CLOCK_PROFILES,			///< Profiles count
+};
+
+
+/// Clock change listeners (a slot per subscribing driver)
+enum ClockListenerSlot_t
+{
+	CLOCK_LISTENER_SYSTEM_TIMER = 0,	///< SystemTimer
+	CLOCK_LISTENER_UART,				///< Uart
+	CLOCK_LISTENER_ISO7816,				///< ISO7816
+	CLOCK_LISTENER_PROFILER,			///< Profiler
+	CLOCK_LISTENERS,					///< Listeners count
+};
+
+
+/// Clock change listener
+typedef void (*ClockListener_t)();
+
+
+/**
+* @brief System clock class
+* @note AHB and APB prescalers are 1, so the peripherals run at the system clock.
+* Drivers subscribe for the clock change in their own slot (see
+* ClockListenerSlot_t, a new driver adds one) and recompute their dividers
+* from GetFrequency(). Voltage range is raised before and lowered after
+* the frequency change, flash wait states follow the voltage range table.
+*/
+class Clock
+{
+	public:
+		static bool SetProfile(uint8_t profile);				/// Clock profile switching
+		static void Restore();									/// Clock source restarting (after STOP mode)
+		static void Subscribe(ClockListenerSlot_t slot, ClockListener_t listener);	/// Clock change listener setting
+		
+		/**
+		* @brief Get current profile
+		* @return profile (see ClockProfile_t)
+		*/
+		static uint8_t GetProfile()
+		{
+			return Profile;
+		};
+		
+		/**
+		* @brief Get system clock frequency
+		* @return frequency (Hz)
+		*/
+		static uint32_t GetFrequency()
+		{
+			return Frequency;
+		};
+	
+	private:
+		/// Profile settings
+		struct Settings_t
+		{
+			uint32_t Frequency;		///< System clock frequency (Hz)
+			uint8_t Source;			///< System clock source (RCC_CFGR_SW_x)
+			uint8_t Range;			///< Voltage range (1...3)
+			uint8_t Latency;		///< Flash wait states
+		};
+		
+		static const Settings_t SETTINGS[CLOCK_PROFILES];	///< Profiles settings
+		
+		static void SetRange(uint8_t range);				/// Voltage range setting
+		static void SetLatency(uint8_t latency);			/// Flash wait states setting
+		static void SetSource(uint8_t source);				/// System clock source switching
+		
+		static uint8_t Profile;								///< Current profile
+		static uint32_t Frequency;							///< Current frequency (Hz)
+		static ClockListener_t Listeners[CLOCK_LISTENERS];	///< Clock change listeners (0 - none)
+};
+
+#endif /* __CLOCK_HPP */
@@ -3,6 +3,62 @@
 * @brief Core functions implementation
 */
 #include "core.hpp"
+#include "static_assert.hpp"
+
+
+STATIC_ASSERT((int)TIM7_IRQn < (int)Core::IRQS, core_vector_table_size);
+
+Core::Entry_t Core::Entries[IRQS];
+
+
+/**
+* @brief Vector table initialization
+* @note Called by the startup code before __main, so it uses no static data.
+* The flash table holds the stack top and the reset handler only (see vectors.cpp),
+* the rest of the vectors get the unregistered handler. VTOR replaces
+* the memory remapping, so the flash stays at 0x00000000.
+*/
+void Core::InitVectors()
+{
+	volatile uint32_t* table = (volatile uint32_t *)MAP_IRQ_BASE;
+	const uint32_t* flash = (const uint32_t *)FLASH_BASE;
+	
+	/// Initial stack pointer and reset handler
+	table[0] = flash[0];
+	table[1] = flash[1];
+	
+	for(uint32_t index = 2; index < VECTORS; index++)
+	{
+		table[index] = (uint32_t)(uintptr_t)Core::Unhandled;
+	}
+	
+	/// The table is aligned to its size (power of 2)
+	SCB->VTOR = MAP_IRQ_BASE;
+	__DSB();
+}
+
+
+/**
+* @brief Unregistered interrupt handler
+* @note Stops here for the debugger, the watchdog resets the device
+*/
+void Core::Unhandled()
+{
+	while(1);
+}
+
+
+/**
+* @brief Context handler dispatcher
+* @note The vector of each context handler, one SRAM copy serves all of them
+* (compile-time thunks per interrupt would not fit the SRAM code region)
+*/
+RAMFUNC void Core::Dispatch()
+{
+	IsrGuard guard;
+	Entry_t* entry = &Entries[__get_IPSR() - EXCEPTIONS];
+	entry->Handler(entry->Context);
+}
 
 
 /**
@@ -14,8 +70,8 @@
 void Core::RegIrqHandler(IRQn_Type irqn, IrqHandler_t handler, int32_t priority)
 {
 	/// Write vector to the table
-	IrqHandler_t* table = (IrqHandler_t* )(SRAM_BASE + 0x40);
-	*(table + irqn) = handler;
+	IrqHandler_t* table = (IrqHandler_t* )MAP_IRQ_BASE;
+	*(table + EXCEPTIONS + irqn) = handler;
 	
 	/// Set priority
 	if(priority != -1)
@@ -23,8 +79,34 @@ void Core::RegIrqHandler(IRQn_Type irqn, IrqHandler_t handler, int32_t priority)
 		NVIC_SetPriority(irqn, priority);
 	}
 	
-	/// Enable interrupt
-	NVIC_EnableIRQ((IRQn_Type)irqn);
+	/// Enable interrupt (system handlers are always enabled)
+	if(irqn >= 0)
+	{
+		NVIC_EnableIRQ((IRQn_Type)irqn);
+	}
+}
+
+
+/**
+* @brief Interrupt handler with context registration
+* @param irqn - interrupt number (device interrupts only)
+* @param handler - interrupt handler pointer
+* @param context - handler context (e.g. the driver instance)
+* @param priority - interrupt priority
+*/
+void Core::RegIrqHandler(IRQn_Type irqn, IrqContextHandler_t handler, void* context, int32_t priority)
+{
+	if((irqn < 0) || ((int)irqn >= (int)IRQS))
+	{
+		return;
+	}
+	
+	/// The dispatcher is not called before the entry is complete
+	NVIC_DisableIRQ(irqn);
+	Entries[irqn].Handler = handler;
+	Entries[irqn].Context = context;
+	
+	RegIrqHandler(irqn, Core::Dispatch, priority);
 }
 
 
@@ -34,5 +116,8 @@ void Core::RegIrqHandler(IRQn_Type irqn, IrqHandler_t handler, int32_t priority)
 */
 void Core::UnregIrqHandler(IRQn_Type irqn)
 {
-	NVIC_DisableIRQ((IRQn_Type)irqn);
+	if(irqn >= 0)
+	{
+		NVIC_DisableIRQ((IRQn_Type)irqn);
+	}
 }
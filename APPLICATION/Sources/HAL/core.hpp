@@ -7,21 +7,71 @@
 #define __CORE_HPP
 
 #include "stm32l1xx.h"                  // Device header
+#include "irq_priority.hpp"
+#include "memory_map.h"
+#include "stack.hpp"
+#include "compiler.hpp"
 
 /// Interrupt handler
 typedef void (*IrqHandler_t)();
 
+/// Interrupt handler with context
+typedef void (*IrqContextHandler_t)(void* context);
+
 /**
 * @brief Core functions class
+* @note The vector table lives in SRAM (MAP_IRQ_BASE, set by VTOR in the startup code).
+* A plain handler is written to the table directly. A handler with context
+* is stored in the dispatch table, the vector gets the dispatcher, which takes
+* the entry of the active exception number and calls handler(context).
+* The dispatcher and the member adapters run from SRAM, so an SRAM resident
+* handler (RAMFUNC) is entered without a flash fetch.
 */
 class Core
 {
 	public:
+		enum Options_t
+		{
+			VECTORS = MAP_IRQ_SIZE / sizeof(uint32_t),	///< Vector table size
+			EXCEPTIONS = 16,							///< System exceptions count
+			IRQS = VECTORS - EXCEPTIONS,				///< Device interrupts count
+		};
+		
 		/// Interrupt handler registration
 		static void RegIrqHandler(IRQn_Type irqn, IrqHandler_t handler, int32_t priority = -1);
 		
+		/// Interrupt handler with context registration
+		static void RegIrqHandler(IRQn_Type irqn, IrqContextHandler_t handler, void* context, int32_t priority = -1);
+		
 		/// Interrupt handler unregistration
 		static void UnregIrqHandler(IRQn_Type irqn);
+		
+		/// Vector table initialization (startup code)
+		static void InitVectors();
+		
+		/**
+		* @brief Member function handler adapter
+		* @param context - object pointer
+		* @note Core::Member<Class, &Class::Method> is an IrqContextHandler_t
+		*/
+		template<class T, void (T::*Method)()>
+		RAMFUNC static void Member(void* context)
+		{
+			(static_cast<T*>(context)->*Method)();
+		};
+	
+	private:
+		static void Unhandled();			/// Unregistered interrupt handler
+		static void Dispatch();				/// Context handler dispatcher
+		
+		/// Dispatch table entry
+		struct Entry_t
+		{
+			IrqContextHandler_t Handler;	///< Handler
+			void* Context;					///< Handler context
+		};
+		
+		static Entry_t Entries[IRQS];			///< Dispatch table
 };
 
 #endif /* __CORE_HPP */
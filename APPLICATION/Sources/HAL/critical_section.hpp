@@ -0,0 +1,66 @@
+/**
+* @file critical_section.hpp
+* @brief Interrupt masking scope guards
+*/
+
+#ifndef __CRITICAL_SECTION_HPP
+#define __CRITICAL_SECTION_HPP
+
+#include "stm32l1xx.h"                  // Device header
+#include "irq_priority.hpp"
+#include <stdint.h>
+
+
+/**
+* @brief All interrupts masking scope guard (PRIMASK)
+* @note For the code, which no interrupt may preempt: clock switching,
+* flash programming, the priority 0 (smartcard) registers sharing.
+* Nests: the previous mask is restored.
+*/
+class CriticalSection
+{
+	public:
+		CriticalSection() : Primask(__get_PRIMASK())
+		{
+			__disable_irq();
+		};
+		
+		~CriticalSection()
+		{
+			__set_PRIMASK(Primask);
+		};
+	
+	private:
+		uint32_t Primask;	///< Previous mask
+};
+
+
+/**
+* @brief Priority level masking scope guard (BASEPRI)
+* @note Masks the interrupts of the priority and lower (numerically greater),
+* the higher priority interrupts still preempt. BASEPRI_MAX only raises the mask,
+* so the guards nest in any order. Priority 0 can't be masked this way,
+* the smartcard interrupt is never delayed by a lock (see LockPriority_t).
+*/
+class PriorityLock
+{
+	public:
+		/**
+		* @brief Masking
+		* @param priority - the highest masked priority (1..15)
+		*/
+		explicit PriorityLock(uint32_t priority) : Basepri(__get_BASEPRI())
+		{
+			__set_BASEPRI_MAX(priority << (8 - __NVIC_PRIO_BITS));
+		};
+		
+		~PriorityLock()
+		{
+			__set_BASEPRI(Basepri);
+		};
+	
+	private:
+		uint32_t Basepri;	///< Previous mask
+};
+
+#endif /* __CRITICAL_SECTION_HPP */
@@ -5,12 +5,25 @@
 
 #include "data_eeprom.hpp"
 #include "options.hpp"
+#include "trace.hpp"
+#include "metrics.hpp"
+#include "log.hpp"
+#include <string.h>
 
 
 #define FLASH_PEKEY1 ((uint32_t)0x89ABCDEF)
 #define FLASH_PEKEY2 ((uint32_t)0x02030405)
 
 
+/// Log messages
+LOG_FORMAT(LogCommitFailed, "data EEPROM commit failed, word %u, FLASH_SR 0x%08X");
+
+
+uint16_t DataEeprom::DirtyIndex[SHADOW_SIZE];
+uint32_t DataEeprom::DirtyValue[SHADOW_SIZE];
+uint32_t DataEeprom::DirtyCount;
+
+
 /**
 * @brief Returns the FLASH Status
 * @return FLASH_BUSY, FLASH_ERROR_PROGRAM, FLASH_ERROR_WRP, FLASH_COMPLETE
@@ -46,6 +59,54 @@ DataEeprom::FLASH_Status DataEeprom::GetStatus()
 }
 
 
+/**
+* @brief Wait until the memory is not busy
+* @return FLASH_ERROR_PROGRAM, FLASH_ERROR_WRP, FLASH_COMPLETE
+*/
+DataEeprom::FLASH_Status DataEeprom::WaitForLastOperation()
+{
+	FLASH_Status status;
+	while((status = GetStatus()) == FLASH_BUSY);
+	return status;
+}
+
+
+/**
+* @brief Data EEPROM unlocking
+*/
+void DataEeprom::Unlock()
+{
+	if((FLASH->PECR & FLASH_PECR_PELOCK) != RESET)
+	{
+		FLASH->PEKEYR = FLASH_PEKEY1;
+		FLASH->PEKEYR = FLASH_PEKEY2;
+	}
+}
+
+
+/**
+* @brief Data EEPROM locking
+*/
+void DataEeprom::Lock()
+{
+	WaitForLastOperation();
+	FLASH->PECR |= FLASH_PECR_PELOCK;
+}
+
+
+/**
+* @brief Address range checking
+* @param address - start address
+* @param count - bytes count
+* @return true, if the range lies within the data EEPROM
+*/
+bool DataEeprom::IsValidRange(uint32_t address, uint32_t count)
+{
+	return (address >= DATA_EEPROM_ADDRESS) && (count <= DATA_EEPROM_SIZE) &&
+		(address - DATA_EEPROM_ADDRESS <= DATA_EEPROM_SIZE - count);
+}
+
+
 /**
 * @brief Data writing
 * @param address - destination address (to)
@@ -56,7 +117,7 @@ DataEeprom::FLASH_Status DataEeprom::GetStatus()
 */
 bool DataEeprom::Write(uint32_t address, char* data, uint32_t count)
 {
-	if((address < DATA_EEPROM_ADDRESS) || (address > DATA_EEPROM_ADDRESS + 4096) || ((count % sizeof(uint32_t)) != 0))
+	if(!IsValidRange(address, count) || ((count % sizeof(uint32_t)) != 0))
 	{
 		return false;
 	}
@@ -64,23 +125,264 @@ bool DataEeprom::Write(uint32_t address, char* data, uint32_t count)
 	char* ptr = data;
 	uint32_t remaining = count;
 	
-	if((FLASH->PECR & FLASH_PECR_PELOCK) != RESET)
-	{
-		FLASH->PEKEYR = FLASH_PEKEY1;
-		FLASH->PEKEYR = FLASH_PEKEY2;
-	}
+	Unlock();
 	
 	while(remaining)
 	{
-		while(GetStatus() == FLASH_BUSY);
+		WaitForLastOperation();
 		*(__IO uint32_t *)address = *(uint32_t *)ptr;
 		address += sizeof(uint32_t);
 		ptr += sizeof(uint32_t);
 		remaining -= sizeof(uint32_t);
 	}
 	
-	while(GetStatus() == FLASH_BUSY);
-	FLASH->PECR |= FLASH_PECR_PELOCK;
+	Lock();
+	
+	/// Drop shadowed words, that have just been overwritten
+	uint16_t first = (address - count - DATA_EEPROM_ADDRESS) / sizeof(uint32_t);
+	uint16_t last = (address - DATA_EEPROM_ADDRESS) / sizeof(uint32_t);
+	uint32_t kept = 0;
+	for(uint32_t position = 0; position < DirtyCount; position++)
+	{
+		if((DirtyIndex[position] < first) || (DirtyIndex[position] >= last))
+		{
+			DirtyIndex[kept] = DirtyIndex[position];
+			DirtyValue[kept] = DirtyValue[position];
+			kept++;
+		}
+	}
+	DirtyCount = kept;
 	
 	return true;
 }
+
+
+/**
+* @brief Dirty word searching
+* @param index - word index (offset from the data EEPROM start / 4)
+* @return position in the shadow or -1, if the word is not dirty
+*/
+int32_t DataEeprom::FindWord(uint16_t index)
+{
+	/// Binary search in the ascending index list
+	int32_t low = 0;
+	int32_t high = (int32_t)DirtyCount - 1;
+	while(low <= high)
+	{
+		int32_t middle = (low + high) >> 1;
+		if(DirtyIndex[middle] == index)
+		{
+			return middle;
+		}
+		
+		if(DirtyIndex[middle] < index)
+		{
+			low = middle + 1;
+		}
+		else
+		{
+			high = middle - 1;
+		}
+	}
+	
+	return -1;
+}
+
+
+/**
+* @brief Dirty word adding
+* @param index - word index (offset from the data EEPROM start / 4)
+* @return position in the shadow or -1, if the shadow is full
+* @note The word is loaded with the current memory contents
+*/
+int32_t DataEeprom::InsertWord(uint16_t index)
+{
+	if(DirtyCount >= SHADOW_SIZE)
+	{
+		return -1;
+	}
+	
+	/// Keep the list ascending, so that Commit() programs in address order
+	int32_t position = DirtyCount;
+	while((position > 0) && (DirtyIndex[position - 1] > index))
+	{
+		DirtyIndex[position] = DirtyIndex[position - 1];
+		DirtyValue[position] = DirtyValue[position - 1];
+		position--;
+	}
+	
+	DirtyIndex[position] = index;
+	DirtyValue[position] = *(__IO uint32_t *)(DATA_EEPROM_ADDRESS + index * sizeof(uint32_t));
+	DirtyCount++;
+	
+	return position;
+}
+
+
+/**
+* @brief Data reading (through the shadow)
+* @param address - source address (from)
+* @param buffer - destination buffer pointer (to)
+* @param count - bytes count
+* @return true, if operation successful
+*/
+bool DataEeprom::Read(uint32_t address, void* buffer, uint32_t count)
+{
+	if(!IsValidRange(address, count))
+	{
+		return false;
+	}
+	
+	/// Data EEPROM is memory-mapped
+	memcpy(buffer, (const void *)address, count);
+	
+	/// Overlay uncommitted words
+	uint32_t offset = address - DATA_EEPROM_ADDRESS;
+	for(uint32_t position = 0; position < DirtyCount; position++)
+	{
+		uint32_t wordOffset = DirtyIndex[position] * sizeof(uint32_t);
+		if((wordOffset + sizeof(uint32_t) <= offset) || (wordOffset >= offset + count))
+		{
+			continue;
+		}
+		
+		const uint8_t* value = (const uint8_t *)&DirtyValue[position];
+		for(uint32_t byte = 0; byte < sizeof(uint32_t); byte++)
+		{
+			if((wordOffset + byte >= offset) && (wordOffset + byte < offset + count))
+			{
+				((uint8_t *)buffer)[wordOffset + byte - offset] = value[byte];
+			}
+		}
+	}
+	
+	return true;
+}
+
+
+/**
+* @brief Shadowed data writing
+* @param address - destination address (to)
+* @param data - source data pointer (from)
+* @param count - bytes count
+* @return true, if operation successful
+* @note Any alignment is allowed; repeated updates of the same word cost one program operation.
+* If the shadow overflows, it is committed implicitly.
+*/
+bool DataEeprom::Update(uint32_t address, const void* data, uint32_t count)
+{
+	if(!IsValidRange(address, count))
+	{
+		return false;
+	}
+	
+	const uint8_t* src = (const uint8_t *)data;
+	uint32_t offset = address - DATA_EEPROM_ADDRESS;
+	while(count)
+	{
+		uint16_t index = offset / sizeof(uint32_t);
+		int32_t position = FindWord(index);
+		if(position < 0)
+		{
+			position = InsertWord(index);
+			if(position < 0)
+			{
+				if(!Commit())
+				{
+					return false;
+				}
+				position = InsertWord(index);
+			}
+		}
+		
+		/// Patch the bytes of the word
+		uint8_t* value = (uint8_t *)&DirtyValue[position];
+		for(uint32_t byte = offset % sizeof(uint32_t); (byte < sizeof(uint32_t)) && count; byte++)
+		{
+			value[byte] = *src++;
+			offset++;
+			count--;
+		}
+	}
+	
+	return true;
+}
+
+
+/**
+* @brief Dirty words programming
+* @return true, if operation successful
+* @note Words that equal the memory contents are skipped. A failure keeps
+* the last programmed word and the unwritten ones dirty, so the next commit
+* retries them (a failed wait belongs to the previous programming).
+*/
+bool DataEeprom::Commit()
+{
+	bool result = true;
+	bool unlocked = false;
+	uint32_t written = 0;
+	
+	Trace::Record(TRACE_COMMIT_BEGIN, DirtyCount);
+	MetricsTimer timer(METRIC_EEPROM_BUSY);
+	
+	for(uint32_t position = 0; position < DirtyCount; position++)
+	{
+		__IO uint32_t* word = (__IO uint32_t *)(DATA_EEPROM_ADDRESS + DirtyIndex[position] * sizeof(uint32_t));
+		if(*word == DirtyValue[position])
+		{
+			continue;
+		}
+		
+		if(!unlocked)
+		{
+			Unlock();
+			
+			/// Clear error flags of the previous operations
+			FLASH->SR = FLASH_SR_WRPERR | (uint32_t)0x1E00;
+			unlocked = true;
+		}
+		
+		if(WaitForLastOperation() != FLASH_COMPLETE)
+		{
+			Log::Write(LogCommitFailed, DirtyIndex[position], FLASH->SR);
+			result = false;
+			break;
+		}
+		*word = DirtyValue[position];
+		written = position;
+	}
+	
+	if(unlocked)
+	{
+		/// The last written word state is unknown, it stays dirty with the unwritten ones
+		if(result && (WaitForLastOperation() != FLASH_COMPLETE))
+		{
+			result = false;
+		}
+		Lock();
+	}
+	
+	if(result)
+	{
+		DirtyCount = 0;
+	}
+	else
+	{
+		memmove(&DirtyIndex[0], &DirtyIndex[written], (DirtyCount - written) * sizeof(DirtyIndex[0]));
+		memmove(&DirtyValue[0], &DirtyValue[written], (DirtyCount - written) * sizeof(DirtyValue[0]));
+		DirtyCount -= written;
+	}
+	
+	Metrics::Count(result ? METRIC_EEPROM_COMMITS : METRIC_EEPROM_ERRORS);
+	Trace::Record(TRACE_COMMIT_END, result);
+	return result;
+}
+
+
+/**
+* @brief Dirty words discarding
+*/
+void DataEeprom::Discard()
+{
+	DirtyCount = 0;
+}
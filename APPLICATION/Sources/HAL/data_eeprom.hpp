@@ -14,15 +14,36 @@
 
 /**
 * @brief Data EEPROM interface class
+* @note Update() collects changes in the RAM shadow (dirty words),
+* Commit() programs only the changed words in address order, the words
+* stay dirty until they are programmed or discarded
 */
 class DataEeprom
 {
 	public:
-		static bool Write(uint32_t address, char* data, uint32_t count);	/// Data writing
+		enum Options_t
+		{
+			SHADOW_SIZE = 32,	///< Shadow capacity (dirty words)
+		};
+		
+		static bool Write(uint32_t address, char* data, uint32_t count);			/// Data writing
+		static bool Read(uint32_t address, void* buffer, uint32_t count);			/// Data reading (through the shadow)
+		static bool Update(uint32_t address, const void* data, uint32_t count);	/// Shadowed data writing
+		static bool Commit();														/// Dirty words programming
+		static void Discard();														/// Dirty words discarding
+		
+		/**
+		* @brief Check, whether the shadow holds uncommitted data
+		* @return true, if there are dirty words
+		*/
+		static bool IsDirty()
+		{
+			return DirtyCount != 0;
+		};
 	
 	private:
-		/** 
-		* @brief FLASH Status  
+		/**
+		* @brief FLASH Status
 		*/
 		typedef enum
 		{
@@ -33,7 +54,17 @@ class DataEeprom
 			FLASH_TIMEOUT
 		} FLASH_Status;
 		
-		static FLASH_Status GetStatus();									/// 
+		static FLASH_Status GetStatus();									///
+		static FLASH_Status WaitForLastOperation();						/// Wait until the memory is not busy
+		static void Unlock();												/// Data EEPROM unlocking
+		static void Lock();													/// Data EEPROM locking
+		static bool IsValidRange(uint32_t address, uint32_t count);		/// Address range checking
+		static int32_t FindWord(uint16_t index);							/// Dirty word searching
+		static int32_t InsertWord(uint16_t index);							/// Dirty word adding
+		
+		static uint16_t DirtyIndex[SHADOW_SIZE];	///< Dirty word indexes (ascending)
+		static uint32_t DirtyValue[SHADOW_SIZE];	///< Dirty word values
+		static uint32_t DirtyCount;					///< Dirty words count
 };
 
 #endif /* __DATA_EEPROM_HPP */
@@ -0,0 +1,136 @@
+/**
+* @file flash.cpp
+* @brief Flash program memory interface implementation
+*/
+
+#include "flash.hpp"
+#include "critical_section.hpp"
+#include "compiler.hpp"
+
+
+#define FLASH_PEKEY1 ((uint32_t)0x89ABCDEF)
+#define FLASH_PEKEY2 ((uint32_t)0x02030405)
+#define FLASH_PRGKEY1 ((uint32_t)0x8C9DAEBF)
+#define FLASH_PRGKEY2 ((uint32_t)0x13141516)
+
+
+/**
+* @brief Program memory unlocking
+*/
+void Flash::Unlock()
+{
+	if((FLASH->PECR & FLASH_PECR_PELOCK) != RESET)
+	{
+		FLASH->PEKEYR = FLASH_PEKEY1;
+		FLASH->PEKEYR = FLASH_PEKEY2;
+	}
+	
+	if((FLASH->PECR & FLASH_PECR_PRGLOCK) != RESET)
+	{
+		FLASH->PRGKEYR = FLASH_PRGKEY1;
+		FLASH->PRGKEYR = FLASH_PRGKEY2;
+	}
+	
+	/// Clear error flags of the previous operations
+	FLASH->SR = FLASH_SR_WRPERR | (uint32_t)0x1E00;
+}
+
+
+/**
+* @brief Program memory locking
+*/
+void Flash::Lock()
+{
+	FLASH->PECR |= FLASH_PECR_PRGLOCK;
+	FLASH->PECR |= FLASH_PECR_PELOCK;
+}
+
+
+/**
+* @brief Wait until the memory is not busy
+* @return true, if the last operation is successful
+*/
+bool Flash::WaitForLastOperation()
+{
+	while(FLASH->SR & FLASH_SR_BSY);
+	return !(FLASH->SR & (FLASH_SR_WRPERR | (uint32_t)0x1E00));
+}
+
+
+/**
+* @brief Page erasing
+* @param address - page address
+* @return true, if operation successful
+* @note The CPU is stalled while the page is erased
+*/
+bool Flash::ErasePage(uint32_t address)
+{
+	if(address % PAGE_SIZE)
+	{
+		return false;
+	}
+	
+	Unlock();
+	WaitForLastOperation();
+	
+	FLASH->PECR |= FLASH_PECR_ERASE | FLASH_PECR_PROG;
+	*(__IO uint32_t *)address = 0;
+	bool result = WaitForLastOperation();
+	FLASH->PECR &= ~(FLASH_PECR_ERASE | FLASH_PECR_PROG);
+	
+	Lock();
+	
+	return result;
+}
+
+
+/**
+* @brief Half page programming
+* @param address - half page address
+* @param data - source data (32 words, should be in RAM)
+* @return true, if operation successful
+* @note The page should be erased. Interrupts are disabled for the programming time.
+*/
+bool Flash::WriteHalfPage(uint32_t address, const uint32_t* data)
+{
+	if(address % HALF_PAGE_SIZE)
+	{
+		return false;
+	}
+	
+	Unlock();
+	WaitForLastOperation();
+	
+	/// Program memory can't be read during half page programming,
+	/// so neither the kernel nor interrupt handlers may run from it
+	{
+		CriticalSection section;
+		WriteHalfPageRam((__IO uint32_t *)address, data);
+	}
+	
+	bool result = WaitForLastOperation();
+	
+	Lock();
+	
+	return result;
+}
+
+
+/**
+* @brief Half page programming (executed from RAM)
+* @param address - half page address
+* @param data - source data (32 words)
+*/
+RAMFUNC void Flash::WriteHalfPageRam(__IO uint32_t* address, const uint32_t* data)
+{
+	FLASH->PECR |= FLASH_PECR_FPRG | FLASH_PECR_PROG;
+	
+	for(uint32_t index = 0; index < HALF_PAGE_SIZE / sizeof(uint32_t); index++)
+	{
+		*address++ = *data++;
+	}
+	
+	while(FLASH->SR & FLASH_SR_BSY);
+	
+	FLASH->PECR &= ~(FLASH_PECR_FPRG | FLASH_PECR_PROG);
+}
@@ -0,0 +1,34 @@
+/**
+* @file flash.hpp
+* @brief Flash program memory interface header
+*/
+
+#ifndef __FLASH_HPP
+#define __FLASH_HPP
+
+#include "stm32l1xx.h"                  // Device header
+
+
+/**
+* @brief Flash program memory interface class
+*/
+class Flash
+{
+	public:
+		enum Options_t
+		{
+			PAGE_SIZE = 256,		///< Page size (erase unit)
+			HALF_PAGE_SIZE = 128,	///< Half page size (program unit)
+		};
+		
+		static bool ErasePage(uint32_t address);								/// Page erasing
+		static bool WriteHalfPage(uint32_t address, const uint32_t* data);	/// Half page programming
+		
+	private:
+		static void Unlock();													/// Program memory unlocking
+		static void Lock();														/// Program memory locking
+		static bool WaitForLastOperation();										/// Wait until the memory is not busy
+		static void WriteHalfPageRam(__IO uint32_t* address, const uint32_t* data);	/// Half page programming (executed from RAM)
+};
+
+#endif /* __FLASH_HPP */
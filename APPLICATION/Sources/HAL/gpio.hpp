@@ -0,0 +1,156 @@
+/**
+* @file gpio.hpp
+* @brief Compile-time GPIO pins header
+*/
+
+#ifndef __GPIO_HPP
+#define __GPIO_HPP
+
+#include "stm32l1xx.h"                  // Device header
+#include <stdint.h>
+
+
+/// Pin modes (MODER)
+enum GpioMode_t
+{
+	GPIO_INPUT = 0,			///< Input
+	GPIO_OUTPUT = 1,		///< General purpose output
+	GPIO_ALTERNATE = 2,		///< Alternate function
+	GPIO_ANALOG = 3,		///< Analog
+};
+
+/// Pin pull resistors (PUPDR)
+enum GpioPull_t
+{
+	GPIO_NO_PULL = 0,		///< No pull
+	GPIO_PULL_UP = 1,		///< Pull-up
+	GPIO_PULL_DOWN = 2,		///< Pull-down
+};
+
+/// Pin output types (OTYPER)
+enum GpioType_t
+{
+	GPIO_PUSH_PULL = 0,		///< Push-pull
+	GPIO_OPEN_DRAIN = 1,	///< Open drain
+};
+
+
+/**
+* @brief GPIO pin
+* @note Port, number and configuration are template parameters, so every
+* access is a single load or store of a constant address and value.
+* The register fields are merged by GpioPort.
+*/
+template<uint32_t Port, uint8_t N, uint8_t Mode, uint8_t Af = 0, uint8_t Pull = GPIO_NO_PULL, uint8_t Type = GPIO_PUSH_PULL>
+class Pin
+{
+	public:
+		enum Options_t
+		{
+			MODER_MASK = 3UL << (N * 2),											///< MODER field
+			MODER = (uint32_t)Mode << (N * 2),										///< MODER value
+			PUPDR = (uint32_t)Pull << (N * 2),										///< PUPDR value
+			OTYPER_MASK = 1UL << N,													///< OTYPER field
+			OTYPER = (uint32_t)Type << N,											///< OTYPER value
+			AFRL_MASK = (N < 8) ? 0xFUL << ((N & 7) * 4) : 0,						///< AFR[0] field
+			AFRL = (N < 8) && (Mode == GPIO_ALTERNATE) ? (uint32_t)Af << ((N & 7) * 4) : 0,		///< AFR[0] value
+			AFRH_MASK = (N >= 8) ? 0xFUL << ((N & 7) * 4) : 0,						///< AFR[1] field
+			AFRH = (N >= 8) && (Mode == GPIO_ALTERNATE) ? (uint32_t)Af << ((N & 7) * 4) : 0,	///< AFR[1] value
+			OUTPUTS = (Mode == GPIO_OUTPUT) ? 1UL << N : 0,							///< Output driven low at initialization
+		};
+		
+		/**
+		* @brief Output setting high
+		*/
+		static void Set()
+		{
+			((GPIO_TypeDef *)Port)->BSRR = 1UL << N;
+		};
+		
+		/**
+		* @brief Output setting low
+		*/
+		static void Clear()
+		{
+			((GPIO_TypeDef *)Port)->BSRR = 1UL << (N + 16);
+		};
+		
+		/**
+		* @brief Input reading
+		* @return true, if the input is high
+		*/
+		static bool Read()
+		{
+			return ((GPIO_TypeDef *)Port)->IDR & (1UL << N);
+		};
+};
+
+
+/**
+* @brief Unused GpioPort parameter
+*/
+class NoPin
+{
+	public:
+		enum Options_t
+		{
+			MODER_MASK = 0, MODER = 0, PUPDR = 0, OTYPER_MASK = 0, OTYPER = 0,
+			AFRL_MASK = 0, AFRL = 0, AFRH_MASK = 0, AFRH = 0, OUTPUTS = 0,
+		};
+};
+
+
+/**
+* @brief GPIO port configuration
+* @note The fields of all the pins are merged at compile time, Init() makes
+* one read-modify-write per register, the pins not listed keep their configuration
+* (e.g. SWD). All the listed pins must belong to the port.
+*/
+template<uint32_t Port, class P0, class P1 = NoPin, class P2 = NoPin, class P3 = NoPin, class P4 = NoPin, class P5 = NoPin,
+	class P6 = NoPin, class P7 = NoPin, class P8 = NoPin, class P9 = NoPin, class P10 = NoPin, class P11 = NoPin>
+class GpioPort
+{
+	public:
+		/// Merged register fields
+		enum Options_t
+		{
+			MODER_MASK = P0::MODER_MASK | P1::MODER_MASK | P2::MODER_MASK | P3::MODER_MASK | P4::MODER_MASK | P5::MODER_MASK
+				| P6::MODER_MASK | P7::MODER_MASK | P8::MODER_MASK | P9::MODER_MASK | P10::MODER_MASK | P11::MODER_MASK,
+			MODER = P0::MODER | P1::MODER | P2::MODER | P3::MODER | P4::MODER | P5::MODER
+				| P6::MODER | P7::MODER | P8::MODER | P9::MODER | P10::MODER | P11::MODER,
+			PUPDR = P0::PUPDR | P1::PUPDR | P2::PUPDR | P3::PUPDR | P4::PUPDR | P5::PUPDR
+				| P6::PUPDR | P7::PUPDR | P8::PUPDR | P9::PUPDR | P10::PUPDR | P11::PUPDR,
+			OTYPER_MASK = P0::OTYPER_MASK | P1::OTYPER_MASK | P2::OTYPER_MASK | P3::OTYPER_MASK | P4::OTYPER_MASK | P5::OTYPER_MASK
+				| P6::OTYPER_MASK | P7::OTYPER_MASK | P8::OTYPER_MASK | P9::OTYPER_MASK | P10::OTYPER_MASK | P11::OTYPER_MASK,
+			OTYPER = P0::OTYPER | P1::OTYPER | P2::OTYPER | P3::OTYPER | P4::OTYPER | P5::OTYPER
+				| P6::OTYPER | P7::OTYPER | P8::OTYPER | P9::OTYPER | P10::OTYPER | P11::OTYPER,
+			AFRL_MASK = P0::AFRL_MASK | P1::AFRL_MASK | P2::AFRL_MASK | P3::AFRL_MASK | P4::AFRL_MASK | P5::AFRL_MASK
+				| P6::AFRL_MASK | P7::AFRL_MASK | P8::AFRL_MASK | P9::AFRL_MASK | P10::AFRL_MASK | P11::AFRL_MASK,
+			AFRL = P0::AFRL | P1::AFRL | P2::AFRL | P3::AFRL | P4::AFRL | P5::AFRL
+				| P6::AFRL | P7::AFRL | P8::AFRL | P9::AFRL | P10::AFRL | P11::AFRL,
+			AFRH_MASK = P0::AFRH_MASK | P1::AFRH_MASK | P2::AFRH_MASK | P3::AFRH_MASK | P4::AFRH_MASK | P5::AFRH_MASK
+				| P6::AFRH_MASK | P7::AFRH_MASK | P8::AFRH_MASK | P9::AFRH_MASK | P10::AFRH_MASK | P11::AFRH_MASK,
+			AFRH = P0::AFRH | P1::AFRH | P2::AFRH | P3::AFRH | P4::AFRH | P5::AFRH
+				| P6::AFRH | P7::AFRH | P8::AFRH | P9::AFRH | P10::AFRH | P11::AFRH,
+			OUTPUTS = P0::OUTPUTS | P1::OUTPUTS | P2::OUTPUTS | P3::OUTPUTS | P4::OUTPUTS | P5::OUTPUTS
+				| P6::OUTPUTS | P7::OUTPUTS | P8::OUTPUTS | P9::OUTPUTS | P10::OUTPUTS | P11::OUTPUTS,
+		};
+		
+		/**
+		* @brief Port configuration
+		* @note The outputs are driven low before they are switched to the output mode
+		*/
+		static void Init()
+		{
+			GPIO_TypeDef* port = (GPIO_TypeDef *)Port;
+			
+			port->BSRR = (uint32_t)OUTPUTS << 16;
+			port->OTYPER = (port->OTYPER & ~(uint32_t)OTYPER_MASK) | OTYPER;
+			port->PUPDR = (port->PUPDR & ~(uint32_t)MODER_MASK) | PUPDR;	/// The same field layout
+			port->AFR[0] = (port->AFR[0] & ~(uint32_t)AFRL_MASK) | AFRL;
+			port->AFR[1] = (port->AFR[1] & ~(uint32_t)AFRH_MASK) | AFRH;
+			port->MODER = (port->MODER & ~(uint32_t)MODER_MASK) | MODER;
+		};
+};
+
+#endif /* __GPIO_HPP */
@@ -0,0 +1,45 @@
+/**
+* @file irq_priority.hpp
+* @brief Interrupt priorities
+*/
+
+#ifndef __IRQ_PRIORITY_HPP
+#define __IRQ_PRIORITY_HPP
+
+
+/**
+* @brief Interrupt priorities (0 - the highest, 15 - the lowest, all bits preempt)
+* @note Interrupt handlers only move data and post events or work items.
+* Smartcard bytes preempt everything, so card timing never waits for the bus;
+* deferred work (PendSV) runs after all the interrupts. The worst case latency
+* of a level is the sum of the handlers above it.
+*/
+enum IrqPriority_t
+{
+	IRQ_PRIORITY_USART2 = 0,	///< ISO7816 character (guard time, parity error retransmission)
+	IRQ_PRIORITY_TIM9 = 1,		///< System timer overflow and alarm
+	IRQ_PRIORITY_PROFILER = 1,	///< PC sampling (SysTick), samples all the handlers but the smartcard
+	IRQ_PRIORITY_DMA = 2,		///< DMA channels (bus)
+	IRQ_PRIORITY_USART1 = 2,	///< Bus transmission complete (RS485 direction), line idle
+	IRQ_PRIORITY_FLASH = 3,		///< Flash and data EEPROM
+	IRQ_PRIORITY_EXTI = 3,		///< Card detect
+	IRQ_PRIORITY_BENCHMARK = 14,	///< Interrupt entry benchmark (software pended, see Benchmark)
+	IRQ_PRIORITY_PENDSV = 15,	///< Deferred work queue
+};
+
+
+/**
+* @brief Lock levels (see PriorityLock)
+* @note A lock masks the highest priority, which shares the data, and all
+* lower ones. No lock masks USART2, its registers are shared under CriticalSection
+* for a few instructions only.
+*/
+enum LockPriority_t
+{
+	LOCK_PRIORITY_SYSTEM_TIMER = IRQ_PRIORITY_TIM9,	///< System timer alarm (re-armed by the TIM9 handler)
+	LOCK_PRIORITY_BUS = IRQ_PRIORITY_USART1,		///< Bus USART registers (USART1 handler)
+	LOCK_PRIORITY_EVENTS = IRQ_PRIORITY_USART1,		///< Event queue (posted by the bus idle and card detect handlers)
+	LOCK_PRIORITY_TIMERS = IRQ_PRIORITY_PENDSV,		///< Software timer lists (advanced by the deferred work)
+};
+
+#endif /* __IRQ_PRIORITY_HPP */
@@ -6,28 +6,47 @@
 #include "iso7816.hpp"
 #include "board.hpp"
 #include "system_timer.hpp"
+#include "clock.hpp"
+#include "compiler.hpp"
+#include "critical_section.hpp"
+#include "trace.hpp"
+#include "metrics.hpp"
+#include "capture.hpp"
+#include "memory_map.h"
+#include "static_assert.hpp"
 #include <string.h>
 
 
 ISO7816 ISO7816_1;
 
+STATIC_ASSERT(sizeof(ISO7816) <= ISO7816_RAM_BUDGET, iso7816_ram_budget);
+
 
 /// Module options
 enum Options_t
 {
-	ISO7816_RX_BUFFER_SIZE = 64,			///< TX buffer size
-	ISO7816_TX_BUFFER_SIZE = 64,			///< RX buffer size
 	ISO7816_ETU = 372,						///< Elementary Time Unit (ISO7816-3 3.1.a)
-	ISO7816_FREQUENCY = 3000000,			///< Basic frequency (Hz) (baudrate 3600000 / 372 = 9677 baud)
+	ISO7816_FREQUENCY = 3000000,			///< Max card clock frequency (Hz) (baudrate 3000000 / 372 = 8064 baud)
+	ISO7816_MAX_PRESCALER = 31,				///< Max card clock prescaler (GTPR.PSC)
 	ISO7816_T3_TICKS = 40000,				///< Delay before reset procedure (tact count) (t3 (ISO7816-3 3.2.b))
+	ISO7816_CHAR_ETU = 16,					///< Character time including guard time (etu)
+	ISO7816_WWT_FI = 960 * 10,				///< Work waiting time (960 * WI * Fi card clocks, WI = 10) (ISO7816-3 10.2)
 	ISO7816_BIT_CONVETNTION_DIRECT = 0x3B,	///< Data polarity - direct
 	ISO7816_PROTOCOL_T0 = 0x00,				///< Protocol - T0 (asynchronous, half-duplex, character)
 };
 
 
-/// Fi table
-const uint16_t ISO7816_FI[] = 
+/// Fi table (TA1 high nibble, 0 - RFU)
+const uint16_t ISO7816_FI[16] = 
 {
+	372,
+	372,
+	558,
+	744,
+	1116,
+	1488,
+	1860,
+	0,
 	0,
 	512,
 	768,
@@ -39,17 +58,25 @@ const uint16_t ISO7816_FI[] =
 };
 
 
-/// Di table
-const uint8_t ISO7816_DI[] = 
+/// Di table (TA1 low nibble, 0 - RFU)
+const uint8_t ISO7816_DI[16] = 
 {
 	0,
-	0,
+	1,
 	2,
 	4,
 	8,
 	16,
 	32,
 	64,
+	12,
+	20,
+	0,
+	0,
+	0,
+	0,
+	0,
+	0,
 };
 
 
@@ -65,32 +92,36 @@ enum INS_t
 /**
 * @brief Coustructor
 */
-ISO7816::ISO7816()
-{
-	RxBuffer = new CircularBuffer(ISO7816_RX_BUFFER_SIZE);
-	TxBuffer = new CircularBuffer(ISO7816_TX_BUFFER_SIZE);
-}
-
-
-/**
-* @brief Interrupt handler
-*/
-void ISO7816::ISO7816_1_Handler()
+ISO7816::ISO7816() : TxBuffer(TxStorage, sizeof(TxStorage))
 {
-	ISO7816_1.Handler();
+	RxIn = 0;
+	RxOut = 0;
+	Clock::Subscribe(CLOCK_LISTENER_ISO7816, ISO7816::ClockChanged);
 }
 
 
 /**
 * @brief Interrupt handler
+* @note Receiving only moves the byte to the ring: the interrupt owns the input
+* index and the reader owns the output index, so neither side locks
 */
-void ISO7816::Handler()
+RAMFUNC void ISO7816::Handler()
 {
-	/// If receiver is not empty, put data into the buffer
+	/// If receiver is not empty, put data into the ring (drop on overflow)
 	if(USART2->SR & USART_SR_RXNE)
 	{
-		__IO uint8_t data = USART2->DR;
-		RxBuffer->PutChar(data);
+		uint8_t data = USART2->DR;
+		Capture::Record(CAPTURE_CARD_RX, data);
+		uint8_t in = RxIn;
+		if((uint8_t)(in - RxOut) < RX_SIZE)
+		{
+			RxRing[in & (RX_SIZE - 1)] = data;
+			RxIn = in + 1;
+		}
+		else
+		{
+			Metrics::Count(METRIC_CARD_OVERRUNS);
+		}
 	}
 	
 	/// If transmitter is empty, transmit byte from the queue
@@ -102,11 +133,13 @@ void ISO7816::Handler()
 		if((USART2->SR & USART_SR_PE) /*&& (USART6->CR1 & USART_CR1_TXEIE)*/)
 		{
 			USART2->DR = BackupChar;
+			Metrics::Count(METRIC_CARD_PARITY);
 		}
-		else if(TxBuffer->GetChar(&data))
+		else if(TxBuffer.GetChar(&data))
 		{
 			BackupChar = data;
 			USART2->DR = data;
+			Capture::Record(CAPTURE_CARD_TX, data);
 		}
 		else if(USART2->CR1 & USART_CR1_TXEIE)
 		{
@@ -132,30 +165,27 @@ void ISO7816::Handler()
 */
 void ISO7816::Transmit(const void* data, uint16_t count)
 {
-    NVIC_DisableIRQ(USART2_IRQn);
-	{
-		RxBuffer->Reset();
-	}
-    NVIC_EnableIRQ(USART2_IRQn);
+	RxOut = RxIn;
 	
 	/// Transmit data
-	TxBuffer->Put(data, count);
-	USART2->CR1 |= USART_CR1_TXEIE;
+	TxBuffer.Put(data, count);
+	{
+		/// The handler changes CR1 as well
+		CriticalSection section;
+		USART2->CR1 |= USART_CR1_TXEIE;
+	}
 	
-	/// Wait for transmission complete
-	for(uint32_t waitTo = SystemTimer::GetTime() + 1; SystemTimer::GetTime() < waitTo;)
+	/// Wait for transmission complete (echo), allow a retransmission of each char
+	for(uint64_t waitTo = SystemTimer::GetMicros() + 2 * (count + 1) * CharTime; SystemTimer::GetMicros() < waitTo;)
 	{
-		if(RxBuffer->GetByteCount() >= count)
+		if(GetReceivedCount() >= count)
 		{
 			break;
 		}
 	}
 	
-    NVIC_DisableIRQ(USART2_IRQn);
-	{
-		RxBuffer->Delete(count);
-	}
-    NVIC_EnableIRQ(USART2_IRQn);
+	/// Skip the echo
+	RxOut = GetReceivedCount() < count ? RxIn : (uint8_t)(RxOut + count);
 }
 
 
@@ -166,14 +196,60 @@ void ISO7816::Transmit(const void* data, uint16_t count)
 */
 bool ISO7816::GetReceivedChar(char* chr)
 {
-	for(uint32_t index = 0; index < HSE_VALUE; index++)
+	for(uint64_t waitTo = SystemTimer::GetMicros() + WaitTime; GetReceivedCount() == 0;)
 	{
-		if(RxBuffer->GetChar(chr))
+		if(SystemTimer::GetMicros() >= waitTo)
 		{
-			return true;
+			Metrics::Count(METRIC_CARD_TIMEOUTS);
+			return false;
 		}
 	}
-	return false;
+	
+	*chr = RxRing[RxOut & (RX_SIZE - 1)];
+	RxOut++;
+	return true;
+}
+
+
+/**
+* @brief Card clock, baudrate and timings tuning
+* @param fi - clock rate conversion integer (Fi)
+* @param etu - elementary time unit (card clocks, Fi / Di)
+* @note Card clock is the system clock divided by 2 * PSC, the baudrate divider
+* is a whole number of system clocks per etu. The work waiting time depends
+* on Fi only, not on Di.
+*/
+void ISO7816::SetEtu(uint16_t fi, uint16_t etu)
+{
+	uint32_t frequency = Clock::GetFrequency();
+	uint32_t prescaler = (frequency + 2 * ISO7816_FREQUENCY - 1) / (2 * ISO7816_FREQUENCY);
+	if(prescaler > ISO7816_MAX_PRESCALER)
+	{
+		prescaler = ISO7816_MAX_PRESCALER;
+	}
+	
+	Fi = fi;
+	Etu = etu;
+	Metrics::Set(METRIC_CARD_ETU, etu);
+	CardClock = frequency / (2 * prescaler);
+	USART2->GTPR = (16 << 8) | prescaler;
+	USART2->BRR = 2 * prescaler * etu;
+	
+	CharTime = (uint32_t)(((uint64_t)ISO7816_CHAR_ETU * etu * 1000000) / CardClock) + 1;
+	WaitTime = (uint32_t)(((uint64_t)ISO7816_WWT_FI * fi * 1000000) / CardClock);
+}
+
+
+/**
+* @brief System clock change handler
+* @note Active interface follows the new clock, idle one is tuned on activation
+*/
+void ISO7816::ClockChanged()
+{
+	if(RCC->APB1ENR & RCC_APB1ENR_USART2EN)
+	{
+		ISO7816_1.SetEtu(ISO7816_1.Fi, ISO7816_1.Etu);
+	}
 }
 
 
@@ -184,10 +260,10 @@ bool ISO7816::GetReceivedChar(char* chr)
 */
 bool ISO7816::ActivateCard(ATR_t* pAtr)
 {
-	RCC->APB2RSTR |= RCC_APB1RSTR_USART2RST;
-	RCC->APB2RSTR &= ~RCC_APB1RSTR_USART2RST;
+	RCC->APB1RSTR |= RCC_APB1RSTR_USART2RST;
+	RCC->APB1RSTR &= ~RCC_APB1RSTR_USART2RST;
 	RCC->APB1ENR |= RCC_APB1ENR_USART2EN;
-	Core::RegIrqHandler(USART2_IRQn, ISO7816_1_Handler);
+	Core::RegIrqHandler(USART2_IRQn, Core::Member<ISO7816, &ISO7816::Handler>, this, IRQ_PRIORITY_USART2);
 	
 	USART2->CR1 = USART_CR1_RE | USART_CR1_TE | USART_CR1_RXNEIE | USART_CR1_PEIE | USART_CR1_PCE | USART_CR1_M | USART_CR1_UE;
 	USART2->CR2 = USART_CR2_LBCL | USART_CR2_CLKEN | USART_CR2_STOP;
@@ -198,11 +274,8 @@ bool ISO7816::ActivateCard(ATR_t* pAtr)
 	/// Polarity low (USART_CR2_CPHA = 0)
 	/// Phase on front (USART_CR2_CPOL = 0)
 	/// Frame length 9 bits (8 data bits + 1 parity) (USART_CR1_M = 1)
-	uint32_t baud = ISO7816_FREQUENCY / ISO7816_ETU;
-	uint32_t integerDivider = HSE_VALUE / (16 * baud);
-	uint32_t fractionalDivider = (10000 * (HSE_VALUE - (16 * integerDivider))) / (16 * baud);
-	USART2->BRR = (integerDivider << 4) | (fractionalDivider & 0x0F);
-	USART2->GTPR = (16 << 8) | ((HSE_VALUE / ISO7816_FREQUENCY) / 2);
+	SetEtu(ISO7816_ETU, ISO7816_ETU);
+	uint32_t resetTime = (uint32_t)(((uint64_t)ISO7816_T3_TICKS * 1000000) / CardClock);
 	
 	/// ATR reading cycle
 	ATR_t atr;
@@ -211,15 +284,16 @@ bool ISO7816::ActivateCard(ATR_t* pAtr)
 	Board::Set_ISO7816_VCC_High();
 	
 	/// Wait t3 interval
-	for(uint32_t index = 0; index < ISO7816_T3_TICKS * (HSE_VALUE / ISO7816_FREQUENCY); index++);
+	SystemTimer::Delay(resetTime);
 	
 	Board::Set_ISO7816_RST_High();
+	Capture::Record(CAPTURE_CARD_RESET);
 	
 	/// If no answer for t3 interval, return error
 	bool response = false;
-	for(uint32_t index = 0; index < ISO7816_T3_TICKS * (HSE_VALUE / ISO7816_FREQUENCY); index++)
+	for(uint64_t waitTo = SystemTimer::GetMicros() + resetTime; SystemTimer::GetMicros() < waitTo;)
 	{
-		if(!RxBuffer->IsEmpty())
+		if(GetReceivedCount())
 		{
 			response = true;
 			break;
@@ -263,6 +337,8 @@ bool ISO7816::ActivateCard(ATR_t* pAtr)
 		}
 	}
 	
+	Trace::Record(TRACE_ATR);
+	
 	if((atr.TS != ISO7816_BIT_CONVETNTION_DIRECT) || ((atr.TD1 & 0x0F) != ISO7816_PROTOCOL_T0))
 	{
 		return false;
@@ -272,6 +348,21 @@ bool ISO7816::ActivateCard(ATR_t* pAtr)
 	/// Negotiable mode
 	if(!(atr.TD1 & (1 << 4)))
 	{
+		/// Get Fi and Di parameters
+		uint16_t fi = ISO7816_FI[atr.TA1 >> 4];
+		uint8_t di = ISO7816_DI[atr.TA1 & 0x0F];
+		
+		/// Reserved values (or no TA1) are not negotiated, the card stays on the default etu
+		if(!fi || !di)
+		{
+			if(pAtr)
+			{
+				memcpy(pAtr, &atr, sizeof(ATR_t));
+			}
+			
+			return true;
+		}
+		
 		char buffer1[4];
 		/*	PTSS	*/	buffer1[0] = 0xFF;
 		/*	PTS0	*/	buffer1[1] = (1 << 4) | (atr.T0 & (1 << 7) ? (atr.TD1 & 0x0F) : 0x00);
@@ -291,18 +382,13 @@ bool ISO7816::ActivateCard(ATR_t* pAtr)
 		if(memcmp((char *)&buffer1, buffer2, 4))
 		{
 			/// If data is different, return error
+			Metrics::Count(METRIC_PPS_MISMATCHES);
 			return false;
 		}
 		
-		/// Get Fi and Di parameters
-		uint16_t fi = ISO7816_FI[(atr.TA1 >> 4) & 0x07];
-		uint8_t di = ISO7816_DI[atr.TA1 & 0x07];
-		
 		/// Reconfigure USART
-		baud = ISO7816_FREQUENCY / (fi / di);
-		integerDivider = HSE_VALUE / (16 * baud);
-		fractionalDivider = (10000 * (HSE_VALUE - (16 * integerDivider))) / (16 * baud);
-		USART2->BRR = (integerDivider << 4) | (fractionalDivider & 0x0F);
+		SetEtu(fi, fi / di);
+		Trace::Record(TRACE_PPS, fi / di);
 		
 		if(pAtr)
 		{
@@ -323,7 +409,7 @@ bool ISO7816::ActivateCard(ATR_t* pAtr)
 bool ISO7816::DeactivateCard()
 {
 	/// Deactivate interface
-	RCC->APB2RSTR |= RCC_APB1RSTR_USART2RST;
+	RCC->APB1RSTR |= RCC_APB1RSTR_USART2RST;
 	RCC->APB1ENR &= ~RCC_APB1ENR_USART2EN;
 	Core::UnregIrqHandler(USART2_IRQn);
 	Board::Set_ISO7816_RST_Low();
@@ -342,6 +428,9 @@ bool ISO7816::DeactivateCard()
 */
 uint16_t ISO7816::SendTPDU(const TPDU_t* tpdu, const void* data, uint8_t count, Case_t exchangeCase)
 {
+	TraceSpan span(TRACE_APDU_BEGIN, TRACE_APDU_END, tpdu->INS);
+	MetricsTimer timer(METRIC_APDU_TIME);
+	
 	/// Choose case, assemble frame and transmit
 	uint16_t result = 0;
 	switch(exchangeCase)
@@ -79,15 +79,40 @@ class ISO7816
 		ISO7816();
 		
 	private:
-		static void ISO7816_1_Handler();					/// Interrupt handler
 		void Handler();										/// Interrupt handler
 		
-		CircularBuffer* RxBuffer;							/// Receive buffer
-		CircularBuffer* TxBuffer;							/// Transmit buffer
+		enum
+		{
+			RX_SIZE = 64,									///< Receive ring size (power of 2)
+			TX_SIZE = 64,									///< Transmit queue size
+		};
+		
+		volatile uint8_t RxRing[RX_SIZE];					/// Receive ring (written by the interrupt only)
+		volatile uint8_t RxIn;								/// Receive ring input index (interrupt)
+		volatile uint8_t RxOut;								/// Receive ring output index (reader)
+		uint8_t TxStorage[TX_SIZE];							/// Transmit buffer storage
+		CircularBuffer TxBuffer;							/// Transmit buffer
 		uint8_t BackupChar;									/// Char backup
+		uint16_t Fi;										/// Clock rate conversion integer
+		uint16_t Etu;										/// Elementary time unit (card clocks)
+		uint32_t CardClock;									/// Card clock frequency (Hz)
+		uint32_t CharTime;									/// Character time including guard time (us.)
+		uint32_t WaitTime;									/// Work waiting time (us.)
 		
 		bool GetReceivedChar(char* chr);					/// Get received char
+		
+		/**
+		* @brief Get received bytes count
+		* @return bytes count
+		*/
+		uint8_t GetReceivedCount()
+		{
+			return (uint8_t)(RxIn - RxOut);
+		};
+		
 		void Transmit(const void* data, uint16_t count);	/// Transmit data
+		void SetEtu(uint16_t fi, uint16_t etu);				/// Card clock, baudrate and timings tuning
+		static void ClockChanged();							/// System clock change handler
 		uint8_t CalcCK(char* data, uint8_t length);			/// Calculate CK
 };
 
@@ -0,0 +1,74 @@
+/**
+* @file log.cpp
+* @brief Tokenized logging implementation
+*/
+
+#include "log.hpp"
+#include "critical_section.hpp"
+#include "compiler.hpp"
+#include "stm32l1xx.h"                  // Device header
+
+
+uint32_t Log::Words[SIZE];
+uint32_t Log::Head;
+uint32_t Log::Tail;
+uint32_t Log::Lost;
+
+
+/**
+* @brief Message storing
+* @param format - format string (see LOG_FORMAT)
+* @param arguments - arguments pointer
+* @param count - arguments count
+* @note Any context, a few words are copied in the section
+*/
+RAMFUNC void Log::Put(const char* format, const uint32_t* arguments, uint32_t count)
+{
+	CriticalSection section;
+	
+	if(SIZE - (Head - Tail) < count + 1)
+	{
+		Lost++;
+		return;
+	}
+	
+	Words[Head++ & (SIZE - 1)] = (count << 16) | (((uintptr_t)format - FLASH_BASE) & 0xFFFF);
+	for(uint32_t index = 0; index < count; index++)
+	{
+		Words[Head++ & (SIZE - 1)] = arguments[index];
+	}
+}
+
+
+/**
+* @brief Oldest messages reading
+* @param buffer - destination buffer pointer
+* @param count - buffer size (words)
+* @param lost - destination pointer of the messages dropped since the previous reading
+* @return words count, the whole messages only
+* @note Thread mode only
+*/
+uint32_t Log::Read(uint32_t* buffer, uint32_t count, uint16_t* lost)
+{
+	CriticalSection section;
+	
+	*lost = Lost > UINT16_MAX ? UINT16_MAX : (uint16_t)Lost;
+	Lost = 0;
+	
+	uint32_t result = 0;
+	while(Tail != Head)
+	{
+		uint32_t length = (Words[Tail & (SIZE - 1)] >> 16) + 1;
+		if(result + length > count)
+		{
+			break;
+		}
+		
+		for(uint32_t index = 0; index < length; index++)
+		{
+			buffer[result++] = Words[Tail++ & (SIZE - 1)];
+		}
+	}
+	
+	return result;
+}
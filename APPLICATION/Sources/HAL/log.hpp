@@ -0,0 +1,97 @@
+/**
+* @file log.hpp
+* @brief Tokenized logging header
+*/
+
+#ifndef __LOG_HPP
+#define __LOG_HPP
+
+#include "memory_map.h"
+#include "static_assert.hpp"
+#include <stdint.h>
+
+
+/**
+* @brief Log format string definition
+* @param name - format string identifier
+* @param text - printf-like format, the integer conversions only (%u, %d, %x, %X, %c)
+* @note The strings are kept in flash only to be found by the host tool,
+* the firmware never reads them.
+*/
+#define LOG_FORMAT(name, text)	static const char name[] __attribute__((section("LogStrings"), used)) = text
+
+
+/**
+* @brief Tokenized logging class
+* @note A message is stored as its format string flash offset and up to 3 raw
+* arguments, nothing is formatted on the target. The RAM ring is drained
+* by the main loop over the bus (BUS_LOG_READ), Tools/log_decode.py restores
+* the text from the image (.axf). A message, which doesn't fit, is dropped
+* and counted, so the stored ones are never torn.
+*
+* Message words: header ((arguments count << 16) | format offset), arguments.
+* The offset is 16 bits: the firmware region ends at 64 kbytes (see application.sct).
+*/
+class Log
+{
+	public:
+		enum Options_t
+		{
+			SIZE = 64,				///< Ring size (words, power of 2)
+		};
+		
+		static uint32_t Read(uint32_t* buffer, uint32_t count, uint16_t* lost);	/// Oldest messages reading
+		
+		/**
+		* @brief Message logging
+		* @param format - format string (see LOG_FORMAT)
+		*/
+		static void Write(const char* format)
+		{
+			Put(format, 0, 0);
+		};
+		
+		/**
+		* @brief Message logging
+		* @param format - format string (see LOG_FORMAT)
+		* @param a0 - argument
+		*/
+		static void Write(const char* format, uint32_t a0)
+		{
+			Put(format, &a0, 1);
+		};
+		
+		/**
+		* @brief Message logging
+		* @param format - format string (see LOG_FORMAT)
+		* @param a0, a1 - arguments
+		*/
+		static void Write(const char* format, uint32_t a0, uint32_t a1)
+		{
+			uint32_t arguments[2] = {a0, a1};
+			Put(format, arguments, 2);
+		};
+		
+		/**
+		* @brief Message logging
+		* @param format - format string (see LOG_FORMAT)
+		* @param a0, a1, a2 - arguments
+		*/
+		static void Write(const char* format, uint32_t a0, uint32_t a1, uint32_t a2)
+		{
+			uint32_t arguments[3] = {a0, a1, a2};
+			Put(format, arguments, 3);
+		};
+	
+	private:
+		static void Put(const char* format, const uint32_t* arguments, uint32_t count);	/// Message storing
+		
+		static uint32_t Words[SIZE];	///< Messages ring
+		static uint32_t Head;			///< Words written
+		static uint32_t Tail;			///< Words read
+		static uint32_t Lost;			///< Messages dropped since the previous reading
+		
+		STATIC_ASSERT(sizeof(uint32_t) * SIZE + 12 <= LOG_RAM_BUDGET, log_ram_budget);
+};
+
+#endif /* __LOG_HPP */
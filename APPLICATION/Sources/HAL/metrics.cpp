@@ -0,0 +1,60 @@
+/**
+* @file metrics.cpp
+* @brief Runtime metrics implementation
+*/
+
+#include "metrics.hpp"
+#include "bus.hpp"
+#include "memory_map.h"
+#include "static_assert.hpp"
+
+
+/// Upper bound of the histograms first bucket (us.)
+static const uint32_t HISTOGRAM_BASE[METRIC_HISTOGRAMS] = 
+{
+	1000,		///< Tap: 1 ms .. 4 s
+	1000,		///< APDU: 1 ms .. 4 s
+	250,		///< EEPROM commit: 250 us .. 1 s
+};
+
+
+STATIC_ASSERT(sizeof(Metrics::Snapshot_t) <= METRICS_RAM_BUDGET, metrics_ram_budget);
+STATIC_ASSERT(sizeof(Metrics::Snapshot_t) <= Bus::MAX_DATA, metrics_bus_frame);
+
+Metrics::Snapshot_t Metrics::Values;
+
+
+/**
+* @brief Histogram value adding
+* @param histogram - histogram (see MetricHistogram_t)
+* @param value - value (us.)
+* @note Bucket 0 is below the base, bucket N is [base * 4^(N-1), base * 4^N)
+*/
+void Metrics::Observe(uint8_t histogram, uint32_t value)
+{
+	uint32_t scaled = value / HISTOGRAM_BASE[histogram];
+	uint32_t bucket = scaled ? (33 - __CLZ(scaled)) / 2 : 0;
+	if(bucket >= BUCKETS)
+	{
+		bucket = BUCKETS - 1;
+	}
+	
+	Add(&Values.Histograms[histogram][bucket], 1);
+}
+
+
+/**
+* @brief Snapshot reading
+* @param snapshot - destination snapshot pointer
+* @note Each value is read atomically, the snapshot as a whole is not
+*/
+void Metrics::Read(Snapshot_t* snapshot)
+{
+	const volatile uint32_t* source = (const volatile uint32_t *)&Values;
+	uint32_t* destination = (uint32_t *)snapshot;
+	
+	for(uint32_t index = 0; index < sizeof(Snapshot_t) / sizeof(uint32_t); index++)
+	{
+		destination[index] = source[index];
+	}
+}
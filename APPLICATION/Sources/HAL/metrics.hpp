@@ -0,0 +1,139 @@
+/**
+* @file metrics.hpp
+* @brief Runtime metrics header
+*/
+
+#ifndef __METRICS_HPP
+#define __METRICS_HPP
+
+#include "system_timer.hpp"
+#include "stm32l1xx.h"                  // Device header
+#include <stdint.h>
+
+
+/// Counters
+enum MetricCounter_t
+{
+	METRIC_TAPS = 0,				///< Cards served
+	METRIC_ATR_FAILURES,			///< Card activation failures (no or invalid ATR, PPS)
+	METRIC_PPS_MISMATCHES,			///< PPS response differs from the request
+	METRIC_CARD_TIMEOUTS,			///< Card character waiting time exceeded
+	METRIC_CARD_PARITY,				///< Card parity errors (character retransmitted)
+	METRIC_CARD_OVERRUNS,			///< Card characters dropped (receive ring full)
+	METRIC_BUS_CRC_ERRORS,			///< Bus frames with a wrong CRC
+	METRIC_BUS_TIMEOUTS,			///< Incomplete bus frames dropped
+	METRIC_BUS_OVERRUNS,			///< Bus receiver overruns
+	METRIC_EEPROM_COMMITS,			///< Data EEPROM commits
+	METRIC_EEPROM_ERRORS,			///< Data EEPROM programming errors
+	METRIC_COUNTERS,				///< Counters count
+};
+
+/// Gauges (the last value)
+enum MetricGauge_t
+{
+	METRIC_LAST_TAP = 0,			///< Last tap to decision time (us.)
+	METRIC_CARD_ETU,				///< Card elementary time unit (card clocks)
+	METRIC_GAUGES,					///< Gauges count
+};
+
+/// Latency histograms (us.)
+enum MetricHistogram_t
+{
+	METRIC_TAP_TIME = 0,			///< Tap to decision
+	METRIC_APDU_TIME,				///< Command exchange
+	METRIC_EEPROM_BUSY,				///< Data EEPROM commit
+	METRIC_HISTOGRAMS,				///< Histograms count
+};
+
+
+/**
+* @brief Runtime metrics class
+* @note A static registry, the counters and histogram buckets are incremented
+* by LDREX/STREX from any context without masking, a gauge is a single store.
+* Cortex-M3 has no single instruction memory increment, the exclusive
+* access loop is the cheapest lock-free one.
+*/
+class Metrics
+{
+	public:
+		enum Options_t
+		{
+			BUCKETS = 8,		///< Histogram buckets (x4 each, the last is unbounded)
+		};
+		
+		/// Metrics snapshot (see BUS_METRICS_DATA)
+		struct Snapshot_t
+		{
+			uint32_t Counters[METRIC_COUNTERS];				///< Counters
+			uint32_t Gauges[METRIC_GAUGES];					///< Gauges
+			uint32_t Histograms[METRIC_HISTOGRAMS][BUCKETS];	///< Histograms buckets (see Observe())
+		};
+		
+		static void Read(Snapshot_t* snapshot);					/// Snapshot reading
+		static void Observe(uint8_t histogram, uint32_t value);		/// Histogram value adding
+		
+		/**
+		* @brief Counter incrementing
+		* @param counter - counter (see MetricCounter_t)
+		*/
+		static void Count(uint8_t counter)
+		{
+			Add(&Values.Counters[counter], 1);
+		};
+		
+		/**
+		* @brief Gauge setting
+		* @param gauge - gauge (see MetricGauge_t)
+		* @param value - value
+		*/
+		static void Set(uint8_t gauge, uint32_t value)
+		{
+			Values.Gauges[gauge] = value;
+		};
+	
+	private:
+		/**
+		* @brief Atomic adding
+		* @param value - value pointer
+		* @param delta - value to add
+		*/
+		static void Add(uint32_t* value, uint32_t delta)
+		{
+			uint32_t result;
+			do
+			{
+				result = __LDREXW((volatile uint32_t *)value) + delta;
+			}
+			while(__STREXW(result, (volatile uint32_t *)value));
+		};
+		
+		static Snapshot_t Values;	///< Registry
+};
+
+
+/**
+* @brief Timed scope
+* @note Adds the scope duration to the histogram on destruction
+*/
+class MetricsTimer
+{
+	public:
+		/**
+		* @brief Timing start
+		* @param histogram - histogram (see MetricHistogram_t)
+		*/
+		explicit MetricsTimer(uint8_t histogram) : Histogram(histogram), Start(SystemTimer::GetMicros())
+		{
+		};
+		
+		~MetricsTimer()
+		{
+			Metrics::Observe(Histogram, (uint32_t)(SystemTimer::GetMicros() - Start));
+		};
+	
+	private:
+		uint8_t Histogram;		///< Histogram
+		uint64_t Start;			///< Start time (us.)
+};
+
+#endif /* __METRICS_HPP */
@@ -0,0 +1,154 @@
+/**
+* @file power.cpp
+* @brief Power management implementation
+*/
+
+#include "power.hpp"
+#include "rtc.hpp"
+#include "clock.hpp"
+#include "core.hpp"
+#include "stack.hpp"
+#include "stm32l1xx.h"                  // Device header
+
+
+uint32_t Power::WakeLatency;
+uint32_t Power::MaxWakeLatency;
+uint32_t Power::StopCount;
+
+
+/**
+* @brief Power management initialization
+* @note PA10 (USART1 RX) stays in the alternate function mode, EXTI still sees its level
+*/
+void Power::Init()
+{
+	/// PA10 - RS485 RX start bit, EXTI10 on falling edge (unmasked in STOP mode only)
+	SYSCFG->EXTICR[2] &= ~SYSCFG_EXTICR3_EXTI10;
+	EXTI->FTSR |= EXTI_FTSR_TR10;
+	EXTI->IMR &= ~EXTI_IMR_MR10;
+	EXTI->PR = EXTI_PR_PR10;
+	Core::RegIrqHandler(EXTI15_10_IRQn, Power::RxWakeup_Handler, IRQ_PRIORITY_EXTI);
+	
+	/// Keep the debugger connected in STOP mode
+#ifdef __DEBUG__
+	DBGMCU->CR |= DBGMCU_CR_DBG_STOP;
+#endif
+	
+	WakeLatency = 0;
+	MaxWakeLatency = 0;
+	StopCount = 0;
+}
+
+
+/**
+* @brief STOP mode
+* @param timeout - max STOP mode time (us.)
+* @return estimated STOP mode time (us.)
+* @note Must be called with interrupts masked: a wakeup interrupt stays pending
+* and runs after the caller unmasks interrupts, when the clocks are restored.
+* The time asleep is counted in the wakeup timer ticks (the calendar has 1 s.
+* resolution only): the core wakes up on each tick from MSI, counts it and goes
+* back to STOP mode, the clocks are restored on the last tick or another wakeup.
+* The last tick cut by another wakeup is counted by half. The bus receiver
+* is off until the clocks are restored, it would take garbage at MSI.
+*/
+uint32_t Power::Stop(uint32_t timeout)
+{
+	uint32_t tick = Rtc::SetWakeup(timeout < STOP_TICK ? timeout : (uint32_t)STOP_TICK);
+	EXTI->PR = EXTI_PR_PR10;
+	EXTI->IMR |= EXTI_IMR_MR10;
+	USART1->CR1 &= ~USART_CR1_RE;
+	
+	/// Low-power regulator, STOP (not STANDBY) on deep sleep
+	PWR->CR |= PWR_CR_LPSDSR | PWR_CR_CWUF;
+	PWR->CR &= ~PWR_CR_PDDS;
+	SCB->SCR |= SCB_SCR_SLEEPDEEP_Msk;
+	
+	uint32_t slept = 0;
+	for(;;)
+	{
+		__WFI();
+		
+		if(!Rtc::AcknowledgeWakeup())
+		{
+			slept += tick / 2;
+			break;
+		}
+		slept += tick;
+		
+		/// Another interrupt is pending or the next tick would pass the timeout
+		if((SCB->ICSR & SCB_ICSR_ISRPENDING_Msk) || (slept + tick > timeout))
+		{
+			break;
+		}
+	}
+	
+	/// The core runs from MSI here, the cycle counter stamps the wakeup
+	/// (it is shared with the trace and the work queue stamps, so it is not cleared)
+	uint32_t wake = DWT->CYCCNT;
+	SCB->SCR &= ~SCB_SCR_SLEEPDEEP_Msk;
+	Clock::Restore();
+	uint32_t restored = DWT->CYCCNT;
+	USART1->CR1 |= USART_CR1_RE;
+	
+	/// The EXTI15_10 interrupt stays pending until the caller unmasks interrupts
+	EXTI->IMR &= ~EXTI_IMR_MR10;
+	if(EXTI->PR & EXTI_PR_PR10)
+	{
+		MeasureLatency(wake, restored);
+	}
+	
+	Rtc::CancelWakeup();
+	Rtc::Synchronize();
+	StopCount++;
+	
+	return slept < timeout ? slept : timeout;
+}
+
+
+/**
+* @brief First bus byte latency measuring
+* @param wake - cycle counter at the wakeup
+* @param restored - cycle counter, when the clocks are restored
+* @note The receive DMA counter is polled for BYTE_TIMEOUT at most (the start bit
+* may be a noise). The cycles until the restoring run at MSI, the ones after it
+* at the profile clock, each part is converted to us. by its own frequency.
+*/
+void Power::MeasureLatency(uint32_t wake, uint32_t restored)
+{
+	uint32_t frequency = Clock::GetFrequency();
+	uint32_t limit = (frequency / 1000000) * BYTE_TIMEOUT;
+	
+	/// USART1 RX DMA channel (see Uart)
+	uint32_t remain = DMA1_Channel5->CNDTR;
+	uint32_t cycles;
+	do
+	{
+		cycles = DWT->CYCCNT - restored;
+		if(cycles > limit)
+		{
+			return;
+		}
+	}
+	while(DMA1_Channel5->CNDTR == remain);
+	
+	WakeLatency = (uint32_t)(((uint64_t)(restored - wake) * 1000000) / MSI_FREQUENCY + 
+		((uint64_t)cycles * 1000000) / frequency);
+	if(WakeLatency > MaxWakeLatency)
+	{
+		MaxWakeLatency = WakeLatency;
+	}
+}
+
+
+/**
+* @brief EXTI15_10 interrupt handler
+* @note Only wakes the core up, the received data are taken by DMA
+*/
+void Power::RxWakeup_Handler()
+{
+	IsrGuard guard;
+	
+	EXTI->IMR &= ~EXTI_IMR_MR10;
+	EXTI->PR = EXTI_PR_PR10;
+}
@@ -0,0 +1,70 @@
+/**
+* @file power.hpp
+* @brief Power management header
+*/
+
+#ifndef __POWER_HPP
+#define __POWER_HPP
+
+#include <stdint.h>
+
+
+/**
+* @brief Power management class
+* @note STOP mode keeps SRAM, registers and the RTC, all the other clocks stop.
+* The core wakes up on the RS485 RX start bit (EXTI line 10), the card detect
+* input (EXTI line 0) or the RTC wakeup timer, runs from MSI and restarts
+* the clock profile source. Bus bytes arriving until it is ready are lost,
+* the bus frames start with a preamble for it (see Bus). After an RS485 wakeup
+* the latency to the first received byte is measured.
+*/
+class Power
+{
+	public:
+		enum Options_t
+		{
+			MSI_FREQUENCY = 2097000,	///< Clock after STOP mode (MSI range 5) (Hz)
+			STOP_TICK = 31250,			///< Wakeup timer tick in STOP mode, the time asleep resolution (us.)
+			BYTE_TIMEOUT = 1000,		///< Max first bus byte waiting after an RS485 wakeup (us.)
+		};
+		
+		static void Init();							/// Power management initialization
+		static uint32_t Stop(uint32_t timeout);		/// STOP mode (us.)
+		
+		/**
+		* @brief Get the last RS485 wakeup to first bus byte latency
+		* @return latency (us.)
+		*/
+		static uint32_t GetWakeLatency()
+		{
+			return WakeLatency;
+		};
+		
+		/**
+		* @brief Get the max RS485 wakeup to first bus byte latency
+		* @return latency (us.)
+		*/
+		static uint32_t GetMaxWakeLatency()
+		{
+			return MaxWakeLatency;
+		};
+		
+		/**
+		* @brief Get STOP mode entries count
+		* @return entries count
+		*/
+		static uint32_t GetStopCount()
+		{
+			return StopCount;
+		};
+	
+	private:
+		static void MeasureLatency(uint32_t wake, uint32_t restored);	/// First bus byte latency measuring
+		static void RxWakeup_Handler();				/// EXTI15_10 interrupt handler
+		
+		static uint32_t WakeLatency;				///< Last wake latency (us.)
+		static uint32_t MaxWakeLatency;				///< Max wake latency (us.)
+		static uint32_t StopCount;					///< STOP mode entries count
+};
+
+#endif /* __POWER_HPP */
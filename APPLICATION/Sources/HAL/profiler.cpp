@@ -0,0 +1,224 @@
+/**
+* @file profiler.cpp
+* @brief Sampling profiler implementation
+*/
+
+#include "profiler.hpp"
+#include "clock.hpp"
+#include "core.hpp"
+#include "critical_section.hpp"
+#include "stack.hpp"
+#include "stm32l1xx.h"                  // Device header
+#include <string.h>
+
+
+/// Firmware code bounds (see application.sct)
+extern char Image$$ER_IROM2$$Base[];
+extern char Image$$ER_IROM2$$Limit[];
+
+
+uint16_t Profiler::Buckets[BUCKETS];
+uint32_t Profiler::FlashBase;
+uint32_t Profiler::FlashSize;
+uint8_t Profiler::FlashShift;
+uint32_t Profiler::Samples;
+uint32_t Profiler::Other;
+uint32_t Profiler::Rate;
+
+
+/**
+* @brief Profiler initialization
+* @note Sampling is stopped until Start()
+*/
+void Profiler::Init()
+{
+	Clock::Subscribe(CLOCK_LISTENER_PROFILER, Profiler::ClockChanged);
+}
+
+
+/**
+* @brief Sampling start
+* @param rate - sampling rate (Hz)
+* @return true, if the rate is valid
+* @note The histogram is cleared, the bucket size fits the image into FLASH_BUCKETS
+*/
+bool Profiler::Start(uint32_t rate)
+{
+	if(!IsRateValid(rate))
+	{
+		return false;
+	}
+	
+	Stop();
+	
+	FlashBase = (uint32_t)Image$$ER_IROM2$$Base;
+	FlashSize = (uint32_t)Image$$ER_IROM2$$Limit - FlashBase;
+	FlashShift = 0;
+	while((FlashSize >> FlashShift) >= FLASH_BUCKETS)
+	{
+		FlashShift++;
+	}
+	
+	memset(Buckets, 0, sizeof(Buckets));
+	Samples = 0;
+	Other = 0;
+	
+	Rate = rate;
+	SetPeriod();
+	Core::RegIrqHandler(SysTick_IRQn, Profiler::SysTick_Handler, IRQ_PRIORITY_PROFILER);
+	
+	return true;
+}
+
+
+/**
+* @brief Sampling stop
+*/
+void Profiler::Stop()
+{
+	SysTick->CTRL = 0;
+	Rate = 0;
+}
+
+
+/**
+* @brief Histogram page reading
+* @param first - first bucket
+* @param header - destination page header pointer
+* @param buffer - destination bucket counters pointer
+* @param count - buffer size (buckets)
+* @return buckets count
+*/
+uint32_t Profiler::Read(uint32_t first, ProfileHeader_t* header, uint16_t* buffer, uint32_t count)
+{
+	if(first > BUCKETS)
+	{
+		first = BUCKETS;
+	}
+	if(count > BUCKETS - first)
+	{
+		count = BUCKETS - first;
+	}
+	
+	PriorityLock lock(IRQ_PRIORITY_PROFILER);
+	
+	header->FlashBase = FlashBase;
+	header->RamBase = MAP_RAM_CODE_BASE;
+	header->Samples = Samples;
+	header->Other = Other;
+	header->FlashShift = FlashShift;
+	header->RamShift = RAM_SHIFT;
+	header->First = first;
+	header->Count = count;
+	memcpy(buffer, &Buckets[first], count * sizeof(uint16_t));
+	
+	return count;
+}
+
+
+/**
+* @brief SysTick interrupt handler
+* @note The stacked PC is the 7th word of the exception frame, on the stack
+* the interrupted code used. Sample() returns from the exception.
+*/
+#if defined(__CC_ARM)
+__asm void Profiler::SysTick_Handler()
+{
+	TST		LR, #4
+	ITE		EQ
+	MRSEQ	R0, MSP
+	MRSNE	R0, PSP
+	LDR		R0, [R0, #24]
+	B		__cpp(Profiler::Sample)
+}
+#else
+__attribute__((naked)) void Profiler::SysTick_Handler()
+{
+	__asm volatile(
+		"tst lr, #4			\n"
+		"ite eq				\n"
+		"mrseq r0, msp		\n"
+		"mrsne r0, psp		\n"
+		"ldr r0, [r0, #24]	\n"
+		"b %c0				\n"
+		: : "i" (Profiler::Sample));
+}
+#endif
+
+
+/**
+* @brief PC counting
+* @param pc - interrupted code address
+*/
+void Profiler::Sample(uint32_t pc)
+{
+	IsrGuard guard;
+	
+	Samples++;
+	
+	uint32_t bucket;
+	if(pc - FlashBase < FlashSize)
+	{
+		bucket = (pc - FlashBase) >> FlashShift;
+	}
+	else if(pc - MAP_RAM_CODE_BASE < MAP_RAM_CODE_SIZE)
+	{
+		bucket = FLASH_BUCKETS + ((pc - MAP_RAM_CODE_BASE) >> RAM_SHIFT);
+	}
+	else
+	{
+		Other++;
+		return;
+	}
+	
+	if(Buckets[bucket] < UINT16_MAX)
+	{
+		Buckets[bucket]++;
+	}
+}
+
+
+/**
+* @brief System clock change handler
+* @note The sampling rate is kept, the sampling stops, if the period doesn't fit the new clock
+*/
+void Profiler::ClockChanged()
+{
+	if(!Rate)
+	{
+		return;
+	}
+	
+	if(IsRateValid(Rate))
+	{
+		SetPeriod();
+	}
+	else
+	{
+		Stop();
+	}
+}
+
+
+/**
+* @brief Check, whether the rate is supported at the current clock
+* @param rate - sampling rate (Hz)
+* @return true, if the period fits the 24-bit SysTick reload
+*/
+bool Profiler::IsRateValid(uint32_t rate)
+{
+	uint32_t minRate = (Clock::GetFrequency() + SysTick_LOAD_RELOAD_Msk) >> 24;
+	return (rate >= minRate) && (rate <= MAX_RATE);
+}
+
+
+/**
+* @brief Sampling period setting
+*/
+void Profiler::SetPeriod()
+{
+	SysTick->CTRL = 0;
+	SysTick->LOAD = Clock::GetFrequency() / Rate - 1;
+	SysTick->VAL = 0;
+	SysTick->CTRL = SysTick_CTRL_CLKSOURCE_Msk | SysTick_CTRL_TICKINT_Msk | SysTick_CTRL_ENABLE_Msk;
+}
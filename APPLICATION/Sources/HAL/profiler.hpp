@@ -0,0 +1,75 @@
+/**
+* @file profiler.hpp
+* @brief Sampling profiler header
+*/
+
+#ifndef __PROFILER_HPP
+#define __PROFILER_HPP
+
+#include "memory_map.h"
+#include "static_assert.hpp"
+#include <stdint.h>
+
+
+/// Histogram page header (see BUS_PROFILE_DATA)
+struct ProfileHeader_t
+{
+	uint32_t FlashBase;		///< Address of the flash bucket 0
+	uint32_t RamBase;		///< Address of the RAM code bucket 0 (bucket FLASH_BUCKETS)
+	uint32_t Samples;		///< Samples taken
+	uint32_t Other;			///< Samples outside the code regions
+	uint8_t FlashShift;		///< Flash bucket size (log2 bytes)
+	uint8_t RamShift;		///< RAM code bucket size (log2 bytes)
+	uint8_t First;			///< First bucket of the page
+	uint8_t Count;			///< Buckets in the page
+};
+
+
+/**
+* @brief Sampling profiler class
+* @note SysTick interrupts at the sampling rate, the handler takes the PC
+* of the interrupted code from the exception frame and counts it in the
+* histogram bucket. The flash buckets cover the firmware code (their size
+* follows the image size), the RAM code has its own buckets. The interrupt
+* priority is below the smartcard only, so the other handlers are sampled too.
+* STOP mode stops SysTick, the time in STOP is not sampled.
+* Tools/profile_report.py symbolizes the histogram against the linker map.
+*/
+class Profiler
+{
+	public:
+		enum Options_t
+		{
+			FLASH_BUCKETS = 240,							///< Flash code buckets
+			RAM_BUCKETS = 16,								///< RAM code buckets
+			BUCKETS = FLASH_BUCKETS + RAM_BUCKETS,			///< Histogram size
+			RAM_SHIFT = 6,									///< RAM code bucket size (log2 bytes)
+			MAX_RATE = 10000,								///< Max sampling rate (Hz)
+		};
+		
+		static void Init();						/// Profiler initialization
+		static bool Start(uint32_t rate);		/// Sampling start (the histogram is cleared)
+		static void Stop();						/// Sampling stop
+		static uint32_t Read(uint32_t first, ProfileHeader_t* header, uint16_t* buffer, uint32_t count);	/// Histogram page reading
+	
+	private:
+		static void SysTick_Handler();			/// SysTick interrupt handler (stacked PC fetching)
+		static void Sample(uint32_t pc);		/// PC counting
+		static void ClockChanged();				/// System clock change handler
+		static bool IsRateValid(uint32_t rate);	/// Check, whether the rate is supported at the current clock
+		static void SetPeriod();				/// Sampling period setting
+		
+		static uint16_t Buckets[BUCKETS];		///< PC histogram (saturated)
+		static uint32_t FlashBase;				///< Firmware code start
+		static uint32_t FlashSize;				///< Firmware code size
+		static uint8_t FlashShift;				///< Flash bucket size (log2 bytes)
+		static uint32_t Samples;				///< Samples taken
+		static uint32_t Other;					///< Samples outside the code regions
+		static uint32_t Rate;					///< Sampling rate (Hz), 0 - stopped
+		
+		STATIC_ASSERT(sizeof(ProfileHeader_t) == 20, profile_header_size);
+		STATIC_ASSERT((MAP_RAM_CODE_SIZE >> RAM_SHIFT) <= RAM_BUCKETS, profiler_ram_buckets);
+		STATIC_ASSERT(sizeof(uint16_t) * BUCKETS + 24 <= PROFILER_RAM_BUDGET, profiler_ram_budget);
+};
+
+#endif /* __PROFILER_HPP */
@@ -0,0 +1,143 @@
+/**
+* @file retained.cpp
+* @brief Retained (no-init) RAM implementation
+*/
+
+#include "retained.hpp"
+#include "system_timer.hpp"
+#include "rtc.hpp"
+#include "crc.hpp"
+#include "log.hpp"
+#include "memory_map.h"
+#include "static_assert.hpp"
+#include "stm32l1xx.h"                  // Device header
+
+
+/// Module options
+enum Options_t
+{
+	RETAINED_MAGIC = 0x31544552,	///< Format signature ("RET1")
+};
+
+
+/// The owners budgets fit the no-init region
+STATIC_ASSERT(CACHE_RAM_BUDGET + JOURNAL_RAM_BUDGET + RETAINED_RAM_BUDGET <= MAP_NOINIT_SIZE, noinit_ram_budget);
+
+
+/// No-init region bounds (see application.sct)
+extern char Image$$RW_IRAM_NOINIT$$ZI$$Base[];
+extern char Image$$RW_IRAM_NOINIT$$ZI$$Limit[];
+
+
+/// Log messages
+LOG_FORMAT(LogReset, "reset, reason %u, count %u, restored %u");
+
+
+Retained::State_t Retained::State RETAINED;
+uint16_t Retained::Checksum RETAINED;
+bool Retained::Restored;
+
+
+/**
+* @brief Region validation
+* @return true, if the retained state is restored
+* @note Called after SystemTimer and Rtc initialization, before TimerService
+* (the time is resumed) and the owners initialization.
+* The power-on reset starts cold regardless of the CRC.
+*/
+bool Retained::Init()
+{
+	uint8_t reason = GetReason(RCC->CSR);
+	RCC->CSR |= RCC_CSR_RMVF;
+	
+	Restored = (reason != RESET_POWER) && (State.Magic == RETAINED_MAGIC) && (Calc() == Checksum);
+	
+	if(Restored)
+	{
+		/// Resume the monotonic time
+		uint32_t time = Rtc::GetTime();
+		uint64_t micros = State.Micros + (uint64_t)(time > State.Time ? time - State.Time : 0) * 1000000;
+		uint64_t now = SystemTimer::GetMicros();
+		if(micros > now)
+		{
+			SystemTimer::Skip(micros - now);
+		}
+		
+		State.ResetCount++;
+	}
+	else
+	{
+		State.Magic = RETAINED_MAGIC;
+		State.ResetCount = 0;
+	}
+	
+	State.ResetReason = reason;
+	Seal();
+	
+	Log::Write(LogReset, reason, State.ResetCount, Restored);
+	
+	return Restored;
+}
+
+
+/**
+* @brief Reset reason decoding
+* @param flags - RCC_CSR value
+* @return reason (see ResetReason_t)
+* @note The internal resets pull NRST as well, so the pin flag is checked last
+*/
+uint8_t Retained::GetReason(uint32_t flags)
+{
+	if(flags & RCC_CSR_PORRSTF)
+	{
+		return RESET_POWER;
+	}
+	if(flags & RCC_CSR_IWDGRSTF)
+	{
+		return RESET_IWDG;
+	}
+	if(flags & RCC_CSR_WWDGRSTF)
+	{
+		return RESET_WWDG;
+	}
+	if(flags & RCC_CSR_SFTRSTF)
+	{
+		return RESET_SOFTWARE;
+	}
+	if(flags & RCC_CSR_LPWRRSTF)
+	{
+		return RESET_LOW_POWER;
+	}
+	if(flags & RCC_CSR_OBLRSTF)
+	{
+		return RESET_OPTION_BYTES;
+	}
+	return RESET_PIN;
+}
+
+
+/**
+* @brief Region CRC calculation
+* @return CRC16 of the region except the CRC itself
+*/
+uint16_t Retained::Calc()
+{
+	char* base = Image$$RW_IRAM_NOINIT$$ZI$$Base;
+	char* limit = Image$$RW_IRAM_NOINIT$$ZI$$Limit;
+	char* checksum = (char *)&Checksum;
+	
+	uint16_t result = Crc::Calc16(base, checksum - base, 0);
+	return Crc::Calc16(checksum + sizeof(Checksum), limit - (checksum + sizeof(Checksum)), result);
+}
+
+
+/**
+* @brief CRC updating
+* @note Called by the owners after each complete change of the retained variables
+*/
+void Retained::Seal()
+{
+	State.Micros = SystemTimer::GetMicros();
+	State.Time = Rtc::GetTime();
+	Checksum = Calc();
+}
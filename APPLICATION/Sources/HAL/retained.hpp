@@ -0,0 +1,98 @@
+/**
+* @file retained.hpp
+* @brief Retained (no-init) RAM header
+*/
+
+#ifndef __RETAINED_HPP
+#define __RETAINED_HPP
+
+#include "memory_map.h"
+#include "static_assert.hpp"
+#include <stdint.h>
+
+
+/// Variable placement into the no-init RAM (kept across resets, see application.sct)
+#if defined(__CC_ARM)
+#define RETAINED __attribute__((section("NoInit"), zero_init))
+#else
+#define RETAINED __attribute__((section("NoInit")))
+#endif
+
+
+/// Reset reasons
+enum ResetReason_t
+{
+	RESET_POWER = 0,		///< Power-on (or brownout)
+	RESET_PIN,				///< NRST pin
+	RESET_SOFTWARE,			///< NVIC_SystemReset()
+	RESET_IWDG,				///< Independent watchdog
+	RESET_WWDG,				///< Window watchdog
+	RESET_LOW_POWER,		///< Illegal STOP/STANDBY entry
+	RESET_OPTION_BYTES,		///< Option bytes loading
+};
+
+
+/**
+* @brief Retained RAM class
+* @note The no-init region is not touched by the startup code, so the variables
+* placed by RETAINED keep their values across a warm reset. The whole region is
+* guarded by CRC16, which the owners recompute by Seal() after each complete
+* change. A reset during the change breaks the CRC and the owners start cold.
+* The monotonic time (see SystemTimer) resumes from the last sealing plus
+* the RTC time elapsed, so the decision cache TTLs survive as well.
+*/
+class Retained
+{
+	public:
+		static bool Init();				/// Region validation (after SystemTimer and Rtc)
+		static void Seal();				/// CRC updating
+		
+		/**
+		* @brief Check, whether the retained state was restored
+		* @return true, if the region was valid at boot
+		*/
+		static bool IsRestored()
+		{
+			return Restored;
+		};
+		
+		/**
+		* @brief Get the last reset reason
+		* @return reason (see ResetReason_t)
+		*/
+		static uint8_t GetResetReason()
+		{
+			return State.ResetReason;
+		};
+		
+		/**
+		* @brief Get warm resets count since the last cold start
+		* @return resets count
+		*/
+		static uint32_t GetResetCount()
+		{
+			return State.ResetCount;
+		};
+	
+	private:
+		/// Region own state
+		struct State_t
+		{
+			uint32_t Magic;			///< Format signature
+			uint32_t ResetCount;	///< Warm resets count
+			uint64_t Micros;		///< Monotonic time of the last sealing (us.)
+			uint32_t Time;			///< RTC time of the last sealing (s.)
+			uint8_t ResetReason;	///< Last reset reason (see ResetReason_t)
+		};
+		
+		static uint8_t GetReason(uint32_t flags);	/// Reset reason decoding
+		static uint16_t Calc();						/// Region CRC calculation
+		
+		static State_t State;		///< Region own state (retained)
+		static uint16_t Checksum;	///< Region CRC (retained)
+		static bool Restored;		///< Region was valid at boot
+		
+		STATIC_ASSERT(sizeof(State_t) + sizeof(uint16_t) + 1 <= RETAINED_RAM_BUDGET, retained_ram_budget);
+};
+
+#endif /* __RETAINED_HPP */
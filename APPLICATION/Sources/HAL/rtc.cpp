@@ -0,0 +1,293 @@
+/**
+* @file rtc.cpp
+* @brief Real-time clock implementation
+*/
+
+#include "rtc.hpp"
+#include "core.hpp"
+#include "stack.hpp"
+#include "stm32l1xx.h"                  // Device header
+
+
+/// Module options
+enum Options_t
+{
+	RTC_PREDIV_A = 127,			///< Asynchronous prescaler (LSI ~37 kHz)
+	RTC_PREDIV_S = 288,			///< Synchronous prescaler (37000 / 128 / 289 = 1 Hz)
+	RTC_SECONDS_PER_DAY = 86400,	///< Seconds per day
+	RTC_LSI_FREQUENCY = 37000,		///< LSI nominal frequency (Hz)
+	RTC_WAKEUP_DIVIDER = 16,		///< Wakeup timer clock divider (WUCKSEL = 000)
+	RTC_WAKEUP_MAX = 0x10000,		///< Max wakeup timer period (ticks)
+};
+
+
+bool Rtc::Started;
+
+
+/// Days before month (non-leap year)
+const uint16_t RTC_DAYS_BEFORE_MONTH[] = 
+{
+	0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334,
+};
+
+
+/**
+* @brief Real-time clock initialization
+* @note LSI is awaited on the first calendar or wakeup timer access,
+* so the boot (and the first card served) doesn't wait for it
+*/
+void Rtc::Init()
+{
+	Started = false;
+}
+
+
+/**
+* @brief Calendar starting on the first access
+* @note The calendar is kept across resets, it is only set if it has never been initialized
+*/
+void Rtc::Start()
+{
+	if(Started)
+	{
+		return;
+	}
+	Started = true;
+	
+	/// The startup code doesn't wait for LSI
+	while(!(RCC->CSR & RCC_CSR_LSIRDY));
+	
+	if(!(RTC->ISR & RTC_ISR_INITS))
+	{
+		SetTime(0);
+		return;
+	}
+	
+	Synchronize();
+}
+
+
+/**
+* @brief Calendar shadow registers synchronization
+* @note Required after reset and after STOP mode, before the calendar reading
+*/
+void Rtc::Synchronize()
+{
+	Start();
+	
+	PWR->CR |= PWR_CR_DBP;
+	RTC->WPR = 0xCA;
+	RTC->WPR = 0x53;
+	RTC->ISR &= ~RTC_ISR_RSF;
+	RTC->WPR = 0xFF;
+	PWR->CR &= ~PWR_CR_DBP;
+	while(!(RTC->ISR & RTC_ISR_RSF));
+}
+
+
+/**
+* @brief Wakeup timer starting
+* @param period - wakeup period (us., up to ~28 s.)
+* @return period set (us., whole timer ticks)
+* @note Accuracy is the one of LSI
+*/
+uint32_t Rtc::SetWakeup(uint32_t period)
+{
+	uint32_t ticks = (uint32_t)(((uint64_t)period * RTC_LSI_FREQUENCY) / (RTC_WAKEUP_DIVIDER * 1000000));
+	if(ticks < 1)
+	{
+		ticks = 1;
+	}
+	if(ticks > RTC_WAKEUP_MAX)
+	{
+		ticks = RTC_WAKEUP_MAX;
+	}
+	
+	Start();
+	
+	PWR->CR |= PWR_CR_DBP;
+	RTC->WPR = 0xCA;
+	RTC->WPR = 0x53;
+	
+	/// Stop the timer, wait for the reload register access
+	RTC->CR &= ~(RTC_CR_WUTE | RTC_CR_WUTIE);
+	while(!(RTC->ISR & RTC_ISR_WUTWF));
+	
+	RTC->WUTR = ticks - 1;
+	RTC->CR &= ~RTC_CR_WUCKSEL;
+	RTC->ISR &= ~RTC_ISR_WUTF;
+	RTC->CR |= RTC_CR_WUTIE | RTC_CR_WUTE;
+	
+	RTC->WPR = 0xFF;
+	PWR->CR &= ~PWR_CR_DBP;
+	
+	/// Wakeup timer event is routed to the core through EXTI line 20 (rising edge)
+	EXTI->PR = EXTI_PR_PR20;
+	EXTI->RTSR |= EXTI_RTSR_TR20;
+	EXTI->IMR |= EXTI_IMR_MR20;
+	Core::RegIrqHandler(RTC_WKUP_IRQn, Rtc::Wakeup_Handler, IRQ_PRIORITY_EXTI);
+	
+	return (uint32_t)(((uint64_t)ticks * RTC_WAKEUP_DIVIDER * 1000000) / RTC_LSI_FREQUENCY);
+}
+
+
+/**
+* @brief Wakeup timer period acknowledgement
+* @return true, if a period has elapsed (the timer goes on)
+*/
+bool Rtc::AcknowledgeWakeup()
+{
+	if(!(RTC->ISR & RTC_ISR_WUTF))
+	{
+		return false;
+	}
+	
+	PWR->CR |= PWR_CR_DBP;
+	RTC->ISR &= ~RTC_ISR_WUTF;
+	PWR->CR &= ~PWR_CR_DBP;
+	
+	EXTI->PR = EXTI_PR_PR20;
+	NVIC_ClearPendingIRQ(RTC_WKUP_IRQn);
+	return true;
+}
+
+
+/**
+* @brief Wakeup timer stopping
+* @return true, if the timer has elapsed
+*/
+bool Rtc::CancelWakeup()
+{
+	bool elapsed = (RTC->ISR & RTC_ISR_WUTF) != 0;
+	
+	PWR->CR |= PWR_CR_DBP;
+	RTC->WPR = 0xCA;
+	RTC->WPR = 0x53;
+	RTC->CR &= ~(RTC_CR_WUTE | RTC_CR_WUTIE);
+	RTC->ISR &= ~RTC_ISR_WUTF;
+	RTC->WPR = 0xFF;
+	PWR->CR &= ~PWR_CR_DBP;
+	
+	EXTI->IMR &= ~EXTI_IMR_MR20;
+	EXTI->PR = EXTI_PR_PR20;
+	NVIC_ClearPendingIRQ(RTC_WKUP_IRQn);
+	
+	return elapsed;
+}
+
+
+/**
+* @brief Wakeup timer interrupt handler
+* @note Only wakes the core up, the flags are cleared by AcknowledgeWakeup() or CancelWakeup()
+*/
+void Rtc::Wakeup_Handler()
+{
+	IsrGuard guard;
+	
+	EXTI->IMR &= ~EXTI_IMR_MR20;
+	EXTI->PR = EXTI_PR_PR20;
+}
+
+
+/**
+* @brief Get current time
+* @return seconds since 2000-01-01 00:00:00
+*/
+uint32_t Rtc::GetTime()
+{
+	Start();
+	
+	/// TR read locks DR until it is read
+	uint32_t tr = RTC->TR;
+	uint32_t dr = RTC->DR;
+	
+	uint32_t year = FromBcd(dr >> 16);
+	uint32_t month = FromBcd((dr >> 8) & 0x1F);
+	uint32_t day = FromBcd(dr & 0x3F);
+	
+	uint32_t days = year * 365 + (year + 3) / 4 + RTC_DAYS_BEFORE_MONTH[(month - 1) % 12] + day - 1;
+	if(((year % 4) == 0) && (month > 2))
+	{
+		days++;
+	}
+	
+	return days * RTC_SECONDS_PER_DAY + 
+		FromBcd((tr >> 16) & 0x3F) * 3600 + 
+		FromBcd((tr >> 8) & 0x7F) * 60 + 
+		FromBcd(tr & 0x7F);
+}
+
+
+/**
+* @brief Set current time
+* @param time - seconds since 2000-01-01 00:00:00
+*/
+void Rtc::SetTime(uint32_t time)
+{
+	Start();
+	
+	uint32_t days = time / RTC_SECONDS_PER_DAY;
+	uint32_t seconds = time % RTC_SECONDS_PER_DAY;
+	
+	/// Split days into year, month and day
+	uint32_t year = 0;
+	while(days >= (uint32_t)(((year % 4) == 0) ? 366 : 365))
+	{
+		days -= ((year % 4) == 0) ? 366 : 365;
+		year++;
+	}
+	
+	uint32_t month = 12;
+	while(days < (uint32_t)(RTC_DAYS_BEFORE_MONTH[month - 1] + ((((year % 4) == 0) && (month > 2)) ? 1 : 0)))
+	{
+		month--;
+	}
+	uint32_t day = days - RTC_DAYS_BEFORE_MONTH[month - 1] - ((((year % 4) == 0) && (month > 2)) ? 1 : 0) + 1;
+	
+	/// Allow RTC registers writing
+	PWR->CR |= PWR_CR_DBP;
+	RTC->WPR = 0xCA;
+	RTC->WPR = 0x53;
+	
+	/// Enter initialization mode
+	RTC->ISR |= RTC_ISR_INIT;
+	while(!(RTC->ISR & RTC_ISR_INITF));
+	
+	/// Tune prescalers (1 Hz calendar clock)
+	RTC->PRER = RTC_PREDIV_S;
+	RTC->PRER |= RTC_PREDIV_A << 16;
+	
+	/// Set time (24-hour format) and date (weekday is not used)
+	RTC->TR = (ToBcd(seconds / 3600) << 16) | (ToBcd((seconds / 60) % 60) << 8) | ToBcd(seconds % 60);
+	RTC->DR = (ToBcd(year) << 16) | (1 << 13) | (ToBcd(month) << 8) | ToBcd(day);
+	RTC->CR &= ~RTC_CR_FMT;
+	
+	/// Exit initialization mode
+	RTC->ISR &= ~RTC_ISR_INIT;
+	
+	/// Cancel RTC registers writing
+	RTC->WPR = 0xFF;
+	PWR->CR &= ~PWR_CR_DBP;
+}
+
+
+/**
+* @brief Binary to BCD conversion
+* @param value - binary value (0...99)
+* @return BCD value
+*/
+uint8_t Rtc::ToBcd(uint32_t value)
+{
+	return ((value / 10) << 4) | (value % 10);
+}
+
+
+/**
+* @brief BCD to binary conversion
+* @param value - BCD value
+* @return binary value
+*/
+uint32_t Rtc::FromBcd(uint8_t value)
+{
+	return (value >> 4) * 10 + (value & 0x0F);
+}
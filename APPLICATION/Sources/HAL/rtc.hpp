@@ -0,0 +1,38 @@
+/**
+* @file rtc.hpp
+* @brief Real-time clock header
+*/
+
+#ifndef __RTC_HPP
+#define __RTC_HPP
+
+#include <stdint.h>
+
+/**
+* @brief Real-time clock class
+* @note Time is counted in seconds since 2000-01-01 00:00:00.
+* The wakeup timer (RTCCLK / 16, EXTI line 20) brings the core out of STOP mode
+* periodically, until it is cancelled.
+*/
+class Rtc
+{
+	public:
+		static void Init();					/// Real-time clock initialization
+		static uint32_t GetTime();			/// Get current time (s.)
+		static void SetTime(uint32_t time);	/// Set current time (s.)
+		static void Synchronize();			/// Calendar shadow registers synchronization
+		static uint32_t SetWakeup(uint32_t period);	/// Wakeup timer starting (us.)
+		static bool AcknowledgeWakeup();	/// Wakeup timer period acknowledgement
+		static bool CancelWakeup();			/// Wakeup timer stopping
+	
+	private:
+		static void Start();				/// Calendar starting on the first access
+		static void Wakeup_Handler();		/// Wakeup timer interrupt handler
+		
+		static uint8_t ToBcd(uint32_t value);	/// Binary to BCD conversion
+		static uint32_t FromBcd(uint8_t value);	/// BCD to binary conversion
+		
+		static bool Started;				///< LSI is ready, the calendar is synchronized
+};
+
+#endif /* __RTC_HPP */
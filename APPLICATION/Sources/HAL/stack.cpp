@@ -0,0 +1,64 @@
+/**
+* @file stack.cpp
+* @brief Stack monitoring implementation
+*/
+
+#include "stack.hpp"
+#include "stm32l1xx.h"                  // Device header
+
+
+/// Stack region bounds (see application.sct)
+extern uint32_t Image$$ARM_LIB_STACK$$ZI$$Base[];
+extern uint32_t Image$$ARM_LIB_STACK$$ZI$$Limit[];
+
+
+uint32_t* Stack::HighWater;
+volatile uint8_t Stack::Nesting;
+uint8_t Stack::MaxNesting;
+
+
+/**
+* @brief Free stack painting
+* @note Called by the startup code before __main, so it uses no static data.
+* The words below the current stack pointer are not used yet.
+*/
+void Stack::Paint()
+{
+	uint32_t* word = Image$$ARM_LIB_STACK$$ZI$$Base;
+	uint32_t* top = (uint32_t *)__get_MSP();
+	
+	while(word < top)
+	{
+		*word++ = PATTERN;
+	}
+}
+
+
+/**
+* @brief Stack size
+* @return size (bytes)
+*/
+uint32_t Stack::GetSize()
+{
+	return (uintptr_t)Image$$ARM_LIB_STACK$$ZI$$Limit - (uintptr_t)Image$$ARM_LIB_STACK$$ZI$$Base;
+}
+
+
+/**
+* @brief Max used stack
+* @return used bytes at the deepest point since the reset
+* @note Scans the painted words up to the previous high-water only
+*/
+uint32_t Stack::GetHighWater()
+{
+	uint32_t* limit = HighWater ? HighWater : Image$$ARM_LIB_STACK$$ZI$$Limit;
+	uint32_t* word = Image$$ARM_LIB_STACK$$ZI$$Base;
+	
+	while((word < limit) && (*word == PATTERN))
+	{
+		word++;
+	}
+	HighWater = word;
+	
+	return (uintptr_t)Image$$ARM_LIB_STACK$$ZI$$Limit - (uintptr_t)word;
+}
@@ -0,0 +1,90 @@
+/**
+* @file stack.hpp
+* @brief Stack monitoring header
+*/
+
+#ifndef __STACK_HPP
+#define __STACK_HPP
+
+#include "trace.hpp"
+#include "stm32l1xx.h"                  // Device header
+#include <stdint.h>
+
+
+/**
+* @brief Stack monitoring class
+* @note The startup code paints the free stack with the pattern, the deepest
+* word, which is not the pattern anymore, marks the high-water. The stack is
+* shared by main() and all the interrupts, so the interrupt nesting depth
+* is recorded as well (see IsrGuard).
+*/
+class Stack
+{
+	public:
+		enum Options_t
+		{
+			PATTERN = 0xA5A5A5A5,	///< Free stack word value
+		};
+		
+		static void Paint();				/// Free stack painting (startup code)
+		static uint32_t GetSize();			/// Stack size (bytes)
+		static uint32_t GetHighWater();		/// Max used stack (bytes)
+		
+		/**
+		* @brief Interrupt handler entering
+		*/
+		static void Enter()
+		{
+			if(++Nesting > MaxNesting)
+			{
+				MaxNesting = Nesting;
+			}
+		};
+		
+		/**
+		* @brief Interrupt handler leaving
+		*/
+		static void Leave()
+		{
+			Nesting--;
+		};
+		
+		/**
+		* @brief Get the deepest interrupt nesting seen
+		* @return nested handlers count
+		*/
+		static uint8_t GetMaxNesting()
+		{
+			return MaxNesting;
+		};
+	
+	private:
+		static uint32_t* HighWater;		///< The deepest used word found
+		static volatile uint8_t Nesting;	///< Active handlers count
+		static uint8_t MaxNesting;			///< Max active handlers count
+};
+
+
+/**
+* @brief Interrupt handler scope guard
+* @note The first statement of each handler. Preempting handlers leave before
+* the preempted one continues, so the unlocked counter stays balanced.
+* The entering and leaving are traced with the exception number (see Trace).
+*/
+class IsrGuard
+{
+	public:
+		IsrGuard()
+		{
+			Stack::Enter();
+			Trace::Record(TRACE_ISR_ENTER, __get_IPSR());
+		};
+		
+		~IsrGuard()
+		{
+			Trace::Record(TRACE_ISR_EXIT, __get_IPSR());
+			Stack::Leave();
+		};
+};
+
+#endif /* __STACK_HPP */
@@ -4,11 +4,18 @@
 */
 
 #include "system_timer.hpp"
+#include "critical_section.hpp"
+#include "clock.hpp"
 #include "core.hpp"
+#include "stack.hpp"
 #include "stm32l1xx.h"                  // Device header
 
 
-uint32_t SystemTimer::SecCounter;
+volatile uint64_t SystemTimer::Base;
+volatile uint32_t SystemTimer::Scale;
+volatile bool SystemTimer::AlarmActive;
+uint64_t SystemTimer::AlarmTime;
+IrqHandler_t SystemTimer::AlarmHandler;
 
 /**
 * @brief System timer initialization
@@ -20,16 +27,59 @@ void SystemTimer::Init()
 	RCC->APB2RSTR &= ~RCC_APB2RSTR_TIM9RST;
 	RCC->APB2ENR |= RCC_APB2ENR_TIM9EN;
 	
-	/// Tune prescalers and interrupt
-	TIM9->PSC = (HSE_VALUE / 1000) - 1;
-	TIM9->ARR = 1000;
-	TIM9->CNT = 0;
-	TIM9->CR1 |= TIM_CR1_ARPE;
-	TIM9->EGR |= TIM_EGR_UG;
-	TIM9->SR &= ~TIM_SR_UIF;
+	/// Tune the free-running counter and interrupt
+	Base = 0;
+	TIM9->ARR = 0xFFFF;
+	TIM9->CR1 |= TIM_CR1_URS;
+	SetPrescaler();
 	TIM9->CR1 |= TIM_CR1_CEN;
 	TIM9->DIER |= TIM_DIER_UIE;
-	Core::RegIrqHandler(TIM9_IRQn, SystemTimer::Handler);
+	Core::RegIrqHandler(TIM9_IRQn, SystemTimer::Handler, IRQ_PRIORITY_TIM9);
+	Clock::Subscribe(CLOCK_LISTENER_SYSTEM_TIMER, SystemTimer::ClockChanged);
+}
+
+
+/**
+* @brief Prescaler tuning for the current system clock
+* @note The counter runs at 1 MHz or a bit faster (MSI), the tick length
+* is kept as the counter period length. The counter is restarted from 0.
+*/
+void SystemTimer::SetPrescaler()
+{
+	uint32_t frequency = Clock::GetFrequency();
+	uint32_t prescaler = frequency / 1000000;
+	if(!prescaler)
+	{
+		prescaler = 1;
+	}
+	
+	Scale = (uint32_t)(((uint64_t)1000000 * 65536 * prescaler) / frequency);
+	TIM9->PSC = prescaler - 1;
+	TIM9->CNT = 0;
+	TIM9->EGR = TIM_EGR_UG;
+	TIM9->SR = ~TIM_SR_UIF;
+}
+
+
+/**
+* @brief System clock change handler
+* @note The elapsed time is moved to the base, the alarm is re-armed
+* for the new tick length
+*/
+void SystemTimer::ClockChanged()
+{
+	PriorityLock lock(LOCK_PRIORITY_SYSTEM_TIMER);
+	
+	TIM9->CR1 &= ~TIM_CR1_CEN;
+	Base = GetMicros();
+	SetPrescaler();
+	TIM9->CR1 |= TIM_CR1_CEN;
+	
+	if(AlarmActive)
+	{
+		TIM9->DIER &= ~TIM_DIER_CC1IE;
+		ArmAlarm();
+	}
 }
 
 
@@ -39,18 +89,169 @@ void SystemTimer::Init()
 */
 uint32_t SystemTimer::GetTime()
 {
-	return SecCounter;
+	return GetMicros() / 1000000;
+}
+
+
+/**
+* @brief Get current monotonic time
+* @return microseconds since initialization
+* @note Lock-free: the base is re-read until it is stable,
+* an overflow not handled yet (masked or lower priority interrupt) is taken into account
+*/
+uint64_t SystemTimer::GetMicros()
+{
+	uint64_t base;
+	uint32_t low;
+	uint32_t pending;
+	
+	do
+	{
+		base = Base;
+		low = TIM9->CNT;
+		pending = TIM9->SR & TIM_SR_UIF;
+	}
+	while(base != Base);
+	
+	/// The counter has wrapped, but the interrupt is not handled yet
+	if(pending && (low < 0x8000))
+	{
+		base += Scale;
+	}
+	
+	return base + ((low * Scale) >> 16);
+}
+
+
+/**
+* @brief Busy wait
+* @param us - wait time (us.)
+*/
+void SystemTimer::Delay(uint32_t us)
+{
+	uint64_t waitTo = GetMicros() + us;
+	while(GetMicros() < waitTo);
+}
+
+
+/**
+* @brief Clock advancing (time spent with the timer stopped)
+* @param us - time to add (us.)
+* @note Used after STOP mode and a warm reset (see Retained), the alarm is re-armed against the new counter value
+*/
+void SystemTimer::Skip(uint64_t us)
+{
+	PriorityLock lock(LOCK_PRIORITY_SYSTEM_TIMER);
+	
+	TIM9->CR1 &= ~TIM_CR1_CEN;
+	Base = GetMicros() + us;
+	TIM9->CNT = 0;
+	TIM9->SR = ~TIM_SR_UIF;
+	TIM9->CR1 |= TIM_CR1_CEN;
+	
+	if(AlarmActive)
+	{
+		TIM9->DIER &= ~TIM_DIER_CC1IE;
+		ArmAlarm();
+	}
+}
+
+
+/**
+* @brief Alarm setting
+* @param time - alarm time (us., see GetMicros())
+* @param handler - handler, called from the timer interrupt
+* @note Replaces the previous alarm, an alarm in the past fires immediately.
+* The timer interrupt is masked, as it may re-arm the alarm on overflow.
+*/
+void SystemTimer::SetAlarm(uint64_t time, IrqHandler_t handler)
+{
+	PriorityLock lock(LOCK_PRIORITY_SYSTEM_TIMER);
+	
+	TIM9->DIER &= ~TIM_DIER_CC1IE;
+	AlarmTime = time;
+	AlarmHandler = handler;
+	AlarmActive = true;
+	ArmAlarm();
+}
+
+
+/**
+* @brief Alarm cancelling
+*/
+void SystemTimer::CancelAlarm()
+{
+	PriorityLock lock(LOCK_PRIORITY_SYSTEM_TIMER);
+	
+	AlarmActive = false;
+	TIM9->DIER &= ~TIM_DIER_CC1IE;
+}
+
+
+/**
+* @brief Alarm compare programming
+* @note The compare is enabled only if the alarm is within the current counter period
+* (minus a margin for the programming time), otherwise the overflow interrupt
+* calls this again. The tick count is rounded up, so the alarm is never early.
+*/
+void SystemTimer::ArmAlarm()
+{
+	uint64_t now = GetMicros();
+	if(AlarmTime >= now + ((Scale * 0xF000) >> 16))
+	{
+		return;
+	}
+	
+	uint32_t delta = AlarmTime > now ? (uint32_t)(AlarmTime - now) : 0;
+	uint32_t ticks = ((delta << 16) + Scale - 1) / Scale;
+	
+	TIM9->CCR1 = (TIM9->CNT + ticks) & 0xFFFF;
+	TIM9->SR = ~TIM_SR_CC1IF;
+	TIM9->DIER |= TIM_DIER_CC1IE;
+	
+	/// The counter may have passed the compare value while programming
+	if(GetMicros() >= AlarmTime)
+	{
+		TIM9->EGR = TIM_EGR_CC1G;
+	}
 }
 
 
 /**
 * @brief System timer interrupt handler
+* @note Status flags are cleared by writing zero, read-modify-write would lose
+* a flag set in between
 */
 void SystemTimer::Handler()
 {
-	if(TIM9->SR & TIM_SR_UIF)
+	IsrGuard guard;
+	
+	uint32_t status = TIM9->SR;
+	
+	if(status & TIM_SR_UIF)
+	{
+		TIM9->SR = ~TIM_SR_UIF;
+		Base += Scale;
+		
+		if(AlarmActive && !(TIM9->DIER & TIM_DIER_CC1IE))
+		{
+			ArmAlarm();
+		}
+	}
+	
+	if((status & TIM_SR_CC1IF) && (TIM9->DIER & TIM_DIER_CC1IE))
 	{
-		TIM9->SR &= ~TIM_SR_UIF;
-		SecCounter++;
+		TIM9->SR = ~TIM_SR_CC1IF;
+		TIM9->DIER &= ~TIM_DIER_CC1IE;
+		
+		if(AlarmActive && (GetMicros() >= AlarmTime))
+		{
+			AlarmActive = false;
+			AlarmHandler();
+		}
+		else if(AlarmActive)
+		{
+			ArmAlarm();
+		}
 	}
 }
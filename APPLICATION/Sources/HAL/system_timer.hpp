@@ -6,20 +6,38 @@
 #ifndef	__SYSTEM_TIMER_HPP
 #define	__SYSTEM_TIMER_HPP
 
+#include "core.hpp"
 #include <stdint.h>
 
 /**
 * @brief System timer class
+* @note Free-running 16-bit ~1 MHz counter (TIM9) extended by the overflow
+* handler into a 64-bit monotonic microsecond clock. The tick length follows
+* the system clock profile. Capture/compare channel 1 provides
+* a single alarm, programmed only when it falls within the current counter period.
 */
 class SystemTimer
 {
 	public:
-		static void Init();			/// System timer initialization
-		static uint32_t GetTime();	/// Get current system timer value
-		static void Handler();		/// System timer interrupt handler
+		static void Init();					/// System timer initialization
+		static uint32_t GetTime();			/// Get current system timer value (s.)
+		static uint64_t GetMicros();		/// Get current monotonic time (us.)
+		static void Delay(uint32_t us);		/// Busy wait
+		static void Skip(uint64_t us);		/// Clock advancing (time spent with the timer stopped)
+		static void SetAlarm(uint64_t time, IrqHandler_t handler);	/// Alarm setting
+		static void CancelAlarm();			/// Alarm cancelling
+		static void Handler();				/// System timer interrupt handler
 	
 	private:
-		static uint32_t SecCounter;
+		static void ArmAlarm();				/// Alarm compare programming
+		static void SetPrescaler();			/// Prescaler tuning for the current system clock
+		static void ClockChanged();			/// System clock change handler
+		
+		static volatile uint64_t Base;		///< Time of the counter start (us.)
+		static volatile uint32_t Scale;		///< Counter period (65536 ticks) length (us.)
+		static volatile bool AlarmActive;	///< Alarm is set
+		static uint64_t AlarmTime;			///< Alarm time (us.)
+		static IrqHandler_t AlarmHandler;	///< Alarm handler (interrupt context)
 };
 
 #endif /* __SYSTEM_TIMER_HPP */
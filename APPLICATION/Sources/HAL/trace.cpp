@@ -0,0 +1,80 @@
+/**
+* @file trace.cpp
+* @brief Hot path tracing implementation
+*/
+
+#include "trace.hpp"
+#include "critical_section.hpp"
+#include "compiler.hpp"
+#include "stm32l1xx.h"                  // Device header
+
+
+TraceRecord_t Trace::Records[SIZE];
+uint32_t Trace::Head;
+uint32_t Trace::Tail;
+uint32_t Trace::Lost;
+volatile uint32_t Trace::Mask;
+
+
+/**
+* @brief Tracing initialization
+* @note The cycle counter is enabled by the startup code
+*/
+void Trace::Init()
+{
+	Head = 0;
+	Tail = 0;
+	Lost = 0;
+	Mask = DEFAULT_MASK;
+}
+
+
+/**
+* @brief Record storing
+* @param event - event (see TraceEvent_t)
+* @param argument - event argument
+* @note Any context. The stamp is taken inside the section, so the records
+* are in the time order.
+*/
+RAMFUNC void Trace::Write(uint8_t event, uint16_t argument)
+{
+	CriticalSection section;
+	
+	TraceRecord_t* record = &Records[Head & (SIZE - 1)];
+	record->Cycles = DWT->CYCCNT;
+	record->Event = event;
+	record->Argument = argument;
+	Head++;
+}
+
+
+/**
+* @brief Oldest records reading
+* @param buffer - destination buffer pointer
+* @param count - buffer size (records)
+* @param lost - destination pointer of the records overwritten since the previous reading
+* @return records count
+* @note Thread mode only: the interrupts, which were storing records, are complete
+*/
+uint32_t Trace::Read(TraceRecord_t* buffer, uint32_t count, uint16_t* lost)
+{
+	CriticalSection section;
+	
+	if(Head - Tail > SIZE)
+	{
+		Lost += Head - Tail - SIZE;
+		Tail = Head - SIZE;
+	}
+	
+	*lost = Lost > UINT16_MAX ? UINT16_MAX : (uint16_t)Lost;
+	Lost = 0;
+	
+	uint32_t result = 0;
+	while((result < count) && (Tail != Head))
+	{
+		buffer[result++] = Records[Tail & (SIZE - 1)];
+		Tail++;
+	}
+	
+	return result;
+}
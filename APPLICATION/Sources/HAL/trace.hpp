@@ -0,0 +1,128 @@
+/**
+* @file trace.hpp
+* @brief Hot path tracing header
+*/
+
+#ifndef __TRACE_HPP
+#define __TRACE_HPP
+
+#include "memory_map.h"
+#include "static_assert.hpp"
+#include <stdint.h>
+
+
+/// Trace events
+enum TraceEvent_t
+{
+	TRACE_ISR_ENTER = 0,	///< Interrupt handler entering (exception number)
+	TRACE_ISR_EXIT,			///< Interrupt handler leaving (exception number)
+	TRACE_TAP,				///< Card serving start
+	TRACE_ATR,				///< Answer to reset received
+	TRACE_PPS,				///< Protocol and parameters selection done
+	TRACE_APDU_BEGIN,		///< Command transmission start (INS)
+	TRACE_APDU_END,			///< Command status received (INS)
+	TRACE_DECISION,			///< Access decision (see Decision_t)
+	TRACE_COMMIT_BEGIN,		///< Data EEPROM commit start (dirty words count)
+	TRACE_COMMIT_END,		///< Data EEPROM commit end (1 - successful)
+	TRACE_BUS_IN,			///< Bus frame received (command)
+	TRACE_BUS_OUT,			///< Bus frame transmitted (command)
+	TRACE_CLOCK,			///< System clock change (frequency, 100 kHz units)
+	TRACE_EVENTS,			///< Events count
+};
+
+
+/// Trace record (8 bytes)
+struct TraceRecord_t
+{
+	uint32_t Cycles;		///< Cycle counter
+	uint8_t Event;			///< Event (see TraceEvent_t)
+	uint8_t Reserved;		///< Alignment
+	uint16_t Argument;		///< Event argument
+};
+
+
+/**
+* @brief Hot path tracing class
+* @note Each enabled event is stamped by the cycle counter and stored in the RAM ring,
+* the oldest records are overwritten. The ring is drained over the bus (BUS_TRACE_READ),
+* Tools/trace_decode.py builds the latency histograms. The interrupt events
+* are disabled by default, they fill the ring in a few characters.
+*/
+class Trace
+{
+	public:
+		enum Options_t
+		{
+			SIZE = 64,																///< Ring size (records, power of 2)
+			DEFAULT_MASK = ((1UL << TRACE_EVENTS) - 1) & ~((1UL << TRACE_ISR_ENTER) | (1UL << TRACE_ISR_EXIT)),	///< Enabled events after reset
+		};
+		
+		static void Init();															/// Tracing initialization
+		static uint32_t Read(TraceRecord_t* buffer, uint32_t count, uint16_t* lost);	/// Oldest records reading
+		
+		/**
+		* @brief Event recording
+		* @param event - event (see TraceEvent_t)
+		* @param argument - event argument
+		* @note A disabled event costs a load and a branch
+		*/
+		static void Record(uint8_t event, uint16_t argument = 0)
+		{
+			if(Mask & (1UL << event))
+			{
+				Write(event, argument);
+			}
+		};
+		
+		/**
+		* @brief Enabled events setting
+		* @param mask - events mask (bit per TraceEvent_t)
+		*/
+		static void SetMask(uint32_t mask)
+		{
+			Mask = mask;
+		};
+	
+	private:
+		static void Write(uint8_t event, uint16_t argument);	/// Record storing
+		
+		static TraceRecord_t Records[SIZE];		///< Records ring
+		static uint32_t Head;					///< Records written
+		static uint32_t Tail;					///< Records read
+		static uint32_t Lost;					///< Records overwritten before reading
+		static volatile uint32_t Mask;			///< Enabled events
+		
+		STATIC_ASSERT(sizeof(TraceRecord_t) == 8, trace_record_size);
+		STATIC_ASSERT(sizeof(TraceRecord_t) * SIZE + 16 <= TRACE_RAM_BUDGET, trace_ram_budget);
+};
+
+
+/**
+* @brief Traced scope
+* @note Records the begin event on construction and the end event on destruction
+*/
+class TraceSpan
+{
+	public:
+		/**
+		* @brief Scope beginning
+		* @param begin - begin event
+		* @param end - end event
+		* @param argument - both events argument
+		*/
+		TraceSpan(uint8_t begin, uint8_t end, uint16_t argument) : End(end), Argument(argument)
+		{
+			Trace::Record(begin, argument);
+		};
+		
+		~TraceSpan()
+		{
+			Trace::Record(End, Argument);
+		};
+	
+	private:
+		uint8_t End;			///< End event
+		uint16_t Argument;		///< Events argument
+};
+
+#endif /* __TRACE_HPP */
@@ -5,22 +5,39 @@
 
 #include "uart.hpp"
 #include "board.hpp"
+#include "clock.hpp"
+#include "compiler.hpp"
+#include "critical_section.hpp"
+#include "metrics.hpp"
+#include "capture.hpp"
+#include "memory_map.h"
+#include "static_assert.hpp"
 #include <string.h>
 
 
 Uart Uart1(115200);
 
+STATIC_ASSERT(sizeof(Uart) <= UART_RAM_BUDGET, uart_ram_budget);
+
 
 /**
 * @brief Constructor
 * @param baudrate
+* @note The hardware is not touched before Init()
 */
 Uart::Uart(uint32_t baudrate)
 {
-	RxBuffer = new char[RX_SIZE];
-	
-	TxBuffer = RxBuffer;
-	
+	Baudrate = baudrate;
+	IdleHandler = 0;
+}
+
+
+/**
+* @brief Initialization
+* @note Called by the first user (see Bus::Init), after the pins tuning
+*/
+void Uart::Init()
+{
 	/// Enable USART clocking
 	RCC->APB2RSTR |= RCC_APB2RSTR_USART1RST;
 	RCC->APB2RSTR &= ~RCC_APB2RSTR_USART1RST;
@@ -31,17 +48,17 @@ Uart::Uart(uint32_t baudrate)
 	RCC->AHBRSTR &= ~RCC_AHBRSTR_DMA1RST;
 	RCC->AHBENR |= RCC_AHBENR_DMA1EN;
 	
-	Core::RegIrqHandler(USART1_IRQn, Uart::UART1_Handler);
+	Core::RegIrqHandler(USART1_IRQn, Core::Member<Uart, &Uart::Handler>, this, IRQ_PRIORITY_USART1);
 	
 	///--- RX ---///
 	/// Max frame size
 	DMA1_Channel5->CNDTR = RX_SIZE & DMA_CNDTR1_NDT;
 	
 	/// Data source address (USART data register)
-	DMA1_Channel5->CPAR = ((uint32_t)&USART1->DR) & DMA_CPAR5_PA;
+	DMA1_Channel5->CPAR = ((uint32_t)(uintptr_t)&USART1->DR) & DMA_CPAR5_PA;
 	
 	/// Data destination address (SRAM)
-	DMA1_Channel5->CMAR = ((uint32_t)RxBuffer) & DMA_CMAR5_MA;
+	DMA1_Channel5->CMAR = ((uint32_t)(uintptr_t)RxBuffer) & DMA_CMAR5_MA;
 	
 	/// DMA RX channel tunning
 	DMA1_Channel5->CCR = (
@@ -56,10 +73,10 @@ Uart::Uart(uint32_t baudrate)
 	DMA1_Channel4->CNDTR = 0;
 	
 	/// Data destination address (USART data register)
-	DMA1_Channel4->CPAR = ((uint32_t)&USART1->DR) & DMA_CPAR4_PA;
+	DMA1_Channel4->CPAR = ((uint32_t)(uintptr_t)&USART1->DR) & DMA_CPAR4_PA;
 	
 	/// Data source address (SRAM)
-	DMA1_Channel4->CMAR = ((uint32_t)TxBuffer) & DMA_CMAR4_MA;
+	DMA1_Channel4->CMAR = ((uint32_t)(uintptr_t)TxBuffer) & DMA_CMAR4_MA;
 	
 	/// DMA TX channel tunning
 	DMA1_Channel4->CCR = (
@@ -68,10 +85,8 @@ Uart::Uart(uint32_t baudrate)
 		DMA_CCR_DIR); 			///< Data transfer direction = Read from memory
 	
 	/// Tune baudrate
-	float divider = (float)HSE_VALUE / (16 * baudrate);
-	uint32_t integ = divider;
-	uint32_t fract = 10 * (divider - integ);
-	USART1->BRR = (integ << 4) | (fract & 0x0F);
+	SetBaudrate();
+	Clock::Subscribe(CLOCK_LISTENER_UART, Uart::ClockChanged);
 	
 	/// CR1
 	USART1->CR1 = 
@@ -88,28 +103,82 @@ Uart::Uart(uint32_t baudrate)
 		USART_CR3_DMAR);		///< DMA enable receiver
 	
 	RxHead = RxBuffer;
+	CaptureHead = RxBuffer;
+}
+
+
+/**
+* @brief Baudrate tuning for the current system clock
+* @note BRR is the clock to baudrate ratio in 12.4 fixed point (oversampling by 16)
+*/
+void Uart::SetBaudrate()
+{
+	USART1->BRR = (Clock::GetFrequency() + Baudrate / 2) / Baudrate;
 }
 
 
 /**
-* @brief USART1 interrupt handler
+* @brief System clock change handler
 */
-void Uart::UART1_Handler()
+void Uart::ClockChanged()
 {
-	Uart1.Handler();
+	Uart1.SetBaudrate();
 }
 
 
 /**
 * @brief Interrupt handler
 */
-void Uart::Handler()
+RAMFUNC void Uart::Handler()
 {
-	if(USART1->SR & USART_SR_TC)
+	uint32_t status = USART1->SR;
+	
+	/// Transmission complete, release the RS485 line
+	if((status & USART_SR_TC) && (USART1->CR1 & USART_CR1_TCIE))
 	{
 		USART1->SR &= ~USART_SR_TC;
+		USART1->CR1 &= ~USART_CR1_TCIE;
 		Board::SetRead485();
 	}
+	
+	/// IDLE and ORE are cleared by SR reading followed by DR reading (the data are taken by DMA already)
+	if((status & USART_SR_IDLE) && (USART1->CR1 & USART_CR1_IDLEIE))
+	{
+		if(status & USART_SR_ORE)
+		{
+			Metrics::Count(METRIC_BUS_OVERRUNS);
+		}
+		
+		(void)USART1->DR;
+		CaptureReceived();
+		IdleHandler();
+	}
+}
+
+
+/**
+* @brief Received burst capturing
+* @note Called at the line idle, the DMA doesn't tell the byte times,
+* so the burst bytes get the idle time. The position follows the DMA
+* while the capture is off.
+*/
+RAMFUNC void Uart::CaptureReceived()
+{
+	char* tail = &RxBuffer[RX_SIZE - DMA1_Channel5->CNDTR];
+	if(!Capture::IsEnabled(CAPTURE_BUS_RX))
+	{
+		CaptureHead = tail;
+		return;
+	}
+	
+	while(CaptureHead != tail)
+	{
+		Capture::Record(CAPTURE_BUS_RX, *CaptureHead);
+		if(++CaptureHead == &RxBuffer[RX_SIZE])
+		{
+			CaptureHead = RxBuffer;
+		}
+	}
 }
 
 
@@ -121,7 +190,7 @@ void Uart::Handler()
 void Uart::Transmit(const char* data, uint16_t count)
 {
 	/// Limit data size
-	uint16_t remain = count > TX_SIZE ? TX_SIZE : count;
+	uint16_t remain = count > TX_SIZE ? (uint16_t)TX_SIZE : count;
 	
 	/// Wait until the transfer is complete
 	while(DMA1_Channel4->CNDTR & DMA_CNDTR4_NDT);
@@ -134,11 +203,21 @@ void Uart::Transmit(const char* data, uint16_t count)
 	
 	/// Copy data to buffer, set size
 	memcpy(TxBuffer, data, remain);
+	if(Capture::IsEnabled(CAPTURE_BUS_TX))
+	{
+		for(uint16_t index = 0; index < remain; index++)
+		{
+			Capture::Record(CAPTURE_BUS_TX, data[index]);
+		}
+	}
 	DMA1_Channel4->CNDTR = remain & DMA_CNDTR4_NDT;
 	
 	/// Allow interrupt on data register devastation, enable RS485 driver
-	USART1->SR &= ~USART_SR_TC;
-	USART1->CR1 |= USART_CR1_TCIE;
+	{
+		PriorityLock lock(LOCK_PRIORITY_BUS);
+		USART1->SR &= ~USART_SR_TC;
+		USART1->CR1 |= USART_CR1_TCIE;
+	}
 	Board::SetWrite485();
 	
 	/// Start transmission
@@ -154,13 +233,13 @@ void Uart::Transmit(const char* data, uint16_t count)
 uint16_t Uart::CopyReceivedData(char* buffer, uint16_t size)
 {
 	/// Memorize tail position
-	uint32_t tail = (uint32_t)(&RxBuffer[RX_SIZE - DMA1_Channel5->CNDTR]);
+	uintptr_t tail = (uintptr_t)(&RxBuffer[RX_SIZE - DMA1_Channel5->CNDTR]);
 	
 	/// If the buffer is not looped
-	if(tail >= (uint32_t)RxHead)
+	if(tail >= (uintptr_t)RxHead)
 	{
 		/// Copy data
-		uint16_t count = tail - (uint32_t)RxHead;
+		uint16_t count = tail - (uintptr_t)RxHead;
 		
 		/// If buffer size is insufficient, limit data size
 		if(size < count)
@@ -177,7 +256,7 @@ uint16_t Uart::CopyReceivedData(char* buffer, uint16_t size)
 	{
 		/// Copy a part from the end and a part from the beginning
 		uint16_t count1 = &RxBuffer[RX_SIZE] - RxHead;
-		uint16_t count2 = tail - (uint32_t)RxBuffer;
+		uint16_t count2 = tail - (uintptr_t)RxBuffer;
 		
 		/// If buffer size is insufficient, limit data size
 		if(size <= count1)
@@ -188,7 +267,8 @@ uint16_t Uart::CopyReceivedData(char* buffer, uint16_t size)
 		}
 		else if(size < (count1 + count2))
 		{
-			count2 = (count1 + count2) - size;
+			count2 = size - count1;
+			memcpy(buffer, RxHead, count1);
 			memcpy(&buffer[count1], RxBuffer, count2);
 		}
 		else
@@ -225,8 +305,18 @@ void Uart::DeleteReceivedData(uint16_t count)
 */
 bool Uart::IsReceiverEmpty()
 {
-	uint32_t tail = (uint32_t)(&RxBuffer[RX_SIZE - DMA1_Channel5->CNDTR]);
-	return ((uint32_t)RxHead == tail);
+	uintptr_t tail = (uintptr_t)(&RxBuffer[RX_SIZE - DMA1_Channel5->CNDTR]);
+	return ((uintptr_t)RxHead == tail);
+}
+
+
+/**
+* @brief Checking, whether the transmission is in progress
+* @return true, if DMA is transferring or the last byte is being shifted out
+*/
+bool Uart::IsTransmitting()
+{
+	return (DMA1_Channel4->CNDTR & DMA_CNDTR4_NDT) || (USART1->CR1 & USART_CR1_TCIE);
 }
 
 
@@ -236,15 +326,15 @@ bool Uart::IsReceiverEmpty()
 void Uart::Flush()
 {
 	/// Memorize tail position
-	uint32_t tail = (uint32_t)(&RxBuffer[RX_SIZE - DMA1_Channel5->CNDTR]);
+	uintptr_t tail = (uintptr_t)(&RxBuffer[RX_SIZE - DMA1_Channel5->CNDTR]);
 	
 	uint16_t count = 0;
 	
 	/// If the buffer is not looped
-	if(tail >= (uint32_t)RxHead)
+	if(tail >= (uintptr_t)RxHead)
 	{
 		/// Count data
-		count = tail - (uint32_t)RxHead;
+		count = tail - (uintptr_t)RxHead;
 	}
 	
 	/// If the buffer is looped
@@ -252,9 +342,29 @@ void Uart::Flush()
 	{
 		/// Count a part from the end and a part from the beginning
 		uint16_t count1 = &RxBuffer[RX_SIZE] - RxHead;
-		uint16_t count2 = tail - (uint32_t)RxBuffer;
+		uint16_t count2 = tail - (uintptr_t)RxBuffer;
 		count = count1 + count2;
 	}
 	
 	DeleteReceivedData(count);
 }
+
+
+/**
+* @brief Line idle handler setting
+* @param handler - handler, called from the interrupt after a received burst (0 disables)
+*/
+void Uart::SetIdleHandler(IrqHandler_t handler)
+{
+	PriorityLock lock(LOCK_PRIORITY_BUS);
+	
+	IdleHandler = handler;
+	if(handler)
+	{
+		USART1->CR1 |= USART_CR1_IDLEIE;
+	}
+	else
+	{
+		USART1->CR1 &= ~USART_CR1_IDLEIE;
+	}
+}
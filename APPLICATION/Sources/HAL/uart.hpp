@@ -19,10 +19,13 @@ class Uart
 	public:
 		enum Options_t
 		{
-			RX_SIZE = 1024,
-			TX_SIZE = 1024,
+			RX_SIZE = 2048,	///< Receive DMA buffer size
+			TX_SIZE = 1024,	///< Transmit DMA buffer size
 		};
 		
+		/// Initialization
+		void Init();
+		
 		/// Data transmission
 		void Transmit(const char* data, uint16_t count);
 		
@@ -38,19 +41,34 @@ class Uart
 		/// Receive buffer cleaning
 		void Flush();
 		
-		/// USART1 interrupt handler
-		static void UART1_Handler();
+		/// Checking, whether the transmission is in progress
+		bool IsTransmitting();
+		
+		/// Line idle handler setting
+		void SetIdleHandler(IrqHandler_t handler);
 		
 		/// Constructor
 		Uart(uint32_t baudrate);
 		
 	private:
-		char *RxBuffer;	///< Receive buffer
-		char *TxBuffer;	///< Transmit buffer
+		char RxBuffer[RX_SIZE];	///< Receive buffer
+		char TxBuffer[TX_SIZE];	///< Transmit buffer
 		char* RxHead;	///< Receive buffer head
+		char* CaptureHead;	///< Receive buffer position of the capture
+		IrqHandler_t IdleHandler;	///< Line idle handler
+		uint32_t Baudrate;	///< Baudrate
 		
 		/// Interrupt handler
 		void Handler();
+		
+		/// Received burst capturing
+		void CaptureReceived();
+		
+		/// Baudrate tuning for the current system clock
+		void SetBaudrate();
+		
+		/// System clock change handler
+		static void ClockChanged();
 };
 
 
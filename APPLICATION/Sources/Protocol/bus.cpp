@@ -0,0 +1,184 @@
+/**
+* @file bus.cpp
+* @brief RS485 bus protocol implementation
+*/
+
+#include "bus.hpp"
+#include "uart.hpp"
+#include "crc.hpp"
+#include "trace.hpp"
+#include "metrics.hpp"
+#include "event_queue.hpp"
+#include <string.h>
+
+
+uint8_t Bus::Address;
+uint8_t Bus::Sequence;
+uint16_t Bus::Pending;
+TimerService::Handle_t Bus::FrameTimer;
+
+
+/**
+* @brief Bus initialization
+* @param address - device address
+*/
+void Bus::Init(uint8_t address)
+{
+	Address = address;
+	Pending = 0;
+	FrameTimer = TimerService::Create(Bus::FrameTimeout, 0);
+	Uart1.Init();
+}
+
+
+/**
+* @brief Frame receiving
+* @param frame - destination frame pointer
+* @return true, if a valid frame for this device is received
+*/
+bool Bus::Receive(BusFrame_t* frame)
+{
+	char buffer[MAX_FRAME];
+	
+	while(!Uart1.IsReceiverEmpty())
+	{
+		uint16_t count = Uart1.CopyReceivedData(buffer, sizeof(buffer));
+		
+		/// Skip garbage before the start of frame
+		if((uint8_t)buffer[0] != SOF)
+		{
+			uint16_t skip = 1;
+			while((skip < count) && ((uint8_t)buffer[skip] != SOF))
+			{
+				skip++;
+			}
+			Uart1.DeleteReceivedData(skip);
+			Pending = 0;
+			continue;
+		}
+		
+		/// Wait for the whole frame (header first), restart the timeout while it grows
+		uint16_t length = 1 + sizeof(BusHeader_t) + 2;
+		if(count >= 1 + sizeof(BusHeader_t))
+		{
+			length += (uint8_t)buffer[1 + 3];
+		}
+		if(count < length)
+		{
+			if(count != Pending)
+			{
+				Pending = count;
+				TimerService::Start(FrameTimer, FRAME_TIMEOUT);
+			}
+			return false;
+		}
+		
+		Pending = 0;
+		TimerService::Stop(FrameTimer);
+		
+		/// Check CRC, on error resynchronize from the next byte
+		uint16_t crc = Crc::Calc16(&buffer[1], length - 3, 0);
+		if(((uint8_t)buffer[length - 2] != (crc & 0xFF)) || ((uint8_t)buffer[length - 1] != (crc >> 8)))
+		{
+			Metrics::Count(METRIC_BUS_CRC_ERRORS);
+			Uart1.DeleteReceivedData(1);
+			continue;
+		}
+		
+		Uart1.DeleteReceivedData(length);
+		
+		/// Check address
+		if(((uint8_t)buffer[1] != Address) && ((uint8_t)buffer[1] != BROADCAST))
+		{
+			continue;
+		}
+		
+		memcpy(frame, &buffer[1], length - 3);
+		Trace::Record(TRACE_BUS_IN, frame->Header.Command);
+		return true;
+	}
+	
+	return false;
+}
+
+
+/**
+* @brief Incomplete frame dropping (timer callback)
+* @param context - not used
+* @note Start of frame is deleted, the next Receive() resynchronizes.
+* A complete frame may wait behind it, so the bus event is posted.
+*/
+void Bus::FrameTimeout(void* /*context*/)
+{
+	if(Pending)
+	{
+		Metrics::Count(METRIC_BUS_TIMEOUTS);
+		Pending = 0;
+		Uart1.DeleteReceivedData(1);
+		EventQueue::Post(EVENT_BUS);
+	}
+}
+
+
+/**
+* @brief Frame sending
+* @param command - command (see BusCommand_t)
+* @param sequence - sequence number
+* @param data - data pointer
+* @param length - data length
+*/
+void Bus::Send(uint8_t command, uint8_t sequence, const void* data, uint8_t length)
+{
+	char buffer[MAX_FRAME];
+	
+	buffer[0] = SOF;
+	buffer[1] = Address;
+	buffer[2] = sequence;
+	buffer[3] = command;
+	buffer[4] = length;
+	if(length)
+	{
+		memcpy(&buffer[1 + sizeof(BusHeader_t)], data, length);
+	}
+	
+	uint16_t crc = Crc::Calc16(&buffer[1], sizeof(BusHeader_t) + length, 0);
+	buffer[1 + sizeof(BusHeader_t) + length] = crc & 0xFF;
+	buffer[1 + sizeof(BusHeader_t) + length + 1] = crc >> 8;
+	
+	Uart1.Transmit(buffer, 1 + sizeof(BusHeader_t) + length + 2);
+	Trace::Record(TRACE_BUS_OUT, command);
+}
+
+
+/**
+* @brief Reply to the request
+* @param request - request frame pointer
+* @param command - command (see BusCommand_t)
+* @param data - data pointer
+* @param length - data length
+* @note Broadcast requests are not answered, all the readers would drive the line at once
+*/
+void Bus::Reply(const BusFrame_t* request, uint8_t command, const void* data, uint8_t length)
+{
+	if(request->Header.Address == BROADCAST)
+	{
+		return;
+	}
+	
+	Send(command, request->Header.Sequence, data, length);
+}
+
+
+/**
+* @brief Request to the controller
+* @param command - command (see BusCommand_t)
+* @param data - data pointer
+* @param length - data length
+* @return sequence number of the request (the reply repeats it)
+*/
+uint8_t Bus::Request(uint8_t command, const void* data, uint8_t length)
+{
+	Sequence++;
+	Send(command, Sequence, data, length);
+	return Sequence;
+}
@@ -0,0 +1,120 @@
+/**
+* @file bus.hpp
+* @brief RS485 bus protocol header
+*/
+
+#ifndef __BUS_HPP
+#define __BUS_HPP
+
+#include "timer_service.hpp"
+#include <stdint.h>
+
+
+/// Bus commands
+enum BusCommand_t
+{
+	BUS_ACK				= 0x01,	///< Acknowledgement
+	BUS_NACK			= 0x02,	///< Negative acknowledgement
+	BUS_SET_TIME		= 0x10,	///< Set RTC time (uint32_t, s. since 2000-01-01)
+	BUS_JOURNAL_READ	= 0x20,	///< Journal records request
+	BUS_JOURNAL_DATA	= 0x21,	///< Journal records (count, JournalRecord_t[count])
+	BUS_JOURNAL_ACK		= 0x22,	///< Journal records acknowledgement (count)
+	BUS_CREDENTIAL_WRITE	= 0x30,	///< Local table slot writing (slot, Credential_t, flags)
+	BUS_CREDENTIAL_RESOLVE	= 0x31,	///< Credential identifier resolving (CredentialId_t)
+	BUS_CREDENTIAL_DATA		= 0x32,	///< Resolved credential (CredentialId_t, Credential_t)
+	BUS_DB_BEGIN			= 0x40,	///< Credential database loading start (keys count)
+	BUS_DB_WRITE			= 0x41,	///< Credential database chunk (byte offset, 128 bytes of keys)
+	BUS_DB_COMMIT			= 0x42,	///< Credential database loading end (keys CRC16)
+	BUS_DECISION_REQUEST	= 0x50,	///< Decision request from the reader (CredentialId_t, Credential_t)
+	BUS_DECISION			= 0x51,	///< Controller decision (CredentialId_t, decision, TTL (uint16_t, s.))
+	BUS_CACHE_INVALIDATE	= 0x52,	///< Cached decision invalidation (CredentialId_t, CREDENTIAL_NONE - all)
+	BUS_POWER_READ			= 0x60,	///< Power statistics request
+	BUS_POWER_DATA			= 0x61,	///< Power statistics (STOP entries, last and max RS485 wakeup to first byte latency (us.), uint32_t each)
+	BUS_CLOCK_PROFILE		= 0x62,	///< Clock profile switching (profile, see ClockProfile_t)
+	BUS_BOOT_READ			= 0x63,	///< Boot time request
+	BUS_BOOT_DATA			= 0x64,	///< Boot phases duration (us., uint32_t each, see BootPhase_t)
+	BUS_RESET_READ			= 0x65,	///< Reset information request
+	BUS_RESET_DATA			= 0x66,	///< Reset information (reason (see ResetReason_t), warm resets count, state restored, uint32_t each)
+	BUS_STACK_READ			= 0x67,	///< Stack use request
+	BUS_STACK_DATA			= 0x68,	///< Stack use (size, high-water (bytes), max interrupt nesting, uint32_t each)
+	BUS_BENCHMARK			= 0x69,	///< SRAM execution benchmark request
+	BUS_BENCHMARK_DATA		= 0x6A,	///< Benchmark result (CRC16 data size, SRAM cycles, flash cycles, uint32_t each)
+	BUS_IRQ_BENCHMARK		= 0x6B,	///< Interrupt entry benchmark request
+	BUS_IRQ_BENCHMARK_DATA	= 0x6C,	///< Interrupt entry result (direct vector cycles, context dispatch cycles, uint32_t each)
+	BUS_TRACE_MASK			= 0x6D,	///< Traced events setting (uint32_t, bit per TraceEvent_t)
+	BUS_TRACE_READ			= 0x6E,	///< Trace records request (the oldest first)
+	BUS_TRACE_DATA			= 0x6F,	///< Trace records (cycle counter frequency (Hz, uint32_t), lost records (uint16_t), TraceRecord_t[])
+	BUS_PROFILE_START		= 0x70,	///< Sampling profiler start (rate (Hz, uint16_t, the clock / 2^24 at least), 0 - stop, the histogram is cleared)
+	BUS_PROFILE_READ		= 0x71,	///< Profile histogram page request (first bucket, uint8_t)
+	BUS_PROFILE_DATA		= 0x72,	///< Profile histogram page (ProfileHeader_t, uint16_t counters)
+	BUS_METRICS_READ		= 0x73,	///< Metrics request
+	BUS_METRICS_DATA		= 0x74,	///< Metrics (Metrics::Snapshot_t)
+	BUS_LOG_READ			= 0x75,	///< Log messages request (the oldest first)
+	BUS_LOG_DATA			= 0x76,	///< Log messages (dropped messages (uint16_t), message words (uint32_t, see Log))
+	BUS_CAPTURE_START		= 0x77,	///< Line capture start (uint8_t, bit per CaptureChannel_t, 0 - stop, the ring is cleared)
+	BUS_CAPTURE_READ		= 0x78,	///< Captured records request (the oldest first, stops the capture)
+	BUS_CAPTURE_DATA		= 0x79,	///< Captured records (dropped records (uint16_t), CaptureRecord_t[])
+};
+
+
+#pragma pack(1)
+
+/// Frame header
+struct BusHeader_t
+{
+	uint8_t Address;	///< Device address
+	uint8_t Sequence;	///< Sequence number (the reply repeats the request one)
+	uint8_t Command;	///< Command (see BusCommand_t)
+	uint8_t Length;		///< Data length
+};
+
+/// Frame
+struct BusFrame_t
+{
+	BusHeader_t Header;	///< Header
+	uint8_t Data[255];	///< Data
+};
+
+#pragma pack()
+
+
+/**
+* @brief RS485 bus protocol class
+* @note Frame: preamble, SOF, header, data, CRC16 (header and data, LSB first).
+* The controller starts each frame with PREAMBLE bytes lasting PREAMBLE_TIME
+* at least: their start bits wake a sleeping reader up, the bytes received
+* until its clocks are restored are lost (the latency is reported, see
+* BUS_POWER_DATA). The receiver skips everything before SOF, the reader frames
+* have no preamble. Incomplete frame, which does not grow for FRAME_TIMEOUT,
+* is dropped.
+*/
+class Bus
+{
+	public:
+		enum Options_t
+		{
+			PREAMBLE = 0xFF,			///< Preamble byte
+			PREAMBLE_TIME = 5000,		///< Min preamble duration (us., above the max wakeup to first byte latency)
+			SOF = 0xA5,					///< Start of frame
+			BROADCAST = 0xFF,			///< Broadcast address (executed by all the readers, not answered)
+			MAX_DATA = 255,				///< Max data length
+			MAX_FRAME = 1 + sizeof(BusHeader_t) + MAX_DATA + 2,	///< Max frame size
+			FRAME_TIMEOUT = 20000,		///< Max pause within the frame (us.)
+		};
+		
+		static void Init(uint8_t address);									/// Bus initialization
+		static bool Receive(BusFrame_t* frame);								/// Frame receiving
+		static void Send(uint8_t command, uint8_t sequence, const void* data, uint8_t length);	/// Frame sending
+		static void Reply(const BusFrame_t* request, uint8_t command, const void* data = 0, uint8_t length = 0);	/// Reply to the request
+		static uint8_t Request(uint8_t command, const void* data, uint8_t length);	/// Request to the controller
+		
+	private:
+		static uint8_t Address;		///< Device address
+		static uint8_t Sequence;	///< Sequence number of the reader requests
+		static uint16_t Pending;	///< Received part of the incomplete frame (bytes)
+		static TimerService::Handle_t FrameTimer;	///< Incomplete frame timer
+		
+		static void FrameTimeout(void* context);	/// Incomplete frame dropping (timer callback)
+};
+
+#endif /* __BUS_HPP */
@@ -0,0 +1,106 @@
+/**
+* @file benchmark.cpp
+* @brief Execution benchmark implementation
+*/
+
+#include "benchmark.hpp"
+#include "critical_section.hpp"
+#include "crc.hpp"
+#include "stm32l1xx.h"                  // Device header
+
+
+/// Unused interrupt, pended by software
+#define BENCHMARK_IRQn		TIM11_IRQn
+
+
+volatile uint32_t Benchmark::EntryCycles;
+
+
+/**
+* @brief Benchmark running
+* @param ramCycles - destination SRAM execution cycles pointer
+* @param flashCycles - destination flash execution cycles pointer
+* @note The difference depends on the flash wait states of the current clock profile
+*/
+void Benchmark::Run(uint32_t* ramCycles, uint32_t* flashCycles)
+{
+	char sample[SAMPLE_SIZE];
+	for(uint32_t index = 0; index < SAMPLE_SIZE; index++)
+	{
+		sample[index] = (char)index;
+	}
+	
+	CriticalSection section;
+	
+	uint32_t start = DWT->CYCCNT;
+	Crc::Calc16(sample, SAMPLE_SIZE, 0);
+	*ramCycles = DWT->CYCCNT - start;
+	
+	start = DWT->CYCCNT;
+	Crc::Calc16Flash(sample, SAMPLE_SIZE, 0);
+	*flashCycles = DWT->CYCCNT - start;
+}
+
+
+/**
+* @brief Interrupt entry benchmark running
+* @param directCycles - destination direct vector entry cycles pointer
+* @param contextCycles - destination context handler entry cycles pointer
+* @note Called from the thread mode (or from a lower priority), so the pended
+* interrupt is taken at once. The entry includes the dispatcher for the context handler.
+*/
+void Benchmark::RunIrqEntry(uint32_t* directCycles, uint32_t* contextCycles)
+{
+	Core::RegIrqHandler(BENCHMARK_IRQn, Benchmark::Direct_Handler, IRQ_PRIORITY_BENCHMARK);
+	*directCycles = MeasureIrqEntry();
+	
+	Core::RegIrqHandler(BENCHMARK_IRQn, Benchmark::Context_Handler, (void *)&EntryCycles, IRQ_PRIORITY_BENCHMARK);
+	*contextCycles = MeasureIrqEntry();
+	
+	Core::UnregIrqHandler(BENCHMARK_IRQn);
+}
+
+
+/**
+* @brief Interrupt entry measurement
+* @return minimum cycles from the pending to the handler entry
+*/
+uint32_t Benchmark::MeasureIrqEntry()
+{
+	uint32_t result = UINT32_MAX;
+	
+	for(uint32_t index = 0; index < IRQ_SAMPLES; index++)
+	{
+		uint32_t start = DWT->CYCCNT;
+		NVIC->ISPR[BENCHMARK_IRQn >> 5] = 1UL << (BENCHMARK_IRQn & 0x1F);
+		__DSB();
+		__ISB();
+		
+		uint32_t cycles = EntryCycles - start;
+		if(cycles < result)
+		{
+			result = cycles;
+		}
+	}
+	
+	return result;
+}
+
+
+/**
+* @brief Direct vector handler
+*/
+void Benchmark::Direct_Handler()
+{
+	EntryCycles = DWT->CYCCNT;
+}
+
+
+/**
+* @brief Context handler
+* @param context - the entry cycles destination
+*/
+void Benchmark::Context_Handler(void* context)
+{
+	*(volatile uint32_t *)context = DWT->CYCCNT;
+}
@@ -0,0 +1,42 @@
+/**
+* @file benchmark.hpp
+* @brief Execution benchmark header
+*/
+
+#ifndef __BENCHMARK_HPP
+#define __BENCHMARK_HPP
+
+#include "core.hpp"
+#include <stdint.h>
+
+
+/**
+* @brief Execution benchmark class
+* @note Measures the same CRC16 kernel executed from SRAM (RAMFUNC) and from flash
+* by the cycle counter, interrupts are masked during the measurement. Both read
+* the table from flash, so only the code placement differs.
+* The interrupt entry is measured from the software pending of an unused
+* interrupt to the first handler line, registered as a direct vector and
+* as a context handler (see Core).
+*/
+class Benchmark
+{
+	public:
+		enum Options_t
+		{
+			SAMPLE_SIZE = 256,	///< CRC16 data size (bytes)
+			IRQ_SAMPLES = 8,	///< Interrupt entry measurements (the minimum is taken)
+		};
+		
+		static void Run(uint32_t* ramCycles, uint32_t* flashCycles);				/// Benchmark running
+		static void RunIrqEntry(uint32_t* directCycles, uint32_t* contextCycles);	/// Interrupt entry benchmark running
+	
+	private:
+		static uint32_t MeasureIrqEntry();				/// Interrupt entry measurement
+		static void Direct_Handler();					/// Direct vector handler
+		static void Context_Handler(void* context);		/// Context handler
+		
+		static volatile uint32_t EntryCycles;			///< Cycle counter at the handler entry
+};
+
+#endif /* __BENCHMARK_HPP */
@@ -0,0 +1,102 @@
+/**
+* @file event_queue.cpp
+* @brief Event queue implementation
+*/
+
+#include "event_queue.hpp"
+#include "critical_section.hpp"
+#include "timer_service.hpp"
+#include "system_timer.hpp"
+#include "power.hpp"
+#include "uart.hpp"
+#include "stm32l1xx.h"                  // Device header
+
+
+volatile uint8_t EventQueue::Queue[EVENT_COUNT];
+volatile uint8_t EventQueue::Head;
+volatile uint8_t EventQueue::Tail;
+volatile uint32_t EventQueue::Pending;
+
+
+/**
+* @brief Event queue initialization
+*/
+void EventQueue::Init()
+{
+	Head = 0;
+	Tail = 0;
+	Pending = 0;
+}
+
+
+/**
+* @brief Event posting (any context)
+* @param event - event (see Event_t)
+*/
+void EventQueue::Post(uint8_t event)
+{
+	if((event == EVENT_NONE) || (event >= EVENT_COUNT))
+	{
+		return;
+	}
+	
+	PriorityLock lock(LOCK_PRIORITY_EVENTS);
+	
+	if(!(Pending & (1UL << event)))
+	{
+		Pending |= 1UL << event;
+		Queue[Head] = event;
+		Head = (Head + 1) % EVENT_COUNT;
+	}
+}
+
+
+/**
+* @brief Oldest event getting
+* @param event - destination event pointer
+* @return true, if there was an event
+* @note The event may be posted again as soon as it is got
+*/
+bool EventQueue::Get(uint8_t* event)
+{
+	PriorityLock lock(LOCK_PRIORITY_EVENTS);
+	
+	if(!Pending)
+	{
+		return false;
+	}
+	
+	*event = Queue[Tail];
+	Tail = (Tail + 1) % EVENT_COUNT;
+	Pending &= ~(1UL << *event);
+	
+	return true;
+}
+
+
+/**
+* @brief Sleeping until an interrupt, if there are no events
+* @note Interrupts are masked between the check and WFI, so an event
+* posted in between still wakes the core up. STOP mode stops the system timer,
+* its time is added afterwards.
+*/
+void EventQueue::Wait()
+{
+	CriticalSection section;
+	
+	if(!Pending)
+	{
+		uint64_t now = SystemTimer::GetMicros();
+		uint64_t next = TimerService::GetNextAlarm();
+		
+		if(Uart1.IsTransmitting() || (next < now + STOP_THRESHOLD))
+		{
+			__WFI();
+		}
+		else
+		{
+			uint64_t timeout = next - now;
+			SystemTimer::Skip(Power::Stop(timeout < MAX_STOP ? (uint32_t)timeout : (uint32_t)MAX_STOP));
+		}
+	}
+}
@@ -0,0 +1,52 @@
+/**
+* @file event_queue.hpp
+* @brief Event queue header
+*/
+
+#ifndef __EVENT_QUEUE_HPP
+#define __EVENT_QUEUE_HPP
+
+#include <stdint.h>
+
+
+/// Events
+enum Event_t
+{
+	EVENT_NONE = 0,		///< No event
+	EVENT_CARD,			///< Card detect pin change
+	EVENT_BUS,			///< Bus line idle (data received)
+	EVENT_TIMER,		///< Software timers expired
+	EVENT_COUNT,		///< Events count
+};
+
+
+/**
+* @brief Event queue class
+* @note Events are posted by interrupt handlers and handled one by one
+* to completion by the main loop. An event already pending is not queued twice,
+* so the queue never overflows; handler must process all the work available.
+* When idle, the core enters STOP mode, unless a timer is due soon
+* or the bus is transmitting.
+*/
+class EventQueue
+{
+	public:
+		enum Options_t
+		{
+			STOP_THRESHOLD = 50000,		///< Min idle time for STOP mode (us.)
+			MAX_STOP = 4000000,			///< Max STOP mode time (us., below the watchdog period)
+		};
+		
+		static void Init();						/// Event queue initialization
+		static void Post(uint8_t event);		/// Event posting (any context)
+		static bool Get(uint8_t* event);		/// Oldest event getting
+		static void Wait();						/// Sleeping until an interrupt, if there are no events
+	
+	private:
+		static volatile uint8_t Queue[EVENT_COUNT];	///< Events ring
+		static volatile uint8_t Head;				///< Ring head (next posted event)
+		static volatile uint8_t Tail;				///< Ring tail (oldest event)
+		static volatile uint32_t Pending;			///< Pending events bitmap
+};
+
+#endif /* __EVENT_QUEUE_HPP */
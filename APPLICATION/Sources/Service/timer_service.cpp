@@ -0,0 +1,405 @@
+/**
+* @file timer_service.cpp
+* @brief Software timer service implementation
+*/
+
+#include "timer_service.hpp"
+#include "critical_section.hpp"
+#include "system_timer.hpp"
+#include "event_queue.hpp"
+#include "work_queue.hpp"
+#include "stm32l1xx.h"                  // Device header
+
+
+TimerService::Timer_t TimerService::Timers[MAX_TIMERS];
+TimerService::Link_t TimerService::Links[MAX_TIMERS + LISTS];
+uint32_t TimerService::Occupied[LEVELS];
+uint64_t TimerService::Current;
+uint64_t TimerService::NextAlarm;
+
+
+/**
+* @brief Timer service initialization
+*/
+void TimerService::Init()
+{
+	for(uint32_t index = 0; index < MAX_TIMERS; index++)
+	{
+		Timers[index].Callback = 0;
+		Timers[index].List = NONE;
+	}
+	
+	/// Empty lists point to their own heads
+	for(uint32_t index = MAX_TIMERS; index < MAX_TIMERS + LISTS; index++)
+	{
+		Links[index].Next = index;
+		Links[index].Prev = index;
+	}
+	
+	for(uint32_t level = 0; level < LEVELS; level++)
+	{
+		Occupied[level] = 0;
+	}
+	
+	Current = SystemTimer::GetMicros() >> TICK_SHIFT;
+	NextAlarm = ~(uint64_t)0;
+}
+
+
+/**
+* @brief Timer allocation
+* @param callback - callback, called from Process()
+* @param context - callback context
+* @return timer handle (NONE, if the pool is exhausted)
+*/
+TimerService::Handle_t TimerService::Create(Callback_t callback, void* context)
+{
+	for(uint32_t index = 0; index < MAX_TIMERS; index++)
+	{
+		if(!Timers[index].Callback)
+		{
+			Timers[index].Callback = callback;
+			Timers[index].Context = context;
+			Timers[index].List = NONE;
+			return index;
+		}
+	}
+	return NONE;
+}
+
+
+/**
+* @brief Timer starting
+* @param timer - timer handle
+* @param timeout - time to the first expiry (us.)
+* @param period - period (us., 0 for one-shot timer)
+* @note Restarts the running timer, the callback is never called earlier than timeout
+*/
+void TimerService::Start(Handle_t timer, uint32_t timeout, uint32_t period)
+{
+	if(timer >= MAX_TIMERS)
+	{
+		return;
+	}
+	
+	PriorityLock lock(LOCK_PRIORITY_TIMERS);
+	
+	if(Timers[timer].List != NONE)
+	{
+		Unlink(timer);
+	}
+	
+	/// Only Advance() moves the wheel, so the empty one is resynced after an idle period,
+	/// otherwise the next expiry walks the whole idle gap
+	uint64_t now = SystemTimer::GetMicros();
+	if(IsEmpty())
+	{
+		Current = now >> TICK_SHIFT;
+	}
+	
+	Timers[timer].Expiry = (now + timeout + (1 << TICK_SHIFT) - 1) >> TICK_SHIFT;
+	Timers[timer].Period = (period + (1 << TICK_SHIFT) - 1) >> TICK_SHIFT;
+	Place(timer);
+	Schedule();
+}
+
+
+/**
+* @brief Timer stopping
+* @param timer - timer handle
+* @note The alarm is not reprogrammed, a spurious wakeup is harmless
+*/
+void TimerService::Stop(Handle_t timer)
+{
+	if(timer >= MAX_TIMERS)
+	{
+		return;
+	}
+	
+	PriorityLock lock(LOCK_PRIORITY_TIMERS);
+	
+	if(Timers[timer].List != NONE)
+	{
+		Unlink(timer);
+	}
+}
+
+
+/**
+* @brief Check, whether the timer is running or expired
+* @param timer - timer handle
+* @return true, if the callback is still to be called
+*/
+bool TimerService::IsActive(Handle_t timer)
+{
+	return (timer < MAX_TIMERS) && (Timers[timer].List != NONE);
+}
+
+
+/**
+* @brief Expired timers callbacks calling
+* @note Periodic timers are re-placed relative to their expiry, so they do not drift
+*/
+void TimerService::Process()
+{
+	while(1)
+	{
+		uint8_t timer;
+		{
+			PriorityLock lock(LOCK_PRIORITY_TIMERS);
+			
+			timer = Links[MAX_TIMERS + EXPIRED].Next;
+			if(timer >= MAX_TIMERS)
+			{
+				return;
+			}
+			
+			Unlink(timer);
+			if(Timers[timer].Period)
+			{
+				Timers[timer].Expiry += Timers[timer].Period;
+				Place(timer);
+				Schedule();
+			}
+		}
+		
+		Timers[timer].Callback(Timers[timer].Context);
+	}
+}
+
+
+/**
+* @brief Alarm handler (system timer interrupt)
+* @note The wheel is advanced by the deferred work
+*/
+void TimerService::Handler()
+{
+	WorkQueue::Post(TimerService::Expire, 0);
+}
+
+
+/**
+* @brief Wheel advancing (deferred work)
+* @param context - not used
+* @note Posts EVENT_TIMER, if there are expired timers. Interrupts stay enabled:
+* the main loop changes the lists only with PendSV masked (LOCK_PRIORITY_TIMERS).
+*/
+void TimerService::Expire(void* /*context*/)
+{
+	Advance(SystemTimer::GetMicros() >> TICK_SHIFT);
+	Schedule();
+	
+	if(Links[MAX_TIMERS + EXPIRED].Next < MAX_TIMERS)
+	{
+		EventQueue::Post(EVENT_TIMER);
+	}
+}
+
+
+/**
+* @brief Wheel advancing up to the tick
+* @param tick - last tick to be processed
+* @note Higher level slot is cascaded, when all lower levels wrap.
+* Ticks with empty level 0 are skipped up to its wrap.
+*/
+void TimerService::Advance(uint64_t tick)
+{
+	while(Current <= tick)
+	{
+		uint32_t index = (uint32_t)Current & (SLOTS - 1);
+		
+		if(!index)
+		{
+			for(uint32_t level = 1; level < LEVELS; level++)
+			{
+				uint32_t slot = (uint32_t)(Current >> (LEVEL_SHIFT * level)) & (SLOTS - 1);
+				Cascade(level * SLOTS + slot);
+				if(slot)
+				{
+					break;
+				}
+			}
+		}
+		
+		if(!Occupied[0])
+		{
+			uint64_t next = (Current | (SLOTS - 1)) + 1;
+			Current = next > tick ? tick + 1 : next;
+			continue;
+		}
+		
+		/// Move the whole slot to the expired list
+		uint32_t head = MAX_TIMERS + index;
+		while(Links[head].Next != head)
+		{
+			uint8_t timer = Links[head].Next;
+			Unlink(timer);
+			Insert(EXPIRED, timer);
+		}
+		
+		Current++;
+	}
+}
+
+
+/**
+* @brief Alarm programming for the next non-empty slot
+* @note Level 0 slot expires at its tick, higher level slot
+* is due, when it is cascaded
+*/
+void TimerService::Schedule()
+{
+	uint64_t next = ~(uint64_t)0;
+	
+	if(Occupied[0])
+	{
+		next = Current + Distance(Occupied[0], (uint32_t)Current & (SLOTS - 1));
+	}
+	
+	for(uint32_t level = 1; level < LEVELS; level++)
+	{
+		if(Occupied[level])
+		{
+			/// The current slot is cascaded already, unless the current tick is its first one
+			uint32_t shift = LEVEL_SHIFT * level;
+			uint64_t base = (Current + ((uint64_t)1 << shift) - 1) >> shift;
+			uint64_t due = (base + Distance(Occupied[level], (uint32_t)base & (SLOTS - 1))) << shift;
+			if(due < next)
+			{
+				next = due;
+			}
+		}
+	}
+	
+	if(next == ~(uint64_t)0)
+	{
+		NextAlarm = next;
+		SystemTimer::CancelAlarm();
+	}
+	else
+	{
+		NextAlarm = next << TICK_SHIFT;
+		SystemTimer::SetAlarm(NextAlarm, TimerService::Handler);
+	}
+}
+
+
+/**
+* @brief Check, whether no timer is placed or expired
+* @return true, if the wheel and the expired list are empty
+*/
+bool TimerService::IsEmpty()
+{
+	for(uint32_t level = 0; level < LEVELS; level++)
+	{
+		if(Occupied[level])
+		{
+			return false;
+		}
+	}
+	return Links[MAX_TIMERS + EXPIRED].Next >= MAX_TIMERS;
+}
+
+
+/**
+* @brief Timer placing to the wheel
+* @param timer - timer index
+* @note Overdue timer is placed to the current slot,
+* timer beyond the wheel range - to the farthest slot
+*/
+void TimerService::Place(uint8_t timer)
+{
+	uint64_t expiry = Timers[timer].Expiry;
+	if(expiry < Current)
+	{
+		expiry = Current;
+	}
+	if(expiry - Current >= MAX_TICKS)
+	{
+		expiry = Current + MAX_TICKS - 1;
+	}
+	
+	uint64_t delta = expiry - Current;
+	uint32_t level = 0;
+	while((level < LEVELS - 1) && (delta >= ((uint64_t)1 << (LEVEL_SHIFT * (level + 1)))))
+	{
+		level++;
+	}
+	
+	uint32_t slot = (uint32_t)(expiry >> (LEVEL_SHIFT * level)) & (SLOTS - 1);
+	Insert(level * SLOTS + slot, timer);
+}
+
+
+/**
+* @brief Slot timers re-placing
+* @param list - slot list index
+*/
+void TimerService::Cascade(uint32_t list)
+{
+	uint32_t head = MAX_TIMERS + list;
+	while(Links[head].Next != head)
+	{
+		uint8_t timer = Links[head].Next;
+		Unlink(timer);
+		Place(timer);
+	}
+}
+
+
+/**
+* @brief Timer adding to the list tail
+* @param list - list index
+* @param timer - timer index
+*/
+void TimerService::Insert(uint32_t list, uint8_t timer)
+{
+	uint8_t head = MAX_TIMERS + list;
+	uint8_t tail = Links[head].Prev;
+	
+	Links[timer].Next = head;
+	Links[timer].Prev = tail;
+	Links[tail].Next = timer;
+	Links[head].Prev = timer;
+	Timers[timer].List = list;
+	
+	if(list < EXPIRED)
+	{
+		Occupied[list >> LEVEL_SHIFT] |= 1UL << (list & (SLOTS - 1));
+	}
+}
+
+
+/**
+* @brief Timer removing from its list
+* @param timer - timer index
+*/
+void TimerService::Unlink(uint8_t timer)
+{
+	uint32_t list = Timers[timer].List;
+	uint8_t head = MAX_TIMERS + list;
+	
+	Links[Links[timer].Prev].Next = Links[timer].Next;
+	Links[Links[timer].Next].Prev = Links[timer].Prev;
+	Timers[timer].List = NONE;
+	
+	if((list < EXPIRED) && (Links[head].Next == head))
+	{
+		Occupied[list >> LEVEL_SHIFT] &= ~(1UL << (list & (SLOTS - 1)));
+	}
+}
+
+
+/**
+* @brief Slots to the next non-empty slot
+* @param bitmap - non-empty slots bitmap (not 0)
+* @param from - first slot to be checked
+* @return distance (slots, cyclic)
+*/
+uint32_t TimerService::Distance(uint32_t bitmap, uint32_t from)
+{
+	uint32_t rotated = (bitmap >> from) | (bitmap << ((SLOTS - from) & (SLOTS - 1)));
+	
+	/// Count trailing zeros: the lowest set bit position
+	return 31 - __CLZ(rotated & (0 - rotated));
+}
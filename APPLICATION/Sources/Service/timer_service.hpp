@@ -0,0 +1,101 @@
+/**
+* @file timer_service.hpp
+* @brief Software timer service header
+*/
+
+#ifndef __TIMER_SERVICE_HPP
+#define __TIMER_SERVICE_HPP
+
+#include <stdint.h>
+
+
+/**
+* @brief Software timer service class
+* @note Hierarchical timer wheel over the SystemTimer clock: 4 levels of 32 slots,
+* level 0 slot is one tick (1024 us.), the whole wheel covers ~18 minutes
+* (longer timeouts are re-placed on cascading). Timers are linked into the slot
+* lists by index, so starting and stopping are O(1). The only hardware alarm
+* is programmed for the next non-empty slot, expired timers are moved to
+* the expired list by the deferred work (PendSV), callbacks are called by Process()
+* from the main loop on EVENT_TIMER.
+*/
+class TimerService
+{
+	public:
+		/// Timer callback
+		typedef void (*Callback_t)(void* context);
+		
+		/// Timer handle
+		typedef uint8_t Handle_t;
+		
+		enum Options_t
+		{
+			MAX_TIMERS = 16,		///< Timers pool size
+			NONE = 0xFF,			///< No timer (invalid handle)
+			TICK_SHIFT = 10,		///< Tick length (us., power of 2)
+			LEVEL_SHIFT = 5,		///< Slots per level (power of 2)
+			LEVELS = 4,				///< Wheel levels count
+		};
+		
+		static void Init();												/// Timer service initialization
+		static Handle_t Create(Callback_t callback, void* context);	/// Timer allocation
+		static void Start(Handle_t timer, uint32_t timeout, uint32_t period = 0);	/// Timer starting (us.)
+		static void Stop(Handle_t timer);								/// Timer stopping
+		static bool IsActive(Handle_t timer);							/// Check, whether the timer is running or expired
+		static void Process();											/// Expired timers callbacks calling
+		
+		/**
+		* @brief Get the next alarm time
+		* @return time of the next wheel processing (us., see SystemTimer::GetMicros()),
+		* all ones, if there are no running timers
+		*/
+		static uint64_t GetNextAlarm()
+		{
+			return NextAlarm;
+		};
+	
+	private:
+		enum
+		{
+			SLOTS = 1 << LEVEL_SHIFT,				///< Slots per level
+			EXPIRED = LEVELS * SLOTS,				///< Expired list index
+			LISTS = EXPIRED + 1,					///< Lists count (slots and expired)
+			MAX_TICKS = 1 << (LEVEL_SHIFT * LEVELS),	///< Wheel range (ticks)
+		};
+		
+		/// Timer
+		struct Timer_t
+		{
+			Callback_t Callback;	///< Callback (0, if the timer is not allocated)
+			void* Context;			///< Callback context
+			uint64_t Expiry;		///< Expiry tick
+			uint32_t Period;		///< Period (ticks, 0 for one-shot timer)
+			uint8_t List;			///< Current list (NONE, if the timer is stopped)
+		};
+		
+		/// List link (timers first, then list heads)
+		struct Link_t
+		{
+			uint8_t Next;
+			uint8_t Prev;
+		};
+		
+		static void Handler();								/// Alarm handler (system timer interrupt)
+		static void Expire(void* context);					/// Wheel advancing (deferred work)
+		static void Advance(uint64_t tick);					/// Wheel advancing up to the tick
+		static void Schedule();								/// Alarm programming for the next non-empty slot
+		static bool IsEmpty();								/// Check, whether no timer is placed or expired
+		static void Place(uint8_t timer);					/// Timer placing to the wheel
+		static void Cascade(uint32_t list);					/// Slot timers re-placing
+		static void Insert(uint32_t list, uint8_t timer);	/// Timer adding to the list tail
+		static void Unlink(uint8_t timer);					/// Timer removing from its list
+		static uint32_t Distance(uint32_t bitmap, uint32_t from);	/// Slots to the next non-empty slot
+		
+		static Timer_t Timers[MAX_TIMERS];					///< Timers pool
+		static Link_t Links[MAX_TIMERS + LISTS];			///< Timer and list head links
+		static uint32_t Occupied[LEVELS];					///< Non-empty slots bitmaps
+		static uint64_t Current;							///< Next tick to be processed
+		static uint64_t NextAlarm;							///< Next alarm time (us.)
+};
+
+#endif /* __TIMER_SERVICE_HPP */
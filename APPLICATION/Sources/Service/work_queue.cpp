@@ -0,0 +1,106 @@
+/**
+* @file work_queue.cpp
+* @brief Deferred interrupt work queue implementation
+*/
+
+#include "work_queue.hpp"
+#include "core.hpp"
+#include "stack.hpp"
+#include "stm32l1xx.h"                  // Device header
+
+
+WorkQueue::Work_t WorkQueue::Items[SIZE];
+volatile uint32_t WorkQueue::Head;
+volatile uint32_t WorkQueue::Tail;
+volatile uint32_t WorkQueue::MaxLatency;
+volatile uint32_t WorkQueue::Dropped;
+
+
+/**
+* @brief Work queue initialization
+*/
+void WorkQueue::Init()
+{
+	for(uint32_t index = 0; index < SIZE; index++)
+	{
+		Items[index].Handler = 0;
+	}
+	Head = 0;
+	Tail = 0;
+	MaxLatency = 0;
+	Dropped = 0;
+	
+	/// Enable the cycle counter for the latency measurement
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+	
+	Core::RegIrqHandler(PendSV_IRQn, WorkQueue::Handler, IRQ_PRIORITY_PENDSV);
+}
+
+
+/**
+* @brief Work item posting (any context)
+* @param handler - handler, called at PendSV priority
+* @param context - handler context
+* @return true, if the item is queued
+*/
+bool WorkQueue::Post(WorkHandler_t handler, void* context)
+{
+	/// Reserve a slot
+	uint32_t head;
+	do
+	{
+		head = __LDREXW(&Head);
+		if(head - Tail >= SIZE)
+		{
+			__CLREX();
+			Dropped++;
+			return false;
+		}
+	}
+	while(__STREXW(head + 1, &Head));
+	
+	/// Fill and publish the slot
+	Work_t* item = &Items[head & (SIZE - 1)];
+	item->Context = context;
+	item->Stamp = DWT->CYCCNT;
+	__DMB();
+	item->Handler = handler;
+	
+	SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+	return true;
+}
+
+
+/**
+* @brief PendSV interrupt handler
+* @note Stops at a reserved, but not yet published slot: its producer
+* (preempted thread code) pends PendSV again after publishing
+*/
+void WorkQueue::Handler()
+{
+	IsrGuard guard;
+	
+	while(Tail != Head)
+	{
+		Work_t* item = &Items[Tail & (SIZE - 1)];
+		WorkHandler_t handler = item->Handler;
+		if(!handler)
+		{
+			break;
+		}
+		
+		void* context = item->Context;
+		uint32_t latency = DWT->CYCCNT - item->Stamp;
+		if(latency > MaxLatency)
+		{
+			MaxLatency = latency;
+		}
+		
+		item->Handler = 0;
+		__DMB();
+		Tail++;
+		
+		handler(context);
+	}
+}
@@ -0,0 +1,69 @@
+/**
+* @file work_queue.hpp
+* @brief Deferred interrupt work queue header
+*/
+
+#ifndef __WORK_QUEUE_HPP
+#define __WORK_QUEUE_HPP
+
+#include <stdint.h>
+
+
+/**
+* @brief Deferred interrupt work queue class
+* @note Interrupt handlers post work items and return, the items are run
+* in order at PendSV (the lowest) priority. Slots are reserved with LDREX/STREX,
+* so posting never masks interrupts; an item is published by writing
+* its handler last. Latency from posting to running is measured in core clocks.
+*/
+class WorkQueue
+{
+	public:
+		/// Work item handler
+		typedef void (*WorkHandler_t)(void* context);
+		
+		enum Options_t
+		{
+			SIZE = 16,		///< Queue size (power of 2)
+		};
+		
+		static void Init();											/// Work queue initialization
+		static bool Post(WorkHandler_t handler, void* context);	/// Work item posting (any context)
+		
+		/**
+		* @brief Get the max posting to running latency
+		* @return latency (core clocks)
+		*/
+		static uint32_t GetMaxLatency()
+		{
+			return MaxLatency;
+		};
+		
+		/**
+		* @brief Get count of the items dropped on overflow
+		* @return items count
+		*/
+		static uint32_t GetDropped()
+		{
+			return Dropped;
+		};
+	
+	private:
+		/// Work item
+		struct Work_t
+		{
+			volatile WorkHandler_t Handler;	///< Handler (0, while the item is not published)
+			void* Context;					///< Handler context
+			uint32_t Stamp;					///< Posting time (DWT cycle counter)
+		};
+		
+		static void Handler();						/// PendSV interrupt handler
+		
+		static Work_t Items[SIZE];					///< Items ring
+		static volatile uint32_t Head;				///< Next reserved slot (producers)
+		static volatile uint32_t Tail;				///< Next item to run (PendSV)
+		static volatile uint32_t MaxLatency;		///< Max latency (core clocks)
+		static volatile uint32_t Dropped;			///< Dropped items count
+};
+
+#endif /* __WORK_QUEUE_HPP */
@@ -0,0 +1,48 @@
+/**
+* @file memory_map.h
+* @brief SRAM map and RAM budgets
+* @note Shared by the scatter file (preprocessed by armcc) and the sources,
+* so it holds preprocessor definitions only
+*/
+
+#ifndef __MEMORY_MAP_H
+#define __MEMORY_MAP_H
+
+/// SRAM (16 kbytes)
+#define MAP_RAM_BASE			0x20000000
+#define MAP_RAM_SIZE			0x4000
+
+/// Interrupt vectors (filled by the startup code, VTOR points here)
+#define MAP_IRQ_BASE			MAP_RAM_BASE
+#define MAP_IRQ_SIZE			0x0100
+
+/// RAM code (copied by __main)
+#define MAP_RAM_CODE_BASE		(MAP_IRQ_BASE + MAP_IRQ_SIZE)
+#define MAP_RAM_CODE_SIZE		0x0400
+
+/// RW and ZI data
+#define MAP_RW_BASE				(MAP_RAM_CODE_BASE + MAP_RAM_CODE_SIZE)
+#define MAP_RW_SIZE				0x2700
+
+/// No-init data (see Retained)
+#define MAP_NOINIT_BASE			(MAP_RW_BASE + MAP_RW_SIZE)
+#define MAP_NOINIT_SIZE			0x0400
+
+/// Stack (grows down from the SRAM end), there is no heap
+#define MAP_STACK_BASE			(MAP_NOINIT_BASE + MAP_NOINIT_SIZE)
+#define MAP_STACK_SIZE			0x1000
+
+
+/// Per-module RAM budgets (bytes), checked by the owners
+#define UART_RAM_BUDGET			0x0C20	///< Bus UART (RX and TX DMA buffers)
+#define ISO7816_RAM_BUDGET		0x00C0	///< Card interface (RX ring and TX queue)
+#define CACHE_RAM_BUDGET		0x0310	///< Decision cache (no-init)
+#define JOURNAL_RAM_BUDGET		0x0090	///< Journal RAM ring (no-init)
+#define RETAINED_RAM_BUDGET		0x0030	///< Retained region state and the main loop flags (no-init)
+#define TRACE_RAM_BUDGET		0x0210	///< Trace records ring
+#define PROFILER_RAM_BUDGET		0x0220	///< PC samples histogram
+#define METRICS_RAM_BUDGET		0x00A0	///< Counters, gauges and latency histograms
+#define LOG_RAM_BUDGET			0x0110	///< Tokenized log messages ring
+#define CAPTURE_RAM_BUDGET		0x0410	///< Card and bus bytes capture ring
+
+#endif /* __MEMORY_MAP_H */
@@ -3,8 +3,13 @@
 * @brief Start initialization
 */
 
+#include "core.hpp"
+#include "stack.hpp"
 #include "stm32l1xx.h"                  // Device header
 
+/// There is no heap, any heap function use fails at link time
+#pragma import(__use_no_heap_region)
+
 extern "C" void __main();
 extern "C" void init() __attribute__((section(".init_section")));
 
@@ -13,21 +18,18 @@ extern "C" void init() __attribute__((section(".init_section")));
 */
 extern "C" void init(void)
 {
-	/// Enable HSE
-	RCC->CR |= RCC_CR_HSEON;
-	
-	/// Wait until HSE readiness
-	while(!(RCC->CR & RCC_CR_HSERDY));
+	/// Start the cycle counter for the boot time measurement (see Boot)
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CYCCNT = 0;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
 	
-	/// Choose HSE as the main clock source
-	RCC->CFGR |= RCC_CFGR_SW_HSE;
+	/// Paint the free stack for the high-water measurement
+	Stack::Paint();
 	
-	/// Enable LSI
+	/// Enable HSE and LSI, they start up while the rest is tuned
+	RCC->CR |= RCC_CR_HSEON;
 	RCC->CSR |= RCC_CSR_LSION;
 	
-	/// Wait until LSI readiness
-	while(!(RCC->CSR & RCC_CSR_LSIRDY));
-	
 	/// Set prescalers
 	RCC->CFGR &= ~(RCC_CFGR_PPRE2 | RCC_CFGR_PPRE1 | RCC_CFGR_HPRE);
 	
@@ -42,26 +44,41 @@ extern "C" void init(void)
 	/// Disable LSE
 	RCC->CSR &= ~RCC_CSR_LSEON;
 	
-	/// Enable RTC
-	RCC->CSR |= RCC_CSR_RTCRST | RCC_CSR_RTCEN | RCC_CSR_RTCSEL_1 | RCC_CSR_RTCSEL_0;
-	RCC->CSR |= RCC_CSR_RMVF;
+	/// Enable RTC (clocked by LSI), keep the running calendar across resets.
+	/// The RTC starts counting, when LSI is ready (Rtc waits for it on the first access)
+	if(!(RCC->CSR & RCC_CSR_RTCEN))
+	{
+		RCC->CSR |= RCC_CSR_RTCRST;
+		RCC->CSR &= ~RCC_CSR_RTCRST;
+		RCC->CSR |= RCC_CSR_RTCEN | RCC_CSR_RTCSEL_1;
+	}
 	
 	/// Cancel BDCR register writing
 	PWR->CR &= ~PWR_CR_DBP;
 	
+	/// Move the vector table to SRAM (see Core)
+	Core::InitVectors();
+	
+	/// 12 MHz in voltage range 2 (reset value) needs 1 flash wait state,
+	/// which needs 64-bit access (see Clock, CLOCK_BALANCED)
+	FLASH->ACR |= FLASH_ACR_ACC64;
+	FLASH->ACR |= FLASH_ACR_PRFTEN | FLASH_ACR_LATENCY;
+	while(!(FLASH->ACR & FLASH_ACR_LATENCY));
+	
+	/// Wait until HSE readiness
+	while(!(RCC->CR & RCC_CR_HSERDY));
+	
+	/// Choose HSE as the main clock source
+	RCC->CFGR |= RCC_CFGR_SW_HSE;
+	while((RCC->CFGR & RCC_CFGR_SWS) != RCC_CFGR_SWS_HSE);
+	
+	/// Convert the cycles counted from MSI (2.097152 MHz after reset) to HSE cycles
+	DWT->CYCCNT = (uint32_t)(((uint64_t)DWT->CYCCNT * HSE_VALUE) / 2097152);
+	
 	/// Enable HSE failure protection
 	/// (unmasked NMI interrupt)
 	RCC->CR |= RCC_CR_CSSON;
 	
-	/// Copy vector table to SRAM
-	for(uint16_t index = 0; index < 256; index++)
-	{
-		*(volatile char *)(SRAM_BASE + index) = *(volatile char *)(FLASH_BASE + index);
-	}
-	
-	/// Enable MEMORY MAPPING
-	SYSCFG->MEMRMP |= SYSCFG_MEMRMP_MEM_MODE_1 | SYSCFG_MEMRMP_MEM_MODE_0;
-	
 	/// Start static objects initialization
 	__main();
 }
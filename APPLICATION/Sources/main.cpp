@@ -16,81 +16,643 @@
 #include "board.hpp"
 #include "watchdog_timer.hpp"
 #include "system_timer.hpp"
+#include "timer_service.hpp"
+#include "event_queue.hpp"
+#include "work_queue.hpp"
+#include "benchmark.hpp"
 #include "data_eeprom.hpp"
+#include "rtc.hpp"
+#include "power.hpp"
+#include "clock.hpp"
+#include "boot.hpp"
+#include "retained.hpp"
+#include "stack.hpp"
+#include "trace.hpp"
+#include "profiler.hpp"
+#include "metrics.hpp"
+#include "log.hpp"
+#include "capture.hpp"
 #include "uart.hpp"
 #include "iso7816.hpp"
+#include "bus.hpp"
+#include "credentials.hpp"
+#include "credential_db.hpp"
+#include "decision_cache.hpp"
+#include "journal.hpp"
 #include "options.hpp"
 #include "stm32l1xx.h"                  // Device header
 #include <string.h>
-#include <stdio.h>
 
 
 const char MF[] = {0x3F, 0x00};
 const char EFiccid[] = {0x2F, 0xE2};
 
 
+/// Application options
+enum Options_t
+{
+	DECISION_TIMEOUT = 200000,	///< Controller decision timeout (us.)
+	CARD_DEBOUNCE = 20000,		///< Card detect debounce time (us.)
+};
+
+
+/// Log messages
+LOG_FORMAT(LogCardFailed, "card reading failed, status %u");
+
+
+static bool CardServed RETAINED;				///< Inserted card is served already (retained)
+static TimerService::Handle_t DebounceTimer;	///< Card detect debounce timer
+
+
 /**
-* @brief Main application procedure
+* @brief Credential reading
+* @param credential - destination credential pointer
+* @return reader status (see ReaderStatus_t)
 */
-int main(void)
+static ReaderStatus_t ReadCredential(Credential_t* credential)
 {
-	Board::Init();
-	
-#ifndef __DEBUG__
-	WatchdogTimer::Init();
-#endif
-	
-	SystemTimer::Init();
-	
-	char printbuffer[64];
-	memset(printbuffer, 0, sizeof(printbuffer));
+	ReaderStatus_t status = READER_OK;
 	
 	if(ISO7816_1.ActivateCard())
 	{
+		Boot::Mark(BOOT_ATR);
+		
 		for(uint8_t result = 0; result < 1; result++)
 		{
 			if(!ISO7816_1.SelectFile(0xA0, 0x00, 0x00, MF, sizeof(MF)))
 			{
-				sprintf(printbuffer, "MF file selection error!\r\n");
+				status = READER_MF_ERROR;
 				break;
 			}
 			
 			if(!ISO7816_1.SelectFile(0xA0, 0x00, 0x00, EFiccid, sizeof(EFiccid)))
 			{
-				sprintf(printbuffer, "EFiccid file selection error!\r\n");
+				status = READER_EF_ERROR;
+				break;
+			}
+			
+			memset(credential, 0, sizeof(Credential_t));
+			if(ISO7816_1.ReadBinary(0xA0, credential->Value, sizeof(credential->Value)) == -1)
+			{
+				status = READER_READ_ERROR;
+				break;
+			}
+		}
+	}
+	else
+	{
+		Metrics::Count(METRIC_ATR_FAILURES);
+		status = READER_ACTIVATION_ERROR;
+	}
+	
+	ISO7816_1.DeactivateCard();
+	
+	return status;
+}
+
+
+/**
+* @brief Clock profile switching
+* @param profile - clock profile (see ClockProfile_t)
+* @note Waits for the bus transmission end, as the bus baudrate is recalculated
+*/
+static void SetClockProfile(uint8_t profile)
+{
+	while(Uart1.IsTransmitting());
+	
+	Clock::SetProfile(profile);
+}
+
+
+/**
+* @brief Bus frame processing
+* @param frame - received frame pointer
+*/
+static void ProcessFrame(const BusFrame_t* frame)
+{
+	switch(frame->Header.Command)
+	{
+		case BUS_SET_TIME:
+		{
+			if(frame->Header.Length < sizeof(uint32_t))
+			{
+				Bus::Reply(frame, BUS_NACK);
+				break;
+			}
+			
+			uint32_t time;
+			memcpy(&time, frame->Data, sizeof(time));
+			Rtc::SetTime(time);
+			Retained::Seal();
+			Bus::Reply(frame, BUS_ACK);
+			break;
+		}
+		
+		case BUS_JOURNAL_READ:
+		{
+			Journal::Upload(frame);
+			break;
+		}
+		
+		case BUS_JOURNAL_ACK:
+		{
+			Journal::Acknowledge(frame);
+			break;
+		}
+		
+		case BUS_CREDENTIAL_WRITE:
+		{
+			Credentials::ProcessWrite(frame);
+			break;
+		}
+		
+		case BUS_CREDENTIAL_RESOLVE:
+		{
+			Credentials::ProcessResolve(frame);
+			break;
+		}
+		
+		case BUS_DB_BEGIN:
+		{
+			CredentialDb::ProcessBegin(frame);
+			break;
+		}
+		
+		case BUS_DB_WRITE:
+		{
+			CredentialDb::ProcessWrite(frame);
+			break;
+		}
+		
+		case BUS_DB_COMMIT:
+		{
+			// Database CRC checking runs on the fastest clock
+			uint8_t profile = Clock::GetProfile();
+			SetClockProfile(CLOCK_PERFORMANCE);
+			CredentialDb::ProcessCommit(frame);
+			SetClockProfile(profile);
+			break;
+		}
+		
+		case BUS_CACHE_INVALIDATE:
+		{
+			DecisionCache::ProcessInvalidate(frame);
+			break;
+		}
+		
+		case BUS_POWER_READ:
+		{
+			uint32_t data[3];
+			data[0] = Power::GetStopCount();
+			data[1] = Power::GetWakeLatency();
+			data[2] = Power::GetMaxWakeLatency();
+			Bus::Reply(frame, BUS_POWER_DATA, data, sizeof(data));
+			break;
+		}
+		
+		case BUS_BOOT_READ:
+		{
+			uint32_t data[BOOT_PHASES];
+			for(uint8_t phase = 0; phase < BOOT_PHASES; phase++)
+			{
+				data[phase] = Boot::GetTime(phase);
+			}
+			Bus::Reply(frame, BUS_BOOT_DATA, data, sizeof(data));
+			break;
+		}
+		
+		case BUS_RESET_READ:
+		{
+			uint32_t data[3];
+			data[0] = Retained::GetResetReason();
+			data[1] = Retained::GetResetCount();
+			data[2] = Retained::IsRestored();
+			Bus::Reply(frame, BUS_RESET_DATA, data, sizeof(data));
+			break;
+		}
+		
+		case BUS_STACK_READ:
+		{
+			uint32_t data[3];
+			data[0] = Stack::GetSize();
+			data[1] = Stack::GetHighWater();
+			data[2] = Stack::GetMaxNesting();
+			Bus::Reply(frame, BUS_STACK_DATA, data, sizeof(data));
+			break;
+		}
+		
+		case BUS_BENCHMARK:
+		{
+			uint32_t data[3];
+			data[0] = Benchmark::SAMPLE_SIZE;
+			Benchmark::Run(&data[1], &data[2]);
+			Bus::Reply(frame, BUS_BENCHMARK_DATA, data, sizeof(data));
+			break;
+		}
+		
+		case BUS_IRQ_BENCHMARK:
+		{
+			uint32_t data[2];
+			Benchmark::RunIrqEntry(&data[0], &data[1]);
+			Bus::Reply(frame, BUS_IRQ_BENCHMARK_DATA, data, sizeof(data));
+			break;
+		}
+		
+		case BUS_TRACE_MASK:
+		{
+			if(frame->Header.Length < sizeof(uint32_t))
+			{
+				Bus::Reply(frame, BUS_NACK);
+				break;
+			}
+			
+			uint32_t mask;
+			memcpy(&mask, frame->Data, sizeof(mask));
+			Trace::SetMask(mask);
+			Bus::Reply(frame, BUS_ACK);
+			break;
+		}
+		
+		case BUS_TRACE_READ:
+		{
+			uint32_t frequency = Clock::GetFrequency();
+			uint16_t lost;
+			TraceRecord_t records[(Bus::MAX_DATA - sizeof(frequency) - sizeof(lost)) / sizeof(TraceRecord_t)];
+			uint32_t count = Trace::Read(records, sizeof(records) / sizeof(records[0]), &lost);
+			
+			uint8_t data[Bus::MAX_DATA];
+			memcpy(&data[0], &frequency, sizeof(frequency));
+			memcpy(&data[sizeof(frequency)], &lost, sizeof(lost));
+			memcpy(&data[sizeof(frequency) + sizeof(lost)], records, count * sizeof(TraceRecord_t));
+			Bus::Reply(frame, BUS_TRACE_DATA, data, sizeof(frequency) + sizeof(lost) + count * sizeof(TraceRecord_t));
+			break;
+		}
+		
+		case BUS_PROFILE_START:
+		{
+			uint16_t rate;
+			if(frame->Header.Length < sizeof(rate))
+			{
+				Bus::Reply(frame, BUS_NACK);
 				break;
 			}
 			
-			char iccid[9];
-			memset(iccid, 0, sizeof(iccid));
-			if(ISO7816_1.ReadBinary(0xA0, iccid, 9) == -1)
+			memcpy(&rate, frame->Data, sizeof(rate));
+			if(!rate)
+			{
+				Profiler::Stop();
+			}
+			else if(!Profiler::Start(rate))
+			{
+				Bus::Reply(frame, BUS_NACK);
+				break;
+			}
+			
+			Bus::Reply(frame, BUS_ACK);
+			break;
+		}
+		
+		case BUS_PROFILE_READ:
+		{
+			ProfileHeader_t header;
+			uint16_t counters[(Bus::MAX_DATA - sizeof(header)) / sizeof(uint16_t)];
+			uint32_t count = Profiler::Read(frame->Header.Length ? frame->Data[0] : 0, &header, counters, sizeof(counters) / sizeof(counters[0]));
+			
+			uint8_t data[Bus::MAX_DATA];
+			memcpy(&data[0], &header, sizeof(header));
+			memcpy(&data[sizeof(header)], counters, count * sizeof(uint16_t));
+			Bus::Reply(frame, BUS_PROFILE_DATA, data, sizeof(header) + count * sizeof(uint16_t));
+			break;
+		}
+		
+		case BUS_METRICS_READ:
+		{
+			Metrics::Snapshot_t snapshot;
+			Metrics::Read(&snapshot);
+			Bus::Reply(frame, BUS_METRICS_DATA, &snapshot, sizeof(snapshot));
+			break;
+		}
+		
+		case BUS_LOG_READ:
+		{
+			uint16_t lost;
+			uint32_t words[(Bus::MAX_DATA - sizeof(lost)) / sizeof(uint32_t)];
+			uint32_t count = Log::Read(words, sizeof(words) / sizeof(words[0]), &lost);
+			
+			uint8_t data[Bus::MAX_DATA];
+			memcpy(&data[0], &lost, sizeof(lost));
+			memcpy(&data[sizeof(lost)], words, count * sizeof(uint32_t));
+			Bus::Reply(frame, BUS_LOG_DATA, data, sizeof(lost) + count * sizeof(uint32_t));
+			break;
+		}
+		
+		case BUS_CAPTURE_START:
+		{
+			if(frame->Header.Length < 1)
 			{
-				sprintf(printbuffer, "ICCID reading error!\r\n");
+				Bus::Reply(frame, BUS_NACK);
 				break;
 			}
 			
-			char* ptr = printbuffer;
-			for(uint8_t index = 0; index < 9; index++)
+			/// The acknowledgement is not captured
+			Bus::Reply(frame, BUS_ACK);
+			Capture::Start(frame->Data[0]);
+			break;
+		}
+		
+		case BUS_CAPTURE_READ:
+		{
+			uint16_t lost;
+			CaptureRecord_t records[(Bus::MAX_DATA - sizeof(lost)) / sizeof(CaptureRecord_t)];
+			uint32_t count = Capture::Read(records, sizeof(records) / sizeof(records[0]), &lost);
+			
+			uint8_t data[Bus::MAX_DATA];
+			memcpy(&data[0], &lost, sizeof(lost));
+			memcpy(&data[sizeof(lost)], records, count * sizeof(CaptureRecord_t));
+			Bus::Reply(frame, BUS_CAPTURE_DATA, data, sizeof(lost) + count * sizeof(CaptureRecord_t));
+			break;
+		}
+		
+		case BUS_CLOCK_PROFILE:
+		{
+			if(frame->Header.Length < 1 || frame->Data[0] >= CLOCK_PROFILES)
 			{
-				ptr += sprintf(ptr, "%u%u", iccid[index] & 0x0F, iccid[index] >> 4);
+				Bus::Reply(frame, BUS_NACK);
+				break;
 			}
 			
-			ptr += sprintf(ptr, "\r\n");
+			SetClockProfile(frame->Data[0]);
+			Bus::Reply(frame, BUS_ACK);
+			break;
+		}
+		
+		default:
+		{
+			Bus::Reply(frame, BUS_NACK);
+			break;
+		}
+	}
+}
+
+
+/**
+* @brief Controller decision request
+* @param id - credential identifier
+* @param credential - credential pointer
+* @return controller decision or DECISION_NONE, if the controller doesn't answer
+* @note Other frames received while waiting are processed as usual
+*/
+static Decision_t AskController(CredentialId_t id, const Credential_t* credential)
+{
+	uint8_t data[sizeof(CredentialId_t) + sizeof(Credential_t)];
+	memcpy(data, &id, sizeof(id));
+	memcpy(&data[sizeof(id)], credential, sizeof(Credential_t));
+	uint8_t sequence = Bus::Request(BUS_DECISION_REQUEST, data, sizeof(data));
+	
+	/// Wait for the decision (CredentialId_t, decision, TTL)
+	for(uint64_t waitTo = SystemTimer::GetMicros() + DECISION_TIMEOUT; SystemTimer::GetMicros() < waitTo;)
+	{
+		BusFrame_t frame;
+		if(!Bus::Receive(&frame))
+		{
+			continue;
+		}
+		
+		if((frame.Header.Command != BUS_DECISION) || (frame.Header.Sequence != sequence))
+		{
+			ProcessFrame(&frame);
+			continue;
+		}
+		
+		if(frame.Header.Length < sizeof(CredentialId_t) + 1 + sizeof(uint16_t))
+		{
+			break;
+		}
+		
+		Decision_t decision = (Decision_t)frame.Data[sizeof(CredentialId_t)];
+		uint16_t ttl;
+		memcpy(&ttl, &frame.Data[sizeof(CredentialId_t) + 1], sizeof(ttl));
+		DecisionCache::Insert(id, decision, ttl);
+		return decision;
+	}
+	
+	return DECISION_NONE;
+}
+
+
+/**
+* @brief Access decision
+* @param id - credential identifier
+* @param credential - credential pointer
+* @return decision of the local table, the flash database, the decision cache or the controller
+* @note The database holds granted credentials only, a card added after its loading
+* is missing there, so a miss falls through to the cache and the controller
+*/
+static Decision_t Decide(CredentialId_t id, const Credential_t* credential)
+{
+	/// Local credential table
+	Decision_t decision = Credentials::Decide(id);
+	if(decision != DECISION_NONE)
+	{
+		return decision;
+	}
+	
+	/// Flash credential database
+	if(CredentialDb::Contains(credential))
+	{
+		return DECISION_GRANTED;
+	}
+	
+	/// Recent controller decisions
+	if(DecisionCache::Lookup(id, &decision))
+	{
+		return decision;
+	}
+	
+	return AskController(id, credential);
+}
+
+
+/**
+* @brief Inserted card serving (debounce timer callback)
+* @param context - not used
+* @note Reads the card, decides and records the event, once per insertion
+*/
+static void ServeCard(void* /*context*/)
+{
+	if(CardServed || !Board::IsCardPresent())
+	{
+		return;
+	}
+	CardServed = true;
+	Retained::Seal();
+	Trace::Record(TRACE_TAP);
+	Metrics::Count(METRIC_TAPS);
+	uint64_t start = SystemTimer::GetMicros();
+	
+	Credential_t credential;
+	JournalRecord_t record;
+	record.Status = ReadCredential(&credential);
+	record.Credential = (record.Status == READER_OK) ? Credentials::Encode(&credential) : (CredentialId_t)CREDENTIAL_NONE;
+	record.Decision = (record.Status == READER_OK) ? Decide(record.Credential, &credential) : DECISION_NONE;
+	Trace::Record(TRACE_DECISION, record.Decision);
+	if(record.Status != READER_OK)
+	{
+		Log::Write(LogCardFailed, record.Status);
+	}
+	uint32_t elapsed = (uint32_t)(SystemTimer::GetMicros() - start);
+	Metrics::Observe(METRIC_TAP_TIME, elapsed);
+	Metrics::Set(METRIC_LAST_TAP, elapsed);
+	record.Timestamp = Rtc::GetTime();
+	Journal::Add(&record);
+}
+
+
+/**
+* @brief Card detect change processing (EVENT_CARD)
+* @note The card is served, when the switch is stable for CARD_DEBOUNCE
+*/
+static void ProcessCard()
+{
+	if(Board::IsCardPresent())
+	{
+		if(!CardServed)
+		{
+			TimerService::Start(DebounceTimer, CARD_DEBOUNCE);
 		}
 	}
 	else
 	{
-		sprintf(printbuffer, "Card activation error!\r\n");
+		CardServed = false;
+		Retained::Seal();
+		TimerService::Stop(DebounceTimer);
+	}
+}
+
+
+/**
+* @brief Received bus frames processing (EVENT_BUS)
+*/
+static void ProcessBus()
+{
+	BusFrame_t frame;
+	while(Bus::Receive(&frame))
+	{
+		ProcessFrame(&frame);
+	}
+}
+
+
+/**
+* @brief Card detect interrupt notification
+*/
+static void CardDetectNotify()
+{
+	EventQueue::Post(EVENT_CARD);
+}
+
+
+/**
+* @brief Bus line idle interrupt notification
+*/
+static void BusIdleNotify()
+{
+	EventQueue::Post(EVENT_BUS);
+}
+
+
+/**
+* @brief Main application procedure
+*/
+int main(void)
+{
+	Boot::Mark(BOOT_STARTUP);
+	
+	Board::Init();
+	Trace::Init();
+	
+#ifndef __DEBUG__
+	WatchdogTimer::Init();
+#endif
+	
+	Boot::Mark(BOOT_BOARD);
+	
+	EventQueue::Init();
+	WorkQueue::Init();
+	SystemTimer::Init();
+	Rtc::Init();
+	
+	/// The inserted card flag is restored with the cache and the journal,
+	/// so the card served before a warm reset is not served again.
+	/// The timer wheel starts after the monotonic time is resumed.
+	if(!Retained::Init())
+	{
+		CardServed = false;
+		Retained::Seal();
 	}
+	TimerService::Init();
 	
-	ISO7816_1.DeactivateCard();
+	Power::Init();
+	Profiler::Init();
+	Bus::Init(DEFAULT_DEVICE_ID);
+	Boot::Mark(BOOT_SERVICES);
+	
+	Credentials::Init();
+	CredentialDb::Init();
+	DecisionCache::Init();
+	Journal::Init();
+	Boot::Mark(BOOT_DATA);
 	
-	Uart1.Transmit(printbuffer, strlen(printbuffer));
+	DebounceTimer = TimerService::Create(ServeCard, 0);
+	Board::SetCardDetectHandler(CardDetectNotify);
+	Uart1.SetIdleHandler(BusIdleNotify);
 	
+	/// The card inserted before the power-on has settled already, serve it without debouncing
+	ServeCard(0);
+	Boot::Finish();
+	
+	/// The card may be inserted and the data may be received before
+	EventQueue::Post(EVENT_CARD);
+	EventQueue::Post(EVENT_BUS);
+	
+	/// Run-to-completion event loop
 	while(1)
 	{
 #ifndef __DEBUG__
 		WatchdogTimer::Kick();
 #endif
+		
+		uint8_t event;
+		while(EventQueue::Get(&event))
+		{
+			switch(event)
+			{
+				case EVENT_CARD:
+				{
+					ProcessCard();
+					break;
+				}
+				
+				case EVENT_BUS:
+				{
+					ProcessBus();
+					break;
+				}
+				
+				case EVENT_TIMER:
+				{
+					TimerService::Process();
+					break;
+				}
+				
+				default:
+				{
+					break;
+				}
+			}
+		}
+		
+		/// Sleep until an interrupt (the system timer overflow wakes at least every 65 ms.)
+		EventQueue::Wait();
 	}
 }
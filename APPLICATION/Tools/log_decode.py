@@ -0,0 +1,110 @@
+#!/usr/bin/env python3
+"""
+@file log_decode.py
+@brief Tokenized log decoder (see Sources/HAL/log.hpp)
+
+Usage: log_decode.py <application.axf> <log.txt>
+
+The input holds the data of BUS_LOG_DATA frames, one frame per line
+in hex (spaces allowed), in the reading order. The format strings are
+read from the image the firmware was built with, so the image must match
+the running firmware. Prints one line per message.
+"""
+
+import re
+import struct
+import sys
+
+
+FLASH_BASE = 0x08000000
+
+CONVERSION = re.compile(r'%([-+ #0]*)(\d*)(?:\.(\d+))?(?:hh|h|ll|l|z)?([diuxXc%])')
+
+
+class Image:
+	"""ELF image loadable segments"""
+
+	def __init__(self, path):
+		data = open(path, 'rb').read()
+		if data[:4] != b'\x7fELF' or data[4] != 1:
+			raise ValueError('%s is not an ELF32 image' % path)
+		phoff, = struct.unpack_from('<I', data, 28)
+		phentsize, phnum = struct.unpack_from('<HH', data, 42)
+		self.segments = []
+		for index in range(phnum):
+			kind, offset, vaddr, paddr, filesz = struct.unpack_from('<IIIII', data, phoff + index * phentsize)
+			if kind == 1 and filesz:
+				self.segments.append((vaddr, data[offset:offset + filesz]))
+
+	def string(self, address):
+		for base, contents in self.segments:
+			if base <= address < base + len(contents):
+				end = contents.find(b'\0', address - base)
+				return contents[address - base:end if end >= 0 else len(contents)].decode('latin-1')
+		return None
+
+
+def format_message(text, arguments):
+	"""printf-like formatting of the integer arguments"""
+	values = list(arguments)
+
+	def convert(match):
+		flags, width, precision, kind = match.groups()
+		if kind == '%':
+			return '%'
+		value = values.pop(0) if values else 0
+		if kind in 'di':
+			value = value - (1 << 32) if value & 0x80000000 else value
+		spec = '%' + flags + width + ('.' + precision if precision else '')
+		if kind == 'c':
+			return chr(value & 0xFF)
+		return (spec + ('d' if kind in 'diu' else kind)) % value
+
+	result = CONVERSION.sub(convert, text)
+	if values:
+		result += ' [%s]' % ', '.join('0x%X' % value for value in values)
+	return result
+
+
+def parse(lines):
+	"""Frames to messages: (format offset, arguments), None marks dropped messages"""
+	messages = []
+	for line in lines:
+		data = bytes.fromhex(line.split('#', 1)[0].strip())
+		if len(data) < 2:
+			continue
+		lost = int.from_bytes(data[0:2], 'little')
+		if lost:
+			messages.append((None, lost))
+		words = [int.from_bytes(data[offset:offset + 4], 'little') for offset in range(2, len(data) - 3, 4)]
+		index = 0
+		while index < len(words):
+			header = words[index]
+			count = header >> 16
+			messages.append((header & 0xFFFF, words[index + 1:index + 1 + count]))
+			index += 1 + count
+	return messages
+
+
+def main():
+	if len(sys.argv) != 3:
+		print(__doc__)
+		return 2
+
+	image = Image(sys.argv[1])
+	source = sys.stdin if sys.argv[2] == '-' else open(sys.argv[2])
+	for offset, arguments in parse(source):
+		if offset is None:
+			print('--- %d messages dropped ---' % arguments)
+			continue
+		text = image.string(FLASH_BASE + offset)
+		if text is None:
+			print('unknown format 0x%08X %s' % (FLASH_BASE + offset, ' '.join('0x%X' % value for value in arguments)))
+		else:
+			print(format_message(text, arguments))
+
+	return 0
+
+
+if __name__ == '__main__':
+	sys.exit(main())
@@ -0,0 +1,64 @@
+#!/usr/bin/env python3
+"""
+@file memory_report.py
+@brief SRAM use report from the linker map
+
+Usage: memory_report.py <application.map>
+
+Prints RAM use (RW + ZI) per object and per execution region against
+the region sizes from the scatter file (see Sources/Startup/memory_map.h).
+Runs after the build (uVision "After Build" user command).
+Exit code is 1, if a RAM region is overflowed.
+"""
+
+import re
+import sys
+
+
+RAM_START = 0x20000000
+
+REGION = re.compile(r'Execution Region (\w+) \(Exec base: (0x[0-9a-fA-F]+),.*?Size: (0x[0-9a-fA-F]+), Max: (0x[0-9a-fA-F]+)')
+COMPONENT = re.compile(r'^\s*(\d+)\s+(\d+)\s+(\d+)\s+(\d+)\s+(\d+)\s+(\d+)\s+(\S+\.o)\s*$')
+
+
+def main():
+	if len(sys.argv) != 2:
+		print(__doc__)
+		return 2
+
+	text = open(sys.argv[1], errors='replace').read()
+
+	regions = []
+	for name, base, size, limit in REGION.findall(text):
+		if int(base, 16) >= RAM_START:
+			regions.append((name, int(base, 16), int(size, 16), int(limit, 16)))
+
+	objects = []
+	section = text.split('Image component sizes', 1)[-1].split('Library Member Name', 1)[0]
+	for line in section.splitlines():
+		match = COMPONENT.match(line)
+		if match:
+			rw, zi = int(match.group(4)), int(match.group(5))
+			if rw + zi:
+				objects.append((match.group(7), rw, zi))
+
+	print('RAM use per object (bytes)')
+	print('%-28s %8s %8s %8s' % ('Object', 'RW', 'ZI', 'Total'))
+	for name, rw, zi in sorted(objects, key=lambda item: item[1] + item[2], reverse=True):
+		print('%-28s %8d %8d %8d' % (name, rw, zi, rw + zi))
+	print('')
+
+	result = 0
+	print('RAM regions (bytes)')
+	print('%-20s %-12s %8s %8s %8s' % ('Region', 'Base', 'Used', 'Size', 'Free'))
+	for name, base, size, limit in regions:
+		print('%-20s 0x%08X %8d %8d %8d' % (name, base, size, limit, limit - size))
+		if size > limit:
+			print('error: %s is overflowed by %d bytes' % (name, size - limit))
+			result = 1
+
+	return result
+
+
+if __name__ == '__main__':
+	sys.exit(main())
@@ -0,0 +1,123 @@
+#!/usr/bin/env python3
+"""
+@file profile_report.py
+@brief Sampling profiler report (see Sources/HAL/profiler.hpp)
+
+Usage: profile_report.py <application.map> <profile.txt> [count]
+
+The input holds the data of BUS_PROFILE_DATA frames, one frame per line
+in hex (spaces allowed), covering the whole histogram. The bucket samples
+are shared among the functions of the linker map symbol table by the bytes
+each one covers in the bucket. Prints the hottest functions (20 by default)
+and the hottest buckets.
+"""
+
+import re
+import sys
+
+
+HEADER_SIZE = 20
+FLASH_BUCKETS = 240
+
+SYMBOL = re.compile(r'^\s+(\S+)\s+0x([0-9a-fA-F]{8})\s+(?:Thumb|ARM) Code\s+(\d+)\s+(\S+)')
+
+
+def parse_symbols(path):
+	"""Linker map to code symbols: (start, end, name, object)"""
+	symbols = []
+	for line in open(path, errors='replace'):
+		match = SYMBOL.match(line)
+		if match:
+			start = int(match.group(2), 16) & ~1
+			size = int(match.group(3))
+			if size:
+				symbols.append((start, start + size, match.group(1), match.group(4)))
+	return sorted(set(symbols))
+
+
+def parse_profile(path):
+	"""Frames to the header values and the buckets: (start, end, samples)"""
+	header = None
+	counters = {}
+	for line in open(path):
+		data = bytes.fromhex(line.split('#', 1)[0].strip())
+		if len(data) < HEADER_SIZE:
+			continue
+		flash_base, ram_base, samples, other = [int.from_bytes(data[offset:offset + 4], 'little') for offset in range(0, 16, 4)]
+		flash_shift, ram_shift, first, count = data[16], data[17], data[18], data[19]
+		header = (flash_base, ram_base, samples, other, flash_shift, ram_shift)
+		for index in range(count):
+			offset = HEADER_SIZE + index * 2
+			counters[first + index] = int.from_bytes(data[offset:offset + 2], 'little')
+
+	if header is None:
+		return None, []
+
+	flash_base, ram_base, samples, other, flash_shift, ram_shift = header
+	buckets = []
+	for index, value in sorted(counters.items()):
+		if not value:
+			continue
+		if index < FLASH_BUCKETS:
+			start = flash_base + (index << flash_shift)
+			buckets.append((start, start + (1 << flash_shift), value))
+		else:
+			start = ram_base + ((index - FLASH_BUCKETS) << ram_shift)
+			buckets.append((start, start + (1 << ram_shift), value))
+	return header, buckets
+
+
+def attribute(symbols, buckets):
+	"""Bucket samples to functions, by the covered bytes"""
+	functions = {}
+	for start, end, value in buckets:
+		parts = []
+		for symbol_start, symbol_end, name, owner in symbols:
+			overlap = min(end, symbol_end) - max(start, symbol_start)
+			if overlap > 0:
+				parts.append((overlap, '%s (%s)' % (name, owner)))
+		total = sum(part[0] for part in parts)
+		if not total:
+			parts, total = [(1, '0x%08X unknown' % start)], 1
+		for overlap, name in parts:
+			functions[name] = functions.get(name, 0.0) + value * overlap / total
+	return functions
+
+
+def main():
+	if len(sys.argv) not in (3, 4):
+		print(__doc__)
+		return 2
+
+	limit = int(sys.argv[3]) if len(sys.argv) == 4 else 20
+	symbols = parse_symbols(sys.argv[1])
+	header, buckets = parse_profile(sys.argv[2])
+	if header is None:
+		print('error: no profile data')
+		return 1
+
+	samples, other = header[2], header[3]
+	counted = sum(bucket[2] for bucket in buckets)
+	print('Samples: %d, outside the code: %d, flash bucket %d bytes, RAM code bucket %d bytes'
+		% (samples, other, 1 << header[4], 1 << header[5]))
+	if counted + other < samples:
+		print('warning: %d samples lost by the saturated buckets' % (samples - other - counted))
+	print('')
+
+	functions = attribute(symbols, buckets)
+	print('Hottest functions')
+	print('%8s %7s  %s' % ('Samples', '%', 'Function'))
+	for name, value in sorted(functions.items(), key=lambda item: item[1], reverse=True)[:limit]:
+		print('%8.1f %6.1f%%  %s' % (value, 100.0 * value / max(samples, 1), name))
+	print('')
+
+	print('Hottest buckets')
+	print('%-23s %8s' % ('Range', 'Samples'))
+	for start, end, value in sorted(buckets, key=lambda item: item[2], reverse=True)[:limit]:
+		print('0x%08X-0x%08X %8d' % (start, end - 1, value))
+
+	return 0
+
+
+if __name__ == '__main__':
+	sys.exit(main())
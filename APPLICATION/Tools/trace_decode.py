@@ -0,0 +1,178 @@
+#!/usr/bin/env python3
+"""
+@file trace_decode.py
+@brief Trace records decoder (see Sources/HAL/trace.hpp)
+
+Usage: trace_decode.py [--list] <trace.txt>
+
+The input holds the data of BUS_TRACE_DATA frames, one frame per line
+in hex (spaces allowed), in the reading order. Prints per-phase latency
+histograms (us.) of the card taps and of the other traced spans:
+
+  activation  TAP - ATR         card power-up and answer to reset
+  pps         ATR - PPS         protocol and parameters selection
+  apdu        APDU_BEGIN - END  command exchanges of the tap
+  decide      last APDU - DECISION  local tables, cache or controller
+  tap         TAP - DECISION    tap to decision
+
+--list prints the decoded records as well.
+"""
+
+import sys
+
+
+EVENTS = ['ISR_ENTER', 'ISR_EXIT', 'TAP', 'ATR', 'PPS', 'APDU_BEGIN', 'APDU_END', 'DECISION',
+	'COMMIT_BEGIN', 'COMMIT_END', 'BUS_IN', 'BUS_OUT', 'CLOCK']
+EVENT = dict((name, code) for code, name in enumerate(EVENTS))
+
+HEADER_SIZE = 6
+RECORD_SIZE = 8
+
+
+def parse(lines):
+	"""Frames to records: (cycles, event, argument, frequency), None marks lost records"""
+	records = []
+	for line in lines:
+		data = bytes.fromhex(line.split('#', 1)[0].strip())
+		if len(data) < HEADER_SIZE:
+			continue
+		frequency = int.from_bytes(data[0:4], 'little')
+		lost = int.from_bytes(data[4:6], 'little')
+		if lost:
+			records.append(None)
+		for offset in range(HEADER_SIZE, len(data) - RECORD_SIZE + 1, RECORD_SIZE):
+			cycles = int.from_bytes(data[offset:offset + 4], 'little')
+			event = data[offset + 4]
+			argument = int.from_bytes(data[offset + 6:offset + 8], 'little')
+			records.append((cycles, event, argument, frequency))
+	return records
+
+
+class Timeline:
+	"""Cycle stamps to microseconds, the clock changes are taken into account"""
+
+	def __init__(self):
+		self.previous = None
+		self.frequency = None
+		self.time = 0.0
+
+	def reset(self):
+		self.previous = None
+
+	def advance(self, cycles, frequency):
+		if self.frequency is None:
+			self.frequency = frequency
+		if self.previous is not None:
+			self.time += ((cycles - self.previous) & 0xFFFFFFFF) * 1e6 / self.frequency
+		self.previous = cycles
+		return self.time
+
+
+def analyze(records, listing):
+	"""Records to the spans durations (us.) by name"""
+	spans = {}
+	timeline = Timeline()
+	tap = None
+	isr = []
+	opened = {}
+
+	def add(name, duration):
+		spans.setdefault(name, []).append(duration)
+
+	for record in records:
+		if record is None:
+			if listing:
+				print('--- records lost ---')
+			timeline.reset()
+			tap = None
+			isr = []
+			opened = {}
+			continue
+
+		cycles, event, argument, frequency = record
+		now = timeline.advance(cycles, frequency)
+		name = EVENTS[event] if event < len(EVENTS) else 'EVENT_%d' % event
+		if listing:
+			print('%14.1f  %-12s %d' % (now, name, argument))
+
+		if event == EVENT['CLOCK']:
+			timeline.frequency = argument * 100000
+		elif event == EVENT['ISR_ENTER']:
+			isr.append((argument, now))
+		elif event == EVENT['ISR_EXIT']:
+			if isr and isr[-1][0] == argument:
+				add('isr %d' % argument, now - isr.pop()[1])
+		elif event == EVENT['TAP']:
+			tap = {'start': now, 'last': now, 'apdu': 0.0}
+		elif event == EVENT['ATR'] and tap:
+			add('activation', now - tap['last'])
+			tap['last'] = now
+		elif event == EVENT['PPS'] and tap:
+			add('pps', now - tap['last'])
+			tap['last'] = now
+		elif event == EVENT['APDU_BEGIN']:
+			opened['apdu'] = now
+		elif event == EVENT['APDU_END'] and 'apdu' in opened:
+			duration = now - opened.pop('apdu')
+			add('apdu ins 0x%02X' % argument, duration)
+			if tap:
+				tap['apdu'] += duration
+				tap['last'] = now
+		elif event == EVENT['DECISION'] and tap:
+			add('apdu', tap['apdu'])
+			add('decide', now - tap['last'])
+			add('tap', now - tap['start'])
+			tap = None
+		elif event == EVENT['COMMIT_BEGIN']:
+			opened['commit'] = now
+		elif event == EVENT['COMMIT_END'] and 'commit' in opened:
+			add('eeprom commit', now - opened.pop('commit'))
+		elif event == EVENT['BUS_IN']:
+			opened['bus'] = now
+		elif event == EVENT['BUS_OUT'] and 'bus' in opened:
+			add('bus turnaround', now - opened.pop('bus'))
+
+	return spans
+
+
+def histogram(name, values):
+	"""Power of 2 buckets (us.)"""
+	values = sorted(values)
+	print('%s: %d, min %.1f, median %.1f, p95 %.1f, max %.1f us.' % (name, len(values), values[0],
+		values[len(values) // 2], values[min(len(values) - 1, len(values) * 95 // 100)], values[-1]))
+
+	buckets = {}
+	for value in values:
+		bucket = 1
+		while bucket < value:
+			bucket *= 2
+		buckets[bucket] = buckets.get(bucket, 0) + 1
+
+	peak = max(buckets.values())
+	for bucket in sorted(buckets):
+		print('  <= %8d  %6d  %s' % (bucket, buckets[bucket], '#' * max(1, buckets[bucket] * 40 // peak)))
+	print('')
+
+
+def main():
+	arguments = [argument for argument in sys.argv[1:] if argument != '--list']
+	if len(arguments) != 1:
+		print(__doc__)
+		return 2
+
+	source = sys.stdin if arguments[0] == '-' else open(arguments[0])
+	records = parse(source)
+	spans = analyze(records, '--list' in sys.argv)
+	if '--list' in sys.argv:
+		print('')
+
+	order = ['tap', 'activation', 'pps', 'apdu', 'decide']
+	for name in order + sorted(name for name in spans if name not in order):
+		if name in spans:
+			histogram(name, spans[name])
+
+	return 0
+
+
+if __name__ == '__main__':
+	sys.exit(main())